@@ -0,0 +1,262 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+namespace dae
+{
+	void BVH::Build(const std::vector<Vector3>& primitiveMin, const std::vector<Vector3>& primitiveMax, uint32_t maxLeafSize)
+	{
+		Clear();
+
+		const uint32_t numPrimitives = static_cast<uint32_t>(primitiveMin.size());
+		if (numPrimitives == 0)
+			return;
+
+		maxLeafSize = std::max(maxLeafSize, 1u);
+
+		std::vector<Vector3> centroids{};
+		centroids.reserve(numPrimitives);
+		for (uint32_t i{ 0 }; i < numPrimitives; ++i)
+			centroids.emplace_back((primitiveMin[i] + primitiveMax[i]) * 0.5f);
+
+		m_PrimitiveIndices.resize(numPrimitives);
+		std::iota(m_PrimitiveIndices.begin(), m_PrimitiveIndices.end(), 0u);
+
+		//A binary tree with n leaves never has more than 2n - 1 nodes, so node references stay valid while building
+		m_Nodes.reserve(2 * static_cast<size_t>(numPrimitives) - 1);
+		m_Nodes.push_back({ {}, 0, {}, numPrimitives });
+
+		struct BuildTask
+		{
+			uint32_t nodeIndex;
+			uint32_t depth;
+		};
+
+		struct Bin
+		{
+			Vector3 minAABB{ FLT_MAX, FLT_MAX, FLT_MAX };
+			Vector3 maxAABB{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			uint32_t count{};
+		};
+
+		//Leaves above this size get split even when the SAH prefers not to, keeps traversal cost bounded
+		const uint32_t forceSplitSize = maxLeafSize * 8;
+
+		std::vector<BuildTask> tasks{ { 0, 0 } };
+		while (!tasks.empty())
+		{
+			const BuildTask task = tasks.back();
+			tasks.pop_back();
+
+			BVHNode& node = m_Nodes[task.nodeIndex];
+			const uint32_t first = node.leftFirst;
+			const uint32_t count = node.primitiveCount;
+
+			//Node + centroid bounds
+			Vector3 nodeMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+			Vector3 nodeMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			Vector3 centroidMin{ nodeMin };
+			Vector3 centroidMax{ nodeMax };
+
+			for (uint32_t i{ first }; i < first + count; ++i)
+			{
+				const uint32_t primitiveIndex = m_PrimitiveIndices[i];
+				nodeMin = Vector3::Min(nodeMin, primitiveMin[primitiveIndex]);
+				nodeMax = Vector3::Max(nodeMax, primitiveMax[primitiveIndex]);
+				centroidMin = Vector3::Min(centroidMin, centroids[primitiveIndex]);
+				centroidMax = Vector3::Max(centroidMax, centroids[primitiveIndex]);
+			}
+
+			node.minAABB = nodeMin;
+			node.maxAABB = nodeMax;
+
+			if (count <= maxLeafSize || task.depth + 1 >= MaxDepth)
+				continue;
+
+			//Binned SAH: find the cheapest split plane over all 3 axes
+			int bestAxis{ -1 };
+			uint32_t bestSplit{ 0 };
+			float bestCost{ FLT_MAX };
+
+			for (int axis{ 0 }; axis < 3; ++axis)
+			{
+				const float extent = centroidMax[axis] - centroidMin[axis];
+				const float binScale = static_cast<float>(NumBins) / extent;
+				if (extent <= 0.f || !std::isfinite(binScale))
+					continue;
+
+				Bin bins[NumBins]{};
+
+				for (uint32_t i{ first }; i < first + count; ++i)
+				{
+					const uint32_t primitiveIndex = m_PrimitiveIndices[i];
+					const uint32_t binIndex = std::min(NumBins - 1, static_cast<uint32_t>((centroids[primitiveIndex][axis] - centroidMin[axis]) * binScale));
+
+					Bin& bin = bins[binIndex];
+					++bin.count;
+					bin.minAABB = Vector3::Min(bin.minAABB, primitiveMin[primitiveIndex]);
+					bin.maxAABB = Vector3::Max(bin.maxAABB, primitiveMax[primitiveIndex]);
+				}
+
+				//Sweep from the left, then from the right, to get the cost of every plane between two bins
+				float leftArea[NumBins - 1]{};
+				uint32_t leftCount[NumBins - 1]{};
+				Vector3 sweepMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+				Vector3 sweepMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+				uint32_t sweepCount{ 0 };
+
+				for (uint32_t b{ 0 }; b < NumBins - 1; ++b)
+				{
+					sweepCount += bins[b].count;
+					sweepMin = Vector3::Min(sweepMin, bins[b].minAABB);
+					sweepMax = Vector3::Max(sweepMax, bins[b].maxAABB);
+					leftCount[b] = sweepCount;
+					leftArea[b] = sweepCount > 0 ? SurfaceArea(sweepMin, sweepMax) : 0.f;
+				}
+
+				sweepMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+				sweepMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+				sweepCount = 0;
+
+				for (uint32_t b{ NumBins - 1 }; b > 0; --b)
+				{
+					sweepCount += bins[b].count;
+					sweepMin = Vector3::Min(sweepMin, bins[b].minAABB);
+					sweepMax = Vector3::Max(sweepMax, bins[b].maxAABB);
+
+					if (sweepCount == 0 || leftCount[b - 1] == 0)
+						continue;
+
+					const float cost = static_cast<float>(leftCount[b - 1]) * leftArea[b - 1] + static_cast<float>(sweepCount) * SurfaceArea(sweepMin, sweepMax);
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = b - 1;
+					}
+				}
+			}
+
+			//All centroids coincide, nothing left to split on
+			if (bestAxis == -1)
+				continue;
+
+			const float leafCost = static_cast<float>(count) * SurfaceArea(nodeMin, nodeMax);
+			if (bestCost >= leafCost && count <= forceSplitSize)
+				continue;
+
+			//Partition the primitive range around the chosen plane (same binning formula as above)
+			const float axisMin = centroidMin[bestAxis];
+			const float binScale = static_cast<float>(NumBins) / (centroidMax[bestAxis] - axisMin);
+
+			const auto rangeBegin = m_PrimitiveIndices.begin() + first;
+			const auto splitIt = std::partition(rangeBegin, rangeBegin + count, [&](uint32_t primitiveIndex)
+				{
+					const uint32_t binIndex = std::min(NumBins - 1, static_cast<uint32_t>((centroids[primitiveIndex][bestAxis] - axisMin) * binScale));
+					return binIndex <= bestSplit;
+				});
+
+			const uint32_t leftPrimitiveCount = static_cast<uint32_t>(splitIt - rangeBegin);
+			if (leftPrimitiveCount == 0 || leftPrimitiveCount == count)
+				continue;
+
+			const uint32_t leftChildIndex = static_cast<uint32_t>(m_Nodes.size());
+			m_Nodes.push_back({ {}, first, {}, leftPrimitiveCount });
+			m_Nodes.push_back({ {}, first + leftPrimitiveCount, {}, count - leftPrimitiveCount });
+
+			//push_back never reallocates here (see reserve), node is still valid
+			node.leftFirst = leftChildIndex;
+			node.primitiveCount = 0;
+
+			tasks.push_back({ leftChildIndex + 1, task.depth + 1 });
+			tasks.push_back({ leftChildIndex, task.depth + 1 });
+		}
+
+		FinishBuild();
+	}
+
+	void BVH::Assign(std::vector<BVHNode> nodes, std::vector<uint32_t> primitiveIndices)
+	{
+		Clear();
+
+		m_Nodes = std::move(nodes);
+		m_PrimitiveIndices = std::move(primitiveIndices);
+
+		FinishBuild();
+	}
+
+	void BVH::Clear()
+	{
+		m_Nodes.clear();
+		m_PrimitiveIndices.clear();
+		m_LeafIndices.clear();
+		m_SAHCost = 0.f;
+		m_BuildSAHCost = 0.f;
+	}
+
+	void BVH::RefitLeaves(const std::function<void(uint32_t nodeIndex)>& refitLeaf)
+	{
+		if (m_LeafIndices.size() >= ParallelRefitThreshold)
+			std::for_each(std::execution::par, m_LeafIndices.begin(), m_LeafIndices.end(), refitLeaf);
+		else
+			std::for_each(m_LeafIndices.begin(), m_LeafIndices.end(), refitLeaf);
+	}
+
+	void BVH::RefitInternalNodes()
+	{
+		for (size_t i{ m_Nodes.size() }; i-- > 0;)
+		{
+			BVHNode& node = m_Nodes[i];
+			if (node.IsLeaf())
+				continue;
+
+			const BVHNode& left = m_Nodes[node.leftFirst];
+			const BVHNode& right = m_Nodes[node.leftFirst + 1];
+			node.minAABB = Vector3::Min(left.minAABB, right.minAABB);
+			node.maxAABB = Vector3::Max(left.maxAABB, right.maxAABB);
+		}
+
+		m_SAHCost = ComputeSAHCost();
+	}
+
+	void BVH::FinishBuild()
+	{
+		for (uint32_t i{ 0 }; i < static_cast<uint32_t>(m_Nodes.size()); ++i)
+		{
+			if (m_Nodes[i].IsLeaf())
+				m_LeafIndices.push_back(i);
+		}
+
+		m_SAHCost = ComputeSAHCost();
+		m_BuildSAHCost = m_SAHCost;
+	}
+
+	float BVH::ComputeSAHCost() const
+	{
+		if (m_Nodes.empty())
+			return 0.f;
+
+		const float rootArea = SurfaceArea(m_Nodes[0].minAABB, m_Nodes[0].maxAABB);
+		if (rootArea <= 0.f)
+			return 0.f;
+
+		float cost{ 0.f };
+		for (const BVHNode& node : m_Nodes)
+		{
+			const float area = SurfaceArea(node.minAABB, node.maxAABB);
+			cost += node.IsLeaf() ? area * IntersectionCost * static_cast<float>(node.primitiveCount) : area * TraversalCost;
+		}
+
+		return cost / rootArea;
+	}
+
+	float BVH::SurfaceArea(const Vector3& minAABB, const Vector3& maxAABB)
+	{
+		const Vector3 extent{ maxAABB - minAABB };
+		return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+}
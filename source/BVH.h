@@ -0,0 +1,125 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		uint32_t leftFirst{}; //Internal node: index of the left child (right child = leftFirst + 1), Leaf: first primitive
+		Vector3 maxAABB{};
+		uint32_t primitiveCount{}; //0 for internal nodes
+
+		bool IsLeaf() const { return primitiveCount > 0; }
+	};
+
+	/**
+	 * \brief Bounding Volume Hierarchy built with the binned Surface Area Heuristic.
+	 * The BVH only knows about primitive bounds, the owner (TriangleMesh, Scene, ...) decides what a primitive is.
+	 * Leaves reference a contiguous range in GetPrimitiveIndices(), children are always stored after their parent.
+	 */
+	class BVH final
+	{
+	public:
+		BVH() = default;
+		~BVH() = default;
+
+		BVH(const BVH&) = default;
+		BVH(BVH&&) noexcept = default;
+		BVH& operator=(const BVH&) = default;
+		BVH& operator=(BVH&&) noexcept = default;
+
+		/**
+		 * \brief (Re)builds the hierarchy
+		 * \param primitiveMin min corner of every primitive AABB
+		 * \param primitiveMax max corner of every primitive AABB
+		 * \param maxLeafSize leaves never get split below this amount of primitives
+		 */
+		void Build(const std::vector<Vector3>& primitiveMin, const std::vector<Vector3>& primitiveMax, uint32_t maxLeafSize = 4);
+
+		/**
+		 * \brief Updates all node bounds for moved primitives, the topology stays untouched.
+		 * Leaves are refitted in parallel, internal nodes bottom-up afterwards (children are always stored after their parent)
+		 * \param primitiveBounds void(uint32_t primitiveIndex, Vector3& min, Vector3& max)
+		 */
+		template<typename BoundsFunc>
+		void Refit(BoundsFunc&& primitiveBounds);
+
+		//Takes over a hierarchy built earlier (mesh cache), the caller makes sure it matches its primitives
+		void Assign(std::vector<BVHNode> nodes, std::vector<uint32_t> primitiveIndices);
+
+		void Clear();
+
+		bool IsEmpty() const { return m_Nodes.empty(); }
+		uint32_t GetPrimitiveCount() const { return static_cast<uint32_t>(m_PrimitiveIndices.size()); }
+		const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_PrimitiveIndices; }
+
+		//SAH cost of the current bounds, relative to the root surface area
+		float GetSAHCost() const { return m_SAHCost; }
+		//Current SAH cost compared to the cost right after the last Build, 1 means no degradation
+		float GetDegradation() const { return m_BuildSAHCost > 0.f ? m_SAHCost / m_BuildSAHCost : 1.f; }
+
+		//Traversal stacks are fixed size, the builder never goes deeper than this
+		static constexpr uint32_t MaxDepth{ 64 };
+
+	private:
+		static constexpr uint32_t NumBins{ 16 };
+		static constexpr float TraversalCost{ 1.f };
+		static constexpr float IntersectionCost{ 1.f };
+
+		//Below this amount of leaves a parallel refit costs more than it saves
+		static constexpr size_t ParallelRefitThreshold{ 1024 };
+
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<uint32_t> m_PrimitiveIndices{};
+		std::vector<uint32_t> m_LeafIndices{};
+
+		float m_SAHCost{};
+		float m_BuildSAHCost{};
+
+		//Non template halves of Refit, so only BVH.cpp pulls in <execution>: runs refitLeaf for every leaf (in parallel above ParallelRefitThreshold)...
+		void RefitLeaves(const std::function<void(uint32_t nodeIndex)>& refitLeaf);
+		//...then merges the child bounds bottom-up and updates the SAH cost
+		void RefitInternalNodes();
+
+		//Leaf list and SAH costs of freshly built or assigned nodes
+		void FinishBuild();
+		float ComputeSAHCost() const;
+		static float SurfaceArea(const Vector3& minAABB, const Vector3& maxAABB);
+	};
+
+	template<typename BoundsFunc>
+	void BVH::Refit(BoundsFunc&& primitiveBounds)
+	{
+		const auto refitLeaf = [&](uint32_t nodeIndex)
+		{
+			BVHNode& node = m_Nodes[nodeIndex];
+
+			Vector3 nodeMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+			Vector3 nodeMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			Vector3 primitiveMin{};
+			Vector3 primitiveMax{};
+
+			for (uint32_t i{ node.leftFirst }; i < node.leftFirst + node.primitiveCount; ++i)
+			{
+				primitiveBounds(m_PrimitiveIndices[i], primitiveMin, primitiveMax);
+				nodeMin = Vector3::Min(nodeMin, primitiveMin);
+				nodeMax = Vector3::Max(nodeMax, primitiveMax);
+			}
+
+			node.minAABB = nodeMin;
+			node.maxAABB = nodeMax;
+		};
+
+		RefitLeaves(refitLeaf);
+		RefitInternalNodes();
+	}
+}
@@ -0,0 +1,241 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+
+#include "CameraPath.h"
+#include "InstructionSet.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Times in seconds
+		struct FrameSample
+		{
+			double frameTime{}; //Update + Render
+			double updateTime{};
+			RenderStats renderStats{};
+		};
+
+		struct SceneResult
+		{
+			std::string sceneName{};
+			std::vector<FrameSample> frames{};
+			FrameTimeStats frameTimes{};
+			std::array<uint32_t, Timer::NumFrameTimeBuckets> frameTimeHistogram{};
+		};
+
+		//Nearest rank on a sorted series
+		double GetPercentile(const std::vector<double>& sortedValues, double percentile)
+		{
+			const size_t rank{ static_cast<size_t>(percentile / 100.0 * static_cast<double>(sortedValues.size() - 1) + 0.5) };
+			return sortedValues[std::min(rank, sortedValues.size() - 1)];
+		}
+
+		//{"mean": .., "min": .., "p50": .., ...} in milliseconds
+		template<typename Getter>
+		void WriteSeries(std::ostream& json, const char* name, const std::vector<FrameSample>& frames, Getter&& getter)
+		{
+			std::vector<double> values(frames.size());
+			std::transform(frames.begin(), frames.end(), values.begin(), [&](const FrameSample& frame) { return getter(frame) * 1000.0; });
+			std::sort(values.begin(), values.end());
+
+			const double mean{ std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size()) };
+
+			json << "\t\t\t\t\"" << name << "\": { "
+				<< "\"mean\": " << mean
+				<< ", \"min\": " << values.front()
+				<< ", \"p50\": " << GetPercentile(values, 50.0)
+				<< ", \"p90\": " << GetPercentile(values, 90.0)
+				<< ", \"p95\": " << GetPercentile(values, 95.0)
+				<< ", \"p99\": " << GetPercentile(values, 99.0)
+				<< ", \"max\": " << values.back()
+				<< " }";
+		}
+
+		//Timer frame times in milliseconds, the histogram is cut after its last non-empty bucket
+		void WriteFrameTimes(std::ostream& json, const SceneResult& result)
+		{
+			const FrameTimeStats& frameTimes = result.frameTimes;
+			const auto& histogram = result.frameTimeHistogram;
+
+			json << "\t\t\t\"frameTimes\": {\n";
+			json << "\t\t\t\t\"p50\": " << frameTimes.p50 * 1000.f << ",\n";
+			json << "\t\t\t\t\"p90\": " << frameTimes.p90 * 1000.f << ",\n";
+			json << "\t\t\t\t\"p99\": " << frameTimes.p99 * 1000.f << ",\n";
+			json << "\t\t\t\t\"max\": " << frameTimes.max * 1000.f << ",\n";
+			json << "\t\t\t\t\"framesOverBudget\": " << frameTimes.numOverBudget << ",\n";
+			json << "\t\t\t\t\"histogram\": [";
+
+			const auto lastBucket = std::find_if(histogram.rbegin(), histogram.rend(), [](uint32_t count) { return count > 0; });
+			const size_t numBuckets{ static_cast<size_t>(histogram.rend() - lastBucket) };
+			for (size_t i{ 0 }; i < numBuckets; ++i)
+				json << (i > 0 ? ", " : "") << histogram[i];
+
+			json << "]\n";
+			json << "\t\t\t}\n";
+		}
+
+		SceneResult RunScene(const std::string& sceneName, Scene& scene, Renderer& renderer, const BenchmarkSettings& settings)
+		{
+			scene.Initialize();
+			//Measured frames need every asset, streamed in ones would change the scene halfway through the run
+			scene.WaitUntilLoaded();
+
+			const CameraPath cameraPath{ CameraPath::CreateSweep(scene.GetCamera()) };
+
+			//Warm-up: caches, BVHs and the thread pool settle in, the scene does not advance
+			cameraPath.Apply(scene.GetCamera(), 0.f);
+			for (int frame{ 0 }; frame < settings.numWarmUpFrames; ++frame)
+				renderer.Render(&scene);
+
+			Timer timer{};
+			timer.SetFixedTimeStep(settings.timeStep);
+			timer.SetFrameBudget(settings.frameBudget);
+			timer.Start();
+
+			SceneResult result{};
+			result.sceneName = sceneName;
+			result.frames.reserve(settings.numFrames);
+
+			for (int frame{ 0 }; frame < settings.numFrames; ++frame)
+			{
+				FrameSample sample{};
+				const auto frameStart = std::chrono::steady_clock::now();
+
+				scene.Update(&timer);
+				cameraPath.Apply(scene.GetCamera(), settings.numFrames > 1 ? static_cast<float>(frame) / static_cast<float>(settings.numFrames - 1) : 0.f);
+				sample.updateTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+
+				renderer.Render(&scene);
+				sample.frameTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+				sample.renderStats = renderer.GetLastFrameStats();
+
+				timer.Update();
+				result.frames.emplace_back(sample);
+			}
+
+			result.frameTimes = timer.GetFrameTimeStats();
+			result.frameTimeHistogram = timer.GetFrameTimeHistogram();
+			return result;
+		}
+
+		void WriteSceneResult(std::ostream& json, const SceneResult& result)
+		{
+			const std::vector<FrameSample>& frames = result.frames;
+
+			uint64_t numPrimaryRays{ 0 };
+			uint64_t numShadowRays{ 0 };
+			double totalTime{ 0.0 };
+			double traceTime{ 0.0 };
+			double shadowTraceTime{ 0.0 };
+			for (const FrameSample& frame : frames)
+			{
+				numPrimaryRays += frame.renderStats.numPrimaryRays;
+				numShadowRays += frame.renderStats.numShadowRays;
+				totalTime += frame.frameTime;
+				traceTime += frame.renderStats.traceTime;
+				shadowTraceTime += frame.renderStats.shadowTraceTime;
+			}
+
+			json << "\t\t{\n";
+			json << "\t\t\t\"scene\": \"" << result.sceneName << "\",\n";
+			json << "\t\t\t\"primaryRays\": " << numPrimaryRays << ",\n";
+			json << "\t\t\t\"shadowRays\": " << numShadowRays << ",\n";
+			//Rays per second of their own pass, 0 when the pass did not run (shadows traced inline)
+			json << "\t\t\t\"primaryRaysPerSecond\": " << (traceTime > 0.0 ? static_cast<double>(numPrimaryRays) / traceTime : 0.0) << ",\n";
+			json << "\t\t\t\"shadowRaysPerSecond\": " << (shadowTraceTime > 0.0 ? static_cast<double>(numShadowRays) / shadowTraceTime : 0.0) << ",\n";
+			json << "\t\t\t\"framesPerSecond\": " << static_cast<double>(frames.size()) / totalTime << ",\n";
+			json << "\t\t\t\"milliseconds\": {\n";
+
+			WriteSeries(json, "frame", frames, [](const FrameSample& frame) { return frame.frameTime; });
+			json << ",\n";
+			WriteSeries(json, "update", frames, [](const FrameSample& frame) { return frame.updateTime; });
+			json << ",\n";
+			WriteSeries(json, "updateTransforms", frames, [](const FrameSample& frame) { return frame.renderStats.updateTransformsTime; });
+			json << ",\n";
+			WriteSeries(json, "trace", frames, [](const FrameSample& frame) { return frame.renderStats.traceTime; });
+			json << ",\n";
+			WriteSeries(json, "shadowTrace", frames, [](const FrameSample& frame) { return frame.renderStats.shadowTraceTime; });
+			json << ",\n";
+			WriteSeries(json, "shade", frames, [](const FrameSample& frame) { return frame.renderStats.shadeTime; });
+			json << ",\n";
+			WriteSeries(json, "present", frames, [](const FrameSample& frame) { return frame.renderStats.presentTime; });
+			json << "\n";
+
+			json << "\t\t\t},\n";
+			WriteFrameTimes(json, result);
+			json << "\t\t}";
+		}
+	}
+
+	bool RunBenchmarkSuite(const BenchmarkSettings& settings, const std::string& outputPath)
+	{
+		const std::vector<std::string>& sceneNames{ settings.sceneNames.empty() ? GetSceneNames() : settings.sceneNames };
+
+		//One renderer for all scenes, the thread pool only gets created once
+		Renderer renderer{ settings.width, settings.height };
+		renderer.SetExecutionBackend(settings.backend);
+		renderer.SetShadowRayStreamEnabled(settings.useShadowRayStream);
+
+		std::vector<SceneResult> results{};
+		for (const std::string& sceneName : sceneNames)
+		{
+			const std::unique_ptr<Scene> pScene{ CreateScene(sceneName) };
+			if (!pScene)
+			{
+				std::cout << "Unknown scene " << sceneName << std::endl;
+				return false;
+			}
+
+			std::cout << "Benchmarking " << sceneName << "..." << std::endl;
+			results.emplace_back(RunScene(sceneName, *pScene, renderer, settings));
+
+			const RenderStats& stats = renderer.GetLastFrameStats();
+			std::cout << ">> " << stats.numPrimaryRays << " primary rays, " << stats.numShadowRays << " shadow rays in the last frame" << std::endl;
+		}
+
+		std::ofstream json(outputPath);
+		if (!json)
+		{
+			std::cout << "Could not write " << outputPath << std::endl;
+			return false;
+		}
+
+		json << "{\n";
+		json << "\t\"version\": 2,\n";
+		json << "\t\"width\": " << settings.width << ",\n";
+		json << "\t\"height\": " << settings.height << ",\n";
+		json << "\t\"warmUpFrames\": " << settings.numWarmUpFrames << ",\n";
+		json << "\t\"frames\": " << settings.numFrames << ",\n";
+		json << "\t\"timeStep\": " << settings.timeStep << ",\n";
+		json << "\t\"frameBudgetMs\": " << settings.frameBudget * 1000.f << ",\n";
+		json << "\t\"frameTimeBucketMs\": " << Timer::FrameTimeBucketWidth * 1000.f << ",\n";
+		json << "\t\"backend\": \"" << GetExecutionBackendName(renderer.GetExecutionBackend()) << "\",\n";
+		json << "\t\"threads\": " << renderer.GetNumWorkers() << ",\n";
+		json << "\t\"instructionSet\": \"" << GetInstructionSetName(GetInstructionSet()) << "\",\n";
+		json << "\t\"shadowRayStream\": " << (settings.useShadowRayStream ? "true" : "false") << ",\n";
+		json << "\t\"scenes\": [\n";
+
+		for (size_t i{ 0 }; i < results.size(); ++i)
+		{
+			WriteSceneResult(json, results[i]);
+			json << (i + 1 < results.size() ? ",\n" : "\n");
+		}
+
+		json << "\t]\n";
+		json << "}\n";
+
+		std::cout << "Benchmark written to " << outputPath << std::endl;
+		return true;
+	}
+}
@@ -0,0 +1,32 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <string>
+#include <vector>
+
+#include "ExecutionBackend.h"
+
+namespace dae
+{
+	struct BenchmarkSettings
+	{
+		std::vector<std::string> sceneNames{}; //empty: every built-in scene (GetSceneNames)
+		int width{ 640 };
+		int height{ 480 };
+		int numWarmUpFrames{ 10 };
+		int numFrames{ 100 };
+		float timeStep{ 1.f / 30.f };
+		float frameBudget{ 1.f / 30.f }; //seconds, slower frames count as over budget
+		ExecutionBackendType backend{ ExecutionBackendType::WorkStealing };
+		//Streamed shadow rays get their own pass, so shadow tracing and shading show up as separate phases
+		bool useShadowRayStream{ true };
+	};
+
+	/**
+	 * \brief Renders every scene headless along CameraPath::CreateSweep with a fixed time step, so every run renders exactly the same frames.
+	 * Warm-up frames render the first pose and are not recorded. Reports per scene: primary/shadow rays per second,
+	 * frame time percentiles and the time spent in Update, UpdateTransforms, tracing, shading and present, plus the wall clock frame times
+	 * of the Timer (percentiles, frames over budget and the histogram) to gate on tail latency, written as JSON to outputPath.
+	 * Returns false when a scene name is unknown or outputPath can not be written.
+	 */
+	bool RunBenchmarkSuite(const BenchmarkSettings& settings, const std::string& outputPath);
+}
@@ -1,10 +1,9 @@
 #pragma once
 #include <cassert>
 #include <iostream>
-#include <SDL_keyboard.h>
-#include <SDL_mouse.h>
 
 #include "Math.h"
+#include "Platform.h"
 #include "Timer.h"
 
 namespace dae
@@ -56,39 +55,36 @@ namespace dae
 		{
 			const float deltaTime = pTimer->GetElapsed();
 
-			//Keyboard Input
-			const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
+			const InputState& input = Platform::GetInputState();
 
-			if (pKeyboardState[SDL_SCANCODE_W])
+			//Keyboard Input
+			if (input.isForwardDown)
 				origin.z += movementSpeed * deltaTime;
-			else if (pKeyboardState[SDL_SCANCODE_S])
+			else if (input.isBackwardDown)
 				origin.z -= movementSpeed * deltaTime;
 
-			if (pKeyboardState[SDL_SCANCODE_A])
+			if (input.isLeftDown)
 				origin.x -= movementSpeed * deltaTime;
-			else if (pKeyboardState[SDL_SCANCODE_D])
+			else if (input.isRightDown)
 				origin.x += movementSpeed * deltaTime;
 
 			//Mouse Input
-			int mouseX{}, mouseY{};
+			const float mouseX{ static_cast<float>(input.mouseDeltaX) };
+			const float mouseY{ static_cast<float>(input.mouseDeltaY) };
 
-			switch (SDL_GetRelativeMouseState(&mouseX, &mouseY))
+			if (input.isLeftMouseDown && input.isRightMouseDown)
 			{
-			case SDL_BUTTON(1):
-				origin = forward.Normalized() * static_cast<float>(mouseY) * deltaTime;
-				totalYaw -= static_cast<float>(mouseX) * rotationSpeed * deltaTime;
-				break;
-
-			case SDL_BUTTON(3):
-				totalYaw -= static_cast<float>(mouseX) * rotationSpeed * deltaTime;
-				totalPitch -= static_cast<float>(mouseY) * rotationSpeed * deltaTime;
-				break;
-
-			case SDL_BUTTON(1) | SDL_BUTTON(3):
-				origin += up.Normalized() * static_cast<float>(mouseY) * deltaTime;
-				break;
-
-			default:;
+				origin += up.Normalized() * mouseY * deltaTime;
+			}
+			else if (input.isLeftMouseDown)
+			{
+				origin = forward.Normalized() * mouseY * deltaTime;
+				totalYaw -= mouseX * rotationSpeed * deltaTime;
+			}
+			else if (input.isRightMouseDown)
+			{
+				totalYaw -= mouseX * rotationSpeed * deltaTime;
+				totalPitch -= mouseY * rotationSpeed * deltaTime;
 			}
 
 			const Matrix finalRotation = { Matrix::CreateRotation(totalPitch,totalYaw,0) };
@@ -0,0 +1,68 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "Camera.h"
+
+namespace dae
+{
+	CameraPath CameraPath::CreateSweep(const Camera& camera)
+	{
+		const Vector3 forward{ camera.forward.Normalized() };
+		constexpr float panAngle{ 0.3f };
+
+		CameraPath path{};
+		path.AddKeyframe({ camera.origin, camera.totalPitch, camera.totalYaw });
+		path.AddKeyframe({ camera.origin + forward, camera.totalPitch, camera.totalYaw - panAngle });
+		path.AddKeyframe({ camera.origin + forward * 2.f, camera.totalPitch, camera.totalYaw + panAngle });
+		path.AddKeyframe({ camera.origin, camera.totalPitch, camera.totalYaw });
+		return path;
+	}
+
+	bool CameraPath::LoadFromFile(const std::string& filePath)
+	{
+		std::ifstream file(filePath);
+		if (!file)
+			return false;
+
+		m_Keyframes.clear();
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			std::istringstream lineStream(line);
+			CameraKeyframe keyframe{};
+			if (lineStream >> keyframe.origin.x >> keyframe.origin.y >> keyframe.origin.z >> keyframe.pitch >> keyframe.yaw)
+				m_Keyframes.emplace_back(keyframe);
+		}
+
+		return !m_Keyframes.empty();
+	}
+
+	void CameraPath::Apply(Camera& camera, float progress) const
+	{
+		if (m_Keyframes.empty())
+			return;
+
+		//Segment + position inside the segment
+		const float position{ std::clamp(progress, 0.f, 1.f) * static_cast<float>(m_Keyframes.size() - 1) };
+		const size_t first{ std::min(static_cast<size_t>(position), m_Keyframes.size() - 1) };
+		const size_t second{ std::min(first + 1, m_Keyframes.size() - 1) };
+		const float factor{ position - static_cast<float>(first) };
+
+		const CameraKeyframe& a = m_Keyframes[first];
+		const CameraKeyframe& b = m_Keyframes[second];
+
+		camera.origin = a.origin + (b.origin - a.origin) * factor;
+		camera.totalPitch = Lerpf(a.pitch, b.pitch, factor);
+		camera.totalYaw = Lerpf(a.yaw, b.yaw, factor);
+
+		const Matrix finalRotation = { Matrix::CreateRotation(camera.totalPitch, camera.totalYaw, 0) };
+		camera.forward = finalRotation.TransformVector(Vector3::UnitZ).Normalized();
+	}
+}
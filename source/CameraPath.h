@@ -0,0 +1,41 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct Camera;
+
+	struct CameraKeyframe
+	{
+		Vector3 origin{};
+		float pitch{};
+		float yaw{};
+	};
+
+	/**
+	 * \brief Fixed camera animation for offline rendering: keyframes are spread evenly over [0, 1] and interpolated linearly.
+	 * File format: one keyframe per line "x y z pitch yaw" (angles in radians), lines starting with # are comments
+	 */
+	class CameraPath final
+	{
+	public:
+		//Pans left and right around the start pose of the camera while moving in
+		static CameraPath CreateSweep(const Camera& camera);
+
+		//Returns false when the file can not be opened or holds no keyframes
+		bool LoadFromFile(const std::string& filePath);
+
+		void AddKeyframe(const CameraKeyframe& keyframe) { m_Keyframes.emplace_back(keyframe); }
+		bool IsEmpty() const { return m_Keyframes.empty(); }
+
+		//progress in [0, 1], sets the pose the same way Camera::Update does
+		void Apply(Camera& camera, float progress) const;
+
+	private:
+		std::vector<CameraKeyframe> m_Keyframes{};
+	};
+}
@@ -0,0 +1,32 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+
+//Standard includes
+#include <charconv>
+#include <iostream>
+#include <string_view>
+#include <system_error>
+
+namespace dae
+{
+	//Shared by the front ends, never throws: a value that is not a number (or does not fit) gets reported with its flag
+	template<typename T>
+	bool ParseArgumentValue(std::string_view argument, std::string_view value, T& number)
+	{
+		const char* pLast{ value.data() + value.size() };
+		const auto [pEnd, error] = std::from_chars(value.data(), pLast, number);
+		if (error == std::errc{} && pEnd == pLast)
+			return true;
+
+		std::cout << "Invalid value \"" << value << "\" for " << argument << std::endl;
+		return false;
+	}
+
+	//Prints message when the setting is out of range, so a bad command line never exits silently
+	inline bool CheckArgument(bool isValid, std::string_view message)
+	{
+		if (!isValid)
+			std::cout << message << std::endl;
+		return isValid;
+	}
+}
@@ -2,8 +2,12 @@
 #pragma once
 #include <cassert>
 #include <iostream>
+#include <memory>
 
 #include "Math.h"
+#include "BVH.h"
+#include "SphereBlock.h"
+#include "TriangleBlock.h"
 #include "vector"
 
 namespace dae
@@ -17,6 +21,106 @@ namespace dae
 		unsigned char materialIndex{ 0 };
 	};
 
+	//Structure-of-arrays sphere storage, a sphere is addressed by the index Add returned
+	struct SphereSet
+	{
+		std::vector<float> originX{};
+		std::vector<float> originY{};
+		std::vector<float> originZ{};
+		std::vector<float> radius{};
+		std::vector<float> radiusSquared{};
+		std::vector<unsigned char> materialIndices{};
+
+		//Built over all spheres, leaves sized to the SIMD block width
+		BVH bvh{};
+		SphereBlockBuffer sphereBlocks{};
+		float bvhRebuildThreshold{ 1.5f };
+
+		//Set whenever a sphere was added or moved, UpdateBVH clears it
+		bool isDirty{ false };
+
+		uint32_t Add(const Vector3& origin, float sphereRadius, unsigned char materialIndex)
+		{
+			originX.emplace_back(origin.x);
+			originY.emplace_back(origin.y);
+			originZ.emplace_back(origin.z);
+			radius.emplace_back(sphereRadius);
+			radiusSquared.emplace_back(sphereRadius * sphereRadius);
+			materialIndices.emplace_back(materialIndex);
+
+			isDirty = true;
+			return GetCount() - 1;
+		}
+
+		void SetOrigin(uint32_t index, const Vector3& origin)
+		{
+			originX[index] = origin.x;
+			originY[index] = origin.y;
+			originZ[index] = origin.z;
+			isDirty = true;
+		}
+
+		void SetRadius(uint32_t index, float sphereRadius)
+		{
+			radius[index] = sphereRadius;
+			radiusSquared[index] = sphereRadius * sphereRadius;
+			isDirty = true;
+		}
+
+		Vector3 GetOrigin(uint32_t index) const { return { originX[index], originY[index], originZ[index] }; }
+		Sphere GetSphere(uint32_t index) const { return { GetOrigin(index), radius[index], materialIndices[index] }; }
+		uint32_t GetCount() const { return static_cast<uint32_t>(radius.size()); }
+
+		void Reserve(size_t capacity)
+		{
+			originX.reserve(capacity);
+			originY.reserve(capacity);
+			originZ.reserve(capacity);
+			radius.reserve(capacity);
+			radiusSquared.reserve(capacity);
+			materialIndices.reserve(capacity);
+		}
+
+		void GetBounds(uint32_t index, Vector3& sphereMin, Vector3& sphereMax) const
+		{
+			const Vector3 extent{ radius[index], radius[index], radius[index] };
+			sphereMin = GetOrigin(index) - extent;
+			sphereMax = GetOrigin(index) + extent;
+		}
+
+		//Refit the BVH after spheres moved, rebuild when spheres were added or the tree degraded too much
+		void UpdateBVH()
+		{
+			if (!isDirty)
+				return;
+
+			isDirty = false;
+
+			if (bvh.IsEmpty() || bvh.GetPrimitiveCount() != GetCount())
+				RebuildBVH();
+			else
+			{
+				bvh.Refit([this](uint32_t sphereIndex, Vector3& sphereMin, Vector3& sphereMax) { GetBounds(sphereIndex, sphereMin, sphereMax); });
+
+				if (bvh.GetDegradation() > bvhRebuildThreshold)
+					RebuildBVH();
+			}
+
+			sphereBlocks.Build(bvh, originX, originY, originZ, radiusSquared);
+		}
+
+		void RebuildBVH()
+		{
+			std::vector<Vector3> sphereMin(GetCount());
+			std::vector<Vector3> sphereMax(GetCount());
+
+			for (uint32_t i{ 0 }; i < GetCount(); ++i)
+				GetBounds(i, sphereMin[i], sphereMax[i]);
+
+			bvh.Build(sphereMin, sphereMax, SphereBlock::Width);
+		}
+	};
+
 	struct Plane
 	{
 		Vector3 origin{};
@@ -56,6 +160,18 @@ namespace dae
 		unsigned char materialIndex{};
 	};
 
+	//Precomputed for the Moller-Trumbore kernel: one vertex + the two edges leaving it
+	struct TriangleRecord
+	{
+		TriangleRecord() = default;
+		TriangleRecord(const Vector3& _v0, const Vector3& _v1, const Vector3& _v2) :
+			v0{ _v0 }, edge1{ _v1 - _v0 }, edge2{ _v2 - _v0 }{}
+
+		Vector3 v0{};
+		Vector3 edge1{};
+		Vector3 edge2{};
+	};
+
 	struct TriangleMesh
 	{
 		TriangleMesh() = default;
@@ -95,6 +211,11 @@ namespace dae
 		std::vector<Vector3> transformedPositions{};
 		std::vector<Vector3> transformedNormals{};
 
+		//Built over transformedPositions, one primitive per triangle
+		BVH bvh{};
+		TriangleBlockBuffer triangleBlocks{};
+		float bvhRebuildThreshold{ 1.5f };
+
 		void Translate(const Vector3& translation)
 		{
 			translationTransform = Matrix::CreateTranslation(translation);
@@ -140,6 +261,7 @@ namespace dae
 			}
 		}
 
+		//O(vertices): retransforms every vertex, refits the BVH and rebuilds the triangle blocks. Meshes that move every frame belong in a TriangleMeshInstance
 		void UpdateTransforms()
 		{
 			transformedPositions.clear();
@@ -175,6 +297,75 @@ namespace dae
 			if (transformedNormals.size() < normals.size())
 				for (const auto& normal : normals)
 					transformedNormals.emplace_back(rotationTransform.TransformVector(normal));
+
+			UpdateBVH();
+
+			//Leaf layout only changes on a rebuild, but the vertices moved either way
+			triangleBlocks.Build(bvh, transformedPositions, indices);
+		}
+
+		//Refit the BVH after a transform change, rebuild once it is this much more expensive than a fresh build
+		void UpdateBVH()
+		{
+			const size_t numTriangles{ indices.size() / 3 };
+
+			if (bvh.IsEmpty() || bvh.GetPrimitiveCount() != numTriangles)
+			{
+				RebuildBVH();
+				return;
+			}
+
+			bvh.Refit([this](uint32_t triangleIndex, Vector3& triangleMin, Vector3& triangleMax)
+				{
+					const size_t index{ static_cast<size_t>(triangleIndex) * 3 };
+					const Vector3& v0{ transformedPositions[indices[index]] };
+					const Vector3& v1{ transformedPositions[indices[index + 1]] };
+					const Vector3& v2{ transformedPositions[indices[index + 2]] };
+
+					triangleMin = Vector3::Min(v0, Vector3::Min(v1, v2));
+					triangleMax = Vector3::Max(v0, Vector3::Max(v1, v2));
+				});
+
+			if (bvh.GetDegradation() > bvhRebuildThreshold)
+			{
+				RebuildBVH();
+				return;
+			}
+
+			UpdateBVHBounds();
+		}
+
+		void RebuildBVH()
+		{
+			const size_t numTriangles{ indices.size() / 3 };
+
+			std::vector<Vector3> triangleMin{};
+			std::vector<Vector3> triangleMax{};
+			triangleMin.reserve(numTriangles);
+			triangleMax.reserve(numTriangles);
+
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				const Vector3& v0{ transformedPositions[indices[i]] };
+				const Vector3& v1{ transformedPositions[indices[i + 1]] };
+				const Vector3& v2{ transformedPositions[indices[i + 2]] };
+
+				triangleMin.emplace_back(Vector3::Min(v0, Vector3::Min(v1, v2)));
+				triangleMax.emplace_back(Vector3::Max(v0, Vector3::Max(v1, v2)));
+			}
+
+			bvh.Build(triangleMin, triangleMax, TriangleBlock::Width);
+			UpdateBVHBounds();
+		}
+
+		//Root bounds are exact, the transformed corners of minAABB/maxAABB are only an upper bound (and stay empty without UpdateAABB)
+		void UpdateBVHBounds()
+		{
+			if (!bvh.IsEmpty())
+			{
+				transformedMinAABB = bvh.GetNodes()[0].minAABB;
+				transformedMaxAABB = bvh.GetNodes()[0].maxAABB;
+			}
 		}
 
 		void UpdateAABB()
@@ -239,6 +430,135 @@ namespace dae
 			transformedMaxAABB = tMaxAABB;
 		}
 	};
+
+	//Object space mesh data, shared (read-only) between all TriangleMeshInstances that use it
+	struct TriangleMeshGeometry
+	{
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{}; //one per triangle
+		std::vector<int> indices{};
+
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+
+		BVH bvh{};
+		TriangleBlockBuffer triangleBlocks{};
+
+		//Call once after filling positions/indices (and optionally normals), the geometry is immutable afterwards
+		void Build()
+		{
+			if (normals.size() < indices.size() / 3)
+			{
+				normals.clear();
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					const Vector3 a{ positions[indices[i + 1]] - positions[indices[i]] };
+					const Vector3 b{ positions[indices[i + 2]] - positions[indices[i]] };
+
+					normals.emplace_back(Vector3::Cross(a, b).Normalized());
+				}
+			}
+
+			const size_t numTriangles{ indices.size() / 3 };
+
+			std::vector<Vector3> triangleMin{};
+			std::vector<Vector3> triangleMax{};
+			triangleMin.reserve(numTriangles);
+			triangleMax.reserve(numTriangles);
+
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				const Vector3& v0{ positions[indices[i]] };
+				const Vector3& v1{ positions[indices[i + 1]] };
+				const Vector3& v2{ positions[indices[i + 2]] };
+
+				triangleMin.emplace_back(Vector3::Min(v0, Vector3::Min(v1, v2)));
+				triangleMax.emplace_back(Vector3::Max(v0, Vector3::Max(v1, v2)));
+			}
+
+			bvh.Build(triangleMin, triangleMax, TriangleBlock::Width);
+			triangleBlocks.Build(bvh, positions, indices);
+
+			if (!bvh.IsEmpty())
+			{
+				minAABB = bvh.GetNodes()[0].minAABB;
+				maxAABB = bvh.GetNodes()[0].maxAABB;
+			}
+		}
+	};
+
+	//Placement of a shared TriangleMeshGeometry: rays get transformed into object space, the vertices never move
+	struct TriangleMeshInstance
+	{
+		std::shared_ptr<const TriangleMeshGeometry> pGeometry{};
+
+		unsigned char materialIndex{};
+		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+
+		Matrix rotationTransform{};
+		Matrix translationTransform{};
+		Matrix scaleTransform{};
+
+		Matrix transform{};
+		Matrix inverseTransform{};
+
+		Vector3 transformedMinAABB{};
+		Vector3 transformedMaxAABB{};
+
+		void Translate(const Vector3& translation)
+		{
+			translationTransform = Matrix::CreateTranslation(translation);
+		}
+
+		void RotateY(float yaw)
+		{
+			rotationTransform = Matrix::CreateRotationY(yaw);
+		}
+
+		void Scale(const Vector3& scale)
+		{
+			scaleTransform = Matrix::CreateScale(scale);
+		}
+
+		//O(1), independent of the vertex count
+		void UpdateTransforms()
+		{
+			//Same order as TriangleMesh::UpdateTransforms
+			transform = translationTransform * rotationTransform * scaleTransform;
+			inverseTransform = Matrix::Inverse(transform);
+
+			if (!pGeometry)
+				return;
+
+			//World AABB: transform the 8 corners of the object space AABB
+			const Vector3& minAABB{ pGeometry->minAABB };
+			const Vector3& maxAABB{ pGeometry->maxAABB };
+
+			transformedMinAABB = transform.TransformPoint(minAABB);
+			transformedMaxAABB = transformedMinAABB;
+
+			for (int corner{ 1 }; corner < 8; ++corner)
+			{
+				const Vector3 point{ transform.TransformPoint(
+					corner & 1 ? maxAABB.x : minAABB.x,
+					corner & 2 ? maxAABB.y : minAABB.y,
+					corner & 4 ? maxAABB.z : minAABB.z) };
+
+				transformedMinAABB = Vector3::Min(point, transformedMinAABB);
+				transformedMaxAABB = Vector3::Max(point, transformedMaxAABB);
+			}
+		}
+
+		//Object space normal to world space (inverse transpose)
+		Vector3 TransformNormal(const Vector3& normal) const
+		{
+			return Vector3{
+				Vector3::Dot(normal, inverseTransform.GetAxisX()),
+				Vector3::Dot(normal, inverseTransform.GetAxisY()),
+				Vector3::Dot(normal, inverseTransform.GetAxisZ())
+			}.Normalized();
+		}
+	};
 #pragma endregion
 #pragma region LIGHT
 	enum class LightType
@@ -267,6 +587,90 @@ namespace dae
 		float max{ FLT_MAX };
 	};
 
+	/**
+	 * \brief 4x4 bundle of rays traced together, stored as structure-of-arrays. Lanes are addressed with bit masks.
+	 * Rays that share their origin (camera rays) also get the frustum spanned by the corner rays, whole nodes can be culled with it.
+	 */
+	struct alignas(32) RayPacket
+	{
+		static constexpr uint32_t Width{ 4 };
+		static constexpr uint32_t Size{ Width * Width };
+		static constexpr uint32_t AllLanes{ (1u << Size) - 1 };
+
+		float originX[Size]{};
+		float originY[Size]{};
+		float originZ[Size]{};
+		float directionX[Size]{};
+		float directionY[Size]{};
+		float directionZ[Size]{};
+		float inverseDirectionX[Size]{};
+		float inverseDirectionY[Size]{};
+		float inverseDirectionZ[Size]{};
+		float min[Size]{};
+		float max[Size]{};
+
+		//Planes through the common origin, normals point into the frustum. Only valid when hasFrustum
+		Vector3 frustumNormals[4]{};
+		bool hasFrustum{ false };
+
+		void SetRay(uint32_t lane, const Ray& ray)
+		{
+			originX[lane] = ray.origin.x;
+			originY[lane] = ray.origin.y;
+			originZ[lane] = ray.origin.z;
+			directionX[lane] = ray.direction.x;
+			directionY[lane] = ray.direction.y;
+			directionZ[lane] = ray.direction.z;
+			inverseDirectionX[lane] = 1.f / ray.direction.x;
+			inverseDirectionY[lane] = 1.f / ray.direction.y;
+			inverseDirectionZ[lane] = 1.f / ray.direction.z;
+			min[lane] = ray.min;
+			max[lane] = ray.max;
+		}
+
+		Vector3 GetOrigin(uint32_t lane) const { return { originX[lane], originY[lane], originZ[lane] }; }
+		Vector3 GetDirection(uint32_t lane) const { return { directionX[lane], directionY[lane], directionZ[lane] }; }
+		Ray GetRay(uint32_t lane) const { return { GetOrigin(lane), GetDirection(lane), min[lane], max[lane] }; }
+
+		//Largest max over the given lanes, nodes that start behind it can be skipped
+		float GetMaxT(uint32_t laneMask) const
+		{
+			float maxT{ -FLT_MAX };
+			for (uint32_t lane{ 0 }; lane < Size; ++lane)
+				if ((laneMask & (1u << lane)) != 0)
+					maxT = std::max(maxT, max[lane]);
+
+			return maxT;
+		}
+
+		//Call after every lane is set. Lanes have to be laid out row by row, so lanes 0, Width - 1, Size - 1 and Size - Width are the corners
+		void UpdateFrustum()
+		{
+			hasFrustum = false;
+
+			for (uint32_t lane{ 1 }; lane < Size; ++lane)
+				if (originX[lane] != originX[0] || originY[lane] != originY[0] || originZ[lane] != originZ[0])
+					return;
+
+			const uint32_t corners[4]{ 0, Width - 1, Size - 1, Size - Width };
+			const Vector3 center{ GetDirection(corners[0]) + GetDirection(corners[1]) + GetDirection(corners[2]) + GetDirection(corners[3]) };
+
+			for (uint32_t i{ 0 }; i < 4; ++i)
+			{
+				Vector3 normal{ Vector3::Cross(GetDirection(corners[i]), GetDirection(corners[(i + 1) % 4])) };
+				if (normal.SqrMagnitude() == 0.f)
+					return;
+
+				if (Vector3::Dot(normal, center) < 0.f)
+					normal = -normal;
+
+				frustumNormals[i] = normal.Normalized();
+			}
+
+			hasFrustum = true;
+		}
+	};
+
 	struct HitRecord
 	{
 		Vector3 origin{};
@@ -276,5 +680,22 @@ namespace dae
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
 	};
+
+	//Primitive that blocked the last shadow ray, Scene::DoesHit tests it before anything else. Keep one per thread and per light
+	struct Occluder
+	{
+		enum class Type : uint8_t
+		{
+			None,
+			Plane,
+			Sphere,
+			TriangleMesh,
+			TriangleMeshInstance
+		};
+
+		Type type{ Type::None };
+		uint32_t objectIndex{}; //plane, sphere, mesh or instance index
+		uint32_t triangleIndex{}; //meshes and instances only
+	};
 #pragma endregion
 }
\ No newline at end of file
@@ -0,0 +1,304 @@
+#include "ExecutionBackend.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <numeric>
+#include <vector>
+#include <version>
+
+#if defined(__cpp_lib_parallel_algorithm)
+#include <execution>
+#endif
+
+//libstdc++ picks the TBB backend when the TBB headers are found (the binary then has to link tbb) and silently falls back to a serial one otherwise
+#if defined(_PSTL_PAR_BACKEND_SERIAL) || defined(__PSTL_PAR_BACKEND_SERIAL)
+#define RAY_STDPAR_IS_SERIAL
+#endif
+
+#include "ThreadPool.h"
+
+namespace dae
+{
+	namespace
+	{
+		class SerialBackend final : public ExecutionBackend
+		{
+		public:
+			void Run(uint32_t numTasks, const std::function<void(uint32_t taskIndex)>& task) override
+			{
+				for (uint32_t taskIndex{ 0 }; taskIndex < numTasks; ++taskIndex)
+					task(taskIndex);
+			}
+		};
+
+		class ThreadPoolBackend final : public ExecutionBackend
+		{
+		public:
+			explicit ThreadPoolBackend(ThreadPool& threadPool) : m_ThreadPool{ threadPool } {}
+
+			void Run(uint32_t numTasks, const std::function<void(uint32_t taskIndex)>& task) override
+			{
+				if (numTasks <= 1 || m_ThreadPool.GetNumThreads() == 1)
+				{
+					for (uint32_t taskIndex{ 0 }; taskIndex < numTasks; ++taskIndex)
+						task(taskIndex);
+
+					return;
+				}
+
+				m_NextTask.store(0, std::memory_order_relaxed);
+
+				m_ThreadPool.Execute([&](uint32_t)
+					{
+						for (uint32_t taskIndex{ m_NextTask.fetch_add(1) }; taskIndex < numTasks; taskIndex = m_NextTask.fetch_add(1))
+							task(taskIndex);
+					});
+			}
+
+		private:
+			ThreadPool& m_ThreadPool;
+
+			alignas(64) std::atomic<uint32_t> m_NextTask{ 0 };
+		};
+
+#if defined(_OPENMP)
+		class OpenMPBackend final : public ExecutionBackend
+		{
+		public:
+			void Run(uint32_t numTasks, const std::function<void(uint32_t taskIndex)>& task) override
+			{
+				//MSVC only supports OpenMP 2.0: signed loop index
+				const int count{ static_cast<int>(numTasks) };
+
+#pragma omp parallel for schedule(dynamic)
+				for (int taskIndex = 0; taskIndex < count; ++taskIndex)
+					task(static_cast<uint32_t>(taskIndex));
+			}
+		};
+#endif
+
+		/**
+		 * \brief Every thread starts on its own contiguous range of tasks (neighbouring tiles stay on one thread)
+		 * and steals the back half of another thread's range once it runs dry.
+		 */
+		class WorkStealingBackend final : public ExecutionBackend
+		{
+		public:
+			explicit WorkStealingBackend(ThreadPool& threadPool) :
+				m_ThreadPool{ threadPool },
+				m_pQueues{ std::make_unique<WorkerQueue[]>(threadPool.GetNumThreads()) }
+			{
+			}
+
+			void Run(uint32_t numTasks, const std::function<void(uint32_t taskIndex)>& task) override
+			{
+				const uint32_t numWorkers{ std::min(m_ThreadPool.GetNumThreads(), numTasks) };
+
+				if (numWorkers <= 1)
+				{
+					for (uint32_t taskIndex{ 0 }; taskIndex < numTasks; ++taskIndex)
+						task(taskIndex);
+
+					return;
+				}
+
+				//Even split up front, stealing only has to even out the cost differences between tasks
+				for (uint32_t worker{ 0 }; worker < numWorkers; ++worker)
+				{
+					const uint32_t begin{ static_cast<uint32_t>(static_cast<uint64_t>(numTasks) * worker / numWorkers) };
+					const uint32_t end{ static_cast<uint32_t>(static_cast<uint64_t>(numTasks) * (worker + 1) / numWorkers) };
+					m_pQueues[worker].range.store(PackRange(begin, end));
+				}
+
+				//Fewer tasks than threads: the surplus threads wake up and go right back to sleep
+				m_ThreadPool.Execute([&](uint32_t worker)
+					{
+						if (worker < numWorkers)
+							RunWorker(worker, numWorkers, task);
+					});
+			}
+
+		private:
+			//Remaining tasks [begin, end) packed in one word (begin in the low half), so popping and stealing are a single CAS
+			struct alignas(64) WorkerQueue
+			{
+				std::atomic<uint64_t> range{};
+			};
+
+			ThreadPool& m_ThreadPool;
+			std::unique_ptr<WorkerQueue[]> m_pQueues{};
+
+			static uint64_t PackRange(uint32_t begin, uint32_t end) { return static_cast<uint64_t>(end) << 32 | begin; }
+			static uint32_t GetRangeBegin(uint64_t range) { return static_cast<uint32_t>(range); }
+			static uint32_t GetRangeEnd(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+
+			void RunWorker(uint32_t worker, uint32_t numWorkers, const std::function<void(uint32_t taskIndex)>& task)
+			{
+				//Only the owner ever refills its queue, so a worker that finds nothing to steal can stop: whatever is left gets finished by its owner
+				uint32_t taskIndex{};
+				while (PopTask(worker, taskIndex) || StealTask(worker, numWorkers, taskIndex))
+					task(taskIndex);
+			}
+
+			bool PopTask(uint32_t worker, uint32_t& taskIndex)
+			{
+				std::atomic<uint64_t>& queue = m_pQueues[worker].range;
+				uint64_t range{ queue.load() };
+
+				while (GetRangeBegin(range) < GetRangeEnd(range))
+				{
+					if (queue.compare_exchange_weak(range, PackRange(GetRangeBegin(range) + 1, GetRangeEnd(range))))
+					{
+						taskIndex = GetRangeBegin(range);
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			bool StealTask(uint32_t worker, uint32_t numWorkers, uint32_t& taskIndex)
+			{
+				for (uint32_t offset{ 1 }; offset < numWorkers; ++offset)
+				{
+					std::atomic<uint64_t>& victimQueue = m_pQueues[(worker + offset) % numWorkers].range;
+					uint64_t range{ victimQueue.load() };
+
+					while (GetRangeBegin(range) < GetRangeEnd(range))
+					{
+						//Take the back half, the victim keeps working through the front
+						const uint32_t begin{ GetRangeBegin(range) };
+						const uint32_t end{ GetRangeEnd(range) };
+						const uint32_t middle{ begin + (end - begin) / 2 };
+
+						if (!victimQueue.compare_exchange_weak(range, PackRange(begin, middle)))
+							continue;
+
+						//Own queue is empty (PopTask failed), nobody else writes to it
+						taskIndex = middle;
+						m_pQueues[worker].range.store(PackRange(middle + 1, end));
+						return true;
+					}
+				}
+
+				return false;
+			}
+		};
+
+#if defined(__cpp_lib_parallel_algorithm)
+		class StdParBackend final : public ExecutionBackend
+		{
+		public:
+			void Run(uint32_t numTasks, const std::function<void(uint32_t taskIndex)>& task) override
+			{
+				//Parallel algorithms need forward iterators, so the indices get materialized once
+				if (m_TaskIndices.size() < numTasks)
+				{
+					m_TaskIndices.resize(numTasks);
+					std::iota(m_TaskIndices.begin(), m_TaskIndices.end(), 0u);
+				}
+
+				std::for_each(std::execution::par, m_TaskIndices.begin(), m_TaskIndices.begin() + numTasks, [&](uint32_t taskIndex) { task(taskIndex); });
+			}
+
+		private:
+			std::vector<uint32_t> m_TaskIndices{};
+		};
+#endif
+	}
+
+	std::unique_ptr<ExecutionBackend> CreateExecutionBackend(ExecutionBackendType type, ThreadPool& threadPool)
+	{
+		switch (type)
+		{
+		case ExecutionBackendType::Serial:
+			return std::make_unique<SerialBackend>();
+
+		case ExecutionBackendType::ThreadPool:
+			return std::make_unique<ThreadPoolBackend>(threadPool);
+
+		case ExecutionBackendType::OpenMP:
+#if defined(_OPENMP)
+			return std::make_unique<OpenMPBackend>();
+#else
+			break;
+#endif
+
+		case ExecutionBackendType::WorkStealing:
+			return std::make_unique<WorkStealingBackend>(threadPool);
+
+		case ExecutionBackendType::StdPar:
+#if defined(__cpp_lib_parallel_algorithm)
+#if defined(RAY_STDPAR_IS_SERIAL)
+			std::cout << "Warning: std::execution::par runs serially in this build (libstdc++ without TBB), install TBB and link it for a parallel stdpar backend" << std::endl;
+#endif
+			return std::make_unique<StdParBackend>();
+#else
+			break;
+#endif
+		}
+
+		return nullptr;
+	}
+
+	bool IsExecutionBackendAvailable(ExecutionBackendType type)
+	{
+		switch (type)
+		{
+		case ExecutionBackendType::OpenMP:
+#if defined(_OPENMP)
+			return true;
+#else
+			return false;
+#endif
+
+		case ExecutionBackendType::StdPar:
+#if defined(__cpp_lib_parallel_algorithm)
+			return true;
+#else
+			return false;
+#endif
+
+		default:
+			return true;
+		}
+	}
+
+	const char* GetExecutionBackendName(ExecutionBackendType type)
+	{
+		switch (type)
+		{
+		case ExecutionBackendType::Serial:
+			return "serial";
+
+		case ExecutionBackendType::ThreadPool:
+			return "threadpool";
+
+		case ExecutionBackendType::OpenMP:
+			return "openmp";
+
+		case ExecutionBackendType::WorkStealing:
+			return "workstealing";
+
+		case ExecutionBackendType::StdPar:
+			return "stdpar";
+		}
+
+		return "unknown";
+	}
+
+	bool ParseExecutionBackend(const std::string& name, ExecutionBackendType& type)
+	{
+		for (const ExecutionBackendType candidate : { ExecutionBackendType::Serial, ExecutionBackendType::ThreadPool, ExecutionBackendType::OpenMP, ExecutionBackendType::WorkStealing, ExecutionBackendType::StdPar })
+		{
+			if (name == GetExecutionBackendName(candidate))
+			{
+				type = candidate;
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,47 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace dae
+{
+	class ThreadPool;
+
+	enum class ExecutionBackendType
+	{
+		Serial, //Everything on the calling thread
+		ThreadPool, //Persistent pool, the threads grab the next task from one shared counter
+		OpenMP, //parallel for with a dynamic schedule, only when built with OpenMP
+		WorkStealing, //Persistent pool, per thread task ranges + stealing
+		StdPar //std::for_each with std::execution::par, only when the standard library has parallel algorithms. libstdc++ needs TBB (headers + -ltbb) for them, otherwise they run serially
+	};
+
+	/**
+	 * \brief Runs a batch of independent tasks. Every render pass goes through one, so the threading model can be switched at runtime.
+	 * Tasks may run in any order and on any thread, thread_local state has to be valid across tasks.
+	 */
+	class ExecutionBackend
+	{
+	public:
+		ExecutionBackend() = default;
+		virtual ~ExecutionBackend() = default;
+
+		ExecutionBackend(const ExecutionBackend&) = delete;
+		ExecutionBackend(ExecutionBackend&&) noexcept = delete;
+		ExecutionBackend& operator=(const ExecutionBackend&) = delete;
+		ExecutionBackend& operator=(ExecutionBackend&&) noexcept = delete;
+
+		//Runs task(0) ... task(numTasks - 1) and returns once all of them finished
+		virtual void Run(uint32_t numTasks, const std::function<void(uint32_t taskIndex)>& task) = 0;
+	};
+
+	//threadPool is only used by the pool based backends, it has to outlive the backend. Returns nullptr when the backend is not available
+	std::unique_ptr<ExecutionBackend> CreateExecutionBackend(ExecutionBackendType type, ThreadPool& threadPool);
+
+	bool IsExecutionBackendAvailable(ExecutionBackendType type);
+	const char* GetExecutionBackendName(ExecutionBackendType type);
+	//Inverse of GetExecutionBackendName ("serial", "threadpool", "openmp", "workstealing", "stdpar")
+	bool ParseExecutionBackend(const std::string& name, ExecutionBackendType& type);
+}
@@ -0,0 +1,208 @@
+#include "FrameTrace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dae
+{
+	namespace
+	{
+		struct TraceEvent
+		{
+			const char* name{};
+			int64_t start{}; //nanoseconds since the capture started
+			int64_t duration{}; //-1: instant event (frame marker)
+		};
+
+		struct ThreadTrace
+		{
+			uint32_t threadIndex{};
+			std::string name{};
+			std::vector<TraceEvent> events{};
+		};
+
+		//Buffers of every thread that ever recorded a zone or got a name, threads of the pool live as long as the renderer so this stays small
+		struct TraceState
+		{
+			std::mutex mutex{};
+			std::vector<std::unique_ptr<ThreadTrace>> threads{};
+
+			std::string filePath{};
+			uint32_t numFrames{};
+			uint32_t skipFrames{};
+			uint32_t numRecordedFrames{};
+			bool isCapturePending{ false };
+
+			std::chrono::steady_clock::time_point captureStart{};
+		};
+
+		TraceState& GetState()
+		{
+			static TraceState state{};
+			return state;
+		}
+
+		ThreadTrace& GetThreadTrace()
+		{
+			thread_local ThreadTrace* pThreadTrace{ nullptr };
+
+			if (!pThreadTrace)
+			{
+				TraceState& state = GetState();
+				const std::lock_guard lock{ state.mutex };
+
+				auto& pNew = state.threads.emplace_back(std::make_unique<ThreadTrace>());
+				pNew->threadIndex = static_cast<uint32_t>(state.threads.size() - 1);
+				pNew->name = "thread " + std::to_string(pNew->threadIndex);
+				pThreadTrace = pNew.get();
+			}
+
+			return *pThreadTrace;
+		}
+
+		void WriteEscaped(std::ostream& json, const std::string& text)
+		{
+			for (const char c : text)
+			{
+				if (c == '"' || c == '\\')
+					json << '\\';
+				json << c;
+			}
+		}
+
+		//Trace-event timestamps are in microseconds
+		bool WriteTrace(const TraceState& state)
+		{
+			std::ofstream json{ state.filePath };
+			if (!json)
+				return false;
+
+			json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			bool isFirst{ true };
+			const auto separator = [&]() -> std::ostream&
+				{
+					json << (isFirst ? "" : ",\n");
+					isFirst = false;
+					return json;
+				};
+
+			for (const auto& pThread : state.threads)
+			{
+				separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pThread->threadIndex << ",\"args\":{\"name\":\"";
+				WriteEscaped(json, pThread->name);
+				json << "\"}}";
+
+				for (const TraceEvent& event : pThread->events)
+				{
+					separator() << "{\"name\":\"";
+					WriteEscaped(json, event.name);
+					json << "\",\"pid\":1,\"tid\":" << pThread->threadIndex << ",\"ts\":" << static_cast<double>(event.start) / 1000.0;
+
+					if (event.duration < 0)
+						json << ",\"ph\":\"i\",\"s\":\"g\"}";
+					else
+						json << ",\"ph\":\"X\",\"dur\":" << static_cast<double>(event.duration) / 1000.0 << "}";
+				}
+			}
+
+			json << "\n]}\n";
+			return static_cast<bool>(json);
+		}
+	}
+
+	std::atomic<bool> FrameTrace::Detail::g_IsRecording{ false };
+
+	void FrameTrace::Capture(const std::string& filePath, uint32_t numFrames, uint32_t skipFrames)
+	{
+		TraceState& state = GetState();
+		const std::lock_guard lock{ state.mutex };
+
+		state.filePath = filePath;
+		state.numFrames = std::max(numFrames, 1u);
+		state.skipFrames = skipFrames;
+		state.numRecordedFrames = 0;
+		state.isCapturePending = true;
+
+		for (const auto& pThread : state.threads)
+			pThread->events.clear();
+
+		//Starting right away when nothing has to be skipped, otherwise the next EndFrame calls count down
+		if (skipFrames == 0)
+		{
+			state.captureStart = std::chrono::steady_clock::now();
+			Detail::g_IsRecording.store(true, std::memory_order_release);
+		}
+	}
+
+	bool FrameTrace::IsCapturePending()
+	{
+		TraceState& state = GetState();
+		const std::lock_guard lock{ state.mutex };
+		return state.isCapturePending;
+	}
+
+	void FrameTrace::SetThreadName(const char* name)
+	{
+		ThreadTrace& threadTrace = GetThreadTrace();
+
+		const std::lock_guard lock{ GetState().mutex };
+		threadTrace.name = name;
+	}
+
+	bool FrameTrace::EndFrame()
+	{
+		//Registers the calling thread before the lock is taken
+		ThreadTrace& callerTrace = GetThreadTrace();
+
+		TraceState& state = GetState();
+		const std::lock_guard lock{ state.mutex };
+
+		if (!state.isCapturePending)
+			return false;
+
+		if (!Detail::IsRecording())
+		{
+			if (--state.skipFrames == 0)
+			{
+				state.captureStart = std::chrono::steady_clock::now();
+				Detail::g_IsRecording.store(true, std::memory_order_release);
+			}
+			return false;
+		}
+
+		//Frame boundary marker
+		callerTrace.events.push_back({ "Frame", std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - state.captureStart).count(), -1 });
+
+		if (++state.numRecordedFrames < state.numFrames)
+			return false;
+
+		Detail::g_IsRecording.store(false, std::memory_order_relaxed);
+		state.isCapturePending = false;
+
+		const bool isWritten{ WriteTrace(state) };
+		if (!isWritten)
+			std::cout << "Could not write " << state.filePath << std::endl;
+
+		for (const auto& pThread : state.threads)
+			pThread->events.clear();
+
+		return isWritten;
+	}
+
+	void FrameTrace::Detail::AddZone(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+	{
+		//The capture may have ended while the zone was open
+		if (!IsRecording())
+			return;
+
+		const auto& captureStart = GetState().captureStart;
+		GetThreadTrace().events.push_back({
+			name,
+			std::chrono::duration_cast<std::chrono::nanoseconds>(start - captureStart).count(),
+			std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() });
+	}
+}
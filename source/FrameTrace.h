@@ -0,0 +1,67 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#define TRACE_ZONE_CONCAT_INNER(a, b) a##b
+#define TRACE_ZONE_CONCAT(a, b) TRACE_ZONE_CONCAT_INNER(a, b)
+//Scoped zone, name has to be a string literal (only the pointer gets stored)
+#define TRACE_ZONE(name) const ::dae::TraceZone TRACE_ZONE_CONCAT(traceZone, __LINE__){ name }
+
+namespace dae
+{
+	/**
+	 * \brief Records TRACE_ZONEs of every thread for a window of frames and writes them as Chrome trace-event JSON (chrome://tracing, Perfetto).
+	 * Every thread appends to its own buffer, the buffers are only touched by other threads in EndFrame, so call that while no worker runs.
+	 * Outside of a capture a zone costs one atomic load.
+	 */
+	namespace FrameTrace
+	{
+		//Starts recording after skipFrames more EndFrame calls and writes filePath once numFrames frames are recorded
+		void Capture(const std::string& filePath, uint32_t numFrames, uint32_t skipFrames = 0);
+		bool IsCapturePending();
+
+		//Shown instead of "thread <index>" in the viewer
+		void SetThreadName(const char* name);
+
+		//Call once at the end of every frame on the main thread, returns true when it just wrote the trace file
+		bool EndFrame();
+
+		namespace Detail
+		{
+			extern std::atomic<bool> g_IsRecording;
+
+			//Acquire: a thread that sees the capture running also sees its start time
+			inline bool IsRecording() { return g_IsRecording.load(std::memory_order_acquire); }
+			void AddZone(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+		}
+	}
+
+	class TraceZone final
+	{
+	public:
+		explicit TraceZone(const char* name) :
+			m_Name{ FrameTrace::Detail::IsRecording() ? name : nullptr }
+		{
+			if (m_Name)
+				m_Start = std::chrono::steady_clock::now();
+		}
+
+		~TraceZone()
+		{
+			if (m_Name)
+				FrameTrace::Detail::AddZone(m_Name, m_Start, std::chrono::steady_clock::now());
+		}
+
+		TraceZone(const TraceZone&) = delete;
+		TraceZone(TraceZone&&) noexcept = delete;
+		TraceZone& operator=(const TraceZone&) = delete;
+		TraceZone& operator=(TraceZone&&) noexcept = delete;
+
+	private:
+		const char* m_Name; //nullptr when the zone started outside of a capture
+		std::chrono::steady_clock::time_point m_Start{};
+	};
+}
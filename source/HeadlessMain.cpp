@@ -0,0 +1,366 @@
+//Headless front end: renders a scene into an owned framebuffer and writes the frames to disk, no window and no SDL (see Platform.h)
+//Command line: see Usage below (RayTracerHeadless --help)
+
+//Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+
+//Project includes
+#include "Benchmark.h"
+#include "CameraPath.h"
+#include "CommandLine.h"
+#include "ExecutionBackend.h"
+#include "FrameTrace.h"
+#include "MeshCache.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "SceneDescription.h"
+#include "Timer.h"
+
+using namespace dae;
+
+namespace
+{
+	constexpr const char* Usage{ R"(Usage: RayTracerHeadless [--scene W4_Bunny] [--width 640] [--height 480] [--frames 1] [--camera-path static|sweep|<file>]
+                         [--output frame|none] [--backend workstealing] [--time-step 0.0333] [--cost-view off|time|traversal|primitives]
+                         [--trace <file.json>] [--trace-frames <all>] [--trace-skip 0] [--budget 33.3 (ms)] [--asset-loading wait|progressive]
+                         [--mesh-cache <directory>|none (default: the user cache directory)]
+progressive starts rendering right away and lets the meshes appear as they finish loading (like the window does), wait renders the complete scene only
+A cost view renders the heatmap into the frames and also writes the raw per pixel costs as <output>_cost_<frame>.pfm
+Scene export: RayTracerHeadless --scene <name|file.scene> --export-scene <file.sceneb> writes the binary form and exits
+Benchmark suite: RayTracerHeadless --benchmark benchmark.json [--scene <only this one>] [--frames 100] [--warm-up 10] [--width] [--height] [--backend] [--time-step] [--budget 33.3 (ms)])" };
+
+	struct HeadlessSettings
+	{
+		std::string sceneName{}; //W4_Bunny, the benchmark runs every scene
+		int width{ 640 };
+		int height{ 480 };
+		int numFrames{ 0 }; //1, the benchmark renders 100
+		int numWarmUpFrames{ 10 };
+		std::string benchmarkPath{};
+		std::string exportScenePath{};
+		std::string cameraPath{ "static" };
+		std::string outputPrefix{ "frame" };
+		ExecutionBackendType backend{ ExecutionBackendType::WorkStealing };
+		Renderer::CostView costView{ Renderer::CostView::Off };
+		std::string tracePath{};
+		int numTraceFrames{ 0 }; //0: every frame after the skipped ones
+		int numTraceSkipFrames{ 0 };
+		float timeStep{ 1.f / 30.f };
+		float frameBudget{ 1.f / 30.f };
+		bool isLoadingProgressive{ false };
+		std::string meshCacheDirectory{}; //empty: default, "none": no mesh cache
+		bool showUsage{ false };
+	};
+
+	bool ParseCostView(const std::string& name, Renderer::CostView& costView)
+	{
+		for (const Renderer::CostView candidate : { Renderer::CostView::Off, Renderer::CostView::Time, Renderer::CostView::Traversal, Renderer::CostView::Primitives })
+		{
+			if (name == Renderer::GetCostViewName(candidate))
+			{
+				costView = candidate;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool ParseSettings(int argc, char* args[], HeadlessSettings& settings)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const std::string argument{ args[i] };
+			if (argument == "--help" || argument == "-h")
+			{
+				settings.showUsage = true;
+				return true;
+			}
+
+			if (i + 1 >= argc)
+			{
+				std::cout << "Missing value for " << argument << std::endl;
+				return false;
+			}
+
+			const std::string value{ args[++i] };
+
+			if (argument == "--scene")
+				settings.sceneName = value;
+			else if (argument == "--width")
+			{
+				if (!ParseArgumentValue(argument, value, settings.width))
+					return false;
+			}
+			else if (argument == "--height")
+			{
+				if (!ParseArgumentValue(argument, value, settings.height))
+					return false;
+			}
+			else if (argument == "--frames")
+			{
+				if (!ParseArgumentValue(argument, value, settings.numFrames))
+					return false;
+			}
+			else if (argument == "--camera-path")
+				settings.cameraPath = value;
+			else if (argument == "--output")
+				settings.outputPrefix = value;
+			else if (argument == "--time-step")
+			{
+				if (!ParseArgumentValue(argument, value, settings.timeStep))
+					return false;
+			}
+			else if (argument == "--benchmark")
+				settings.benchmarkPath = value;
+			else if (argument == "--export-scene")
+				settings.exportScenePath = value;
+			else if (argument == "--warm-up")
+			{
+				if (!ParseArgumentValue(argument, value, settings.numWarmUpFrames))
+					return false;
+			}
+			else if (argument == "--budget")
+			{
+				if (!ParseArgumentValue(argument, value, settings.frameBudget))
+					return false;
+				settings.frameBudget /= 1000.f;
+			}
+			else if (argument == "--trace")
+				settings.tracePath = value;
+			else if (argument == "--trace-frames")
+			{
+				if (!ParseArgumentValue(argument, value, settings.numTraceFrames))
+					return false;
+			}
+			else if (argument == "--trace-skip")
+			{
+				if (!ParseArgumentValue(argument, value, settings.numTraceSkipFrames))
+					return false;
+			}
+			else if (argument == "--mesh-cache")
+				settings.meshCacheDirectory = value;
+			else if (argument == "--asset-loading")
+			{
+				if (value != "wait" && value != "progressive")
+				{
+					std::cout << "Unknown asset loading " << value << std::endl;
+					return false;
+				}
+				settings.isLoadingProgressive = value == "progressive";
+			}
+			else if (argument == "--cost-view")
+			{
+				if (!ParseCostView(value, settings.costView))
+				{
+					std::cout << "Unknown cost view " << value << std::endl;
+					return false;
+				}
+			}
+			else if (argument == "--backend")
+			{
+				if (!ParseExecutionBackend(value, settings.backend) || !IsExecutionBackendAvailable(settings.backend))
+				{
+					std::cout << "Execution backend " << value << " is not available" << std::endl;
+					return false;
+				}
+			}
+			else
+			{
+				std::cout << "Unknown argument " << argument << " (see --help)" << std::endl;
+				return false;
+			}
+		}
+
+		return CheckArgument(settings.width > 0 && settings.height > 0, "--width and --height need to be at least 1")
+			&& CheckArgument(settings.numFrames >= 0, "--frames can not be negative")
+			&& CheckArgument(settings.numWarmUpFrames >= 0, "--warm-up can not be negative")
+			&& CheckArgument(settings.timeStep > 0.f, "--time-step needs to be positive")
+			&& CheckArgument(settings.frameBudget > 0.f, "--budget needs to be positive")
+			&& CheckArgument(settings.numTraceFrames >= 0 && settings.numTraceSkipFrames >= 0, "--trace-frames and --trace-skip can not be negative");
+	}
+
+	int RunBenchmark(const HeadlessSettings& settings)
+	{
+		BenchmarkSettings benchmarkSettings{};
+		if (!settings.sceneName.empty())
+			benchmarkSettings.sceneNames.emplace_back(settings.sceneName);
+
+		benchmarkSettings.width = settings.width;
+		benchmarkSettings.height = settings.height;
+		benchmarkSettings.numWarmUpFrames = settings.numWarmUpFrames;
+		if (settings.numFrames > 0)
+			benchmarkSettings.numFrames = settings.numFrames;
+		benchmarkSettings.timeStep = settings.timeStep;
+		benchmarkSettings.frameBudget = settings.frameBudget;
+		benchmarkSettings.backend = settings.backend;
+
+		return RunBenchmarkSuite(benchmarkSettings, settings.benchmarkPath) ? 0 : 1;
+	}
+
+	int ExportScene(const HeadlessSettings& settings)
+	{
+		const std::filesystem::path sourcePath{ GetSceneFilePath(settings.sceneName) };
+		SceneDescription description{};
+		if (!LoadSceneDescription(sourcePath.string(), description))
+			return 1;
+
+		//OBJ paths are relative to the scene file, they have to keep pointing at the same files from the exported one
+		const std::filesystem::path exportDirectory{ std::filesystem::absolute(settings.exportScenePath).parent_path() };
+		for (MeshDescription& mesh : description.meshes)
+		{
+			if (!mesh.filePath.empty())
+				mesh.filePath = std::filesystem::absolute(sourcePath.parent_path() / mesh.filePath).lexically_relative(exportDirectory).generic_string();
+		}
+
+		if (!SaveSceneDescriptionBinary(settings.exportScenePath, description))
+		{
+			std::cout << "Could not write " << settings.exportScenePath << std::endl;
+			return 1;
+		}
+
+		std::cout << "Exported " << sourcePath.string() << " to " << settings.exportScenePath << std::endl;
+		return 0;
+	}
+}
+
+int main(int argc, char* args[])
+{
+	HeadlessSettings settings{};
+	if (!ParseSettings(argc, args, settings))
+		return 1;
+
+	if (settings.showUsage)
+	{
+		std::cout << Usage << std::endl;
+		return 0;
+	}
+
+	if (!settings.meshCacheDirectory.empty())
+		SetMeshCacheDirectory(settings.meshCacheDirectory == "none" ? std::string{} : settings.meshCacheDirectory);
+
+	if (!settings.benchmarkPath.empty())
+		return RunBenchmark(settings);
+
+	if (settings.sceneName.empty())
+		settings.sceneName = "W4_Bunny";
+	if (!settings.exportScenePath.empty())
+		return ExportScene(settings);
+	settings.numFrames = std::max(settings.numFrames, 1);
+
+	const std::unique_ptr<Scene> pScene{ CreateScene(settings.sceneName) };
+	if (!pScene)
+	{
+		std::cout << "Could not load scene " << settings.sceneName << ", available:";
+		for (const std::string& sceneName : GetSceneNames())
+			std::cout << ' ' << sceneName;
+		std::cout << std::endl;
+		return 1;
+	}
+
+	pScene->Initialize();
+	if (!settings.isLoadingProgressive)
+		pScene->WaitUntilLoaded();
+
+	CameraPath cameraPath{};
+	if (settings.cameraPath == "sweep")
+		cameraPath = CameraPath::CreateSweep(pScene->GetCamera());
+	else if (settings.cameraPath != "static" && !cameraPath.LoadFromFile(settings.cameraPath))
+	{
+		std::cout << "Could not load camera path " << settings.cameraPath << std::endl;
+		return 1;
+	}
+
+	Renderer renderer{ settings.width, settings.height };
+	renderer.SetExecutionBackend(settings.backend);
+	if (!renderer.SetCostView(settings.costView))
+	{
+		std::cout << "Cost view " << Renderer::GetCostViewName(settings.costView) << " needs a build with RAY_STATS" << std::endl;
+		return 1;
+	}
+
+	//Fixed time step: every run renders exactly the same frames
+	Timer timer{};
+	timer.SetFixedTimeStep(settings.timeStep);
+	timer.SetFrameBudget(settings.frameBudget);
+	timer.Start();
+
+	std::cout << "Rendering " << settings.numFrames << " frame(s) of " << settings.sceneName << " at " << settings.width << "x" << settings.height
+		<< " (" << GetExecutionBackendName(renderer.GetExecutionBackend()) << ")" << std::endl;
+
+	FrameTrace::SetThreadName("main");
+	if (!settings.tracePath.empty() && settings.numTraceSkipFrames < settings.numFrames)
+	{
+		const int numTraceFrames{ settings.numTraceFrames > 0 ? settings.numTraceFrames : settings.numFrames - settings.numTraceSkipFrames };
+		FrameTrace::Capture(settings.tracePath, static_cast<uint32_t>(numTraceFrames), static_cast<uint32_t>(settings.numTraceSkipFrames));
+	}
+
+	double totalRenderSeconds{ 0.0 };
+	RayStatCounters totalRayStats{};
+	for (int frame{ 0 }; frame < settings.numFrames; ++frame)
+	{
+		{
+			TRACE_ZONE("Scene::Update");
+			pScene->Update(&timer);
+
+			if (!cameraPath.IsEmpty())
+				cameraPath.Apply(pScene->GetCamera(), settings.numFrames > 1 ? static_cast<float>(frame) / static_cast<float>(settings.numFrames - 1) : 0.f);
+		}
+
+		const auto renderStart = std::chrono::steady_clock::now();
+		{
+			TRACE_ZONE("Renderer::Render");
+			renderer.Render(pScene.get());
+		}
+		const double renderSeconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count() };
+		totalRenderSeconds += renderSeconds;
+		totalRayStats += renderer.GetLastFrameStats().rayStats;
+
+		timer.Update();
+
+		if (settings.outputPrefix != "none")
+		{
+			TRACE_ZONE("SaveFrame");
+			char filePath[512];
+			std::snprintf(filePath, sizeof(filePath), "%s_%04d.bmp", settings.outputPrefix.c_str(), frame);
+
+			if (renderer.SaveBufferToImage(filePath))
+				std::cout << "Could not write " << filePath << std::endl;
+
+			if (renderer.GetCostView() != Renderer::CostView::Off)
+			{
+				std::snprintf(filePath, sizeof(filePath), "%s_cost_%04d.pfm", settings.outputPrefix.c_str(), frame);
+				if (renderer.SaveCostsToFile(filePath))
+					std::cout << "Could not write " << filePath << std::endl;
+			}
+		}
+
+		std::cout << "Frame " << frame << ": " << renderSeconds * 1000.0 << " ms" << std::endl;
+
+		if (FrameTrace::EndFrame())
+			std::cout << "Trace written to " << settings.tracePath << std::endl;
+	}
+
+	//Throughput over the render calls only, writing the frames is not included
+	const double numPrimaryRays{ static_cast<double>(settings.width) * settings.height * settings.numFrames };
+	std::cout << "Frames: " << settings.numFrames << std::endl;
+	std::cout << "Render time: " << totalRenderSeconds << " s (" << totalRenderSeconds * 1000.0 / settings.numFrames << " ms/frame, "
+		<< settings.numFrames / totalRenderSeconds << " frames/s)" << std::endl;
+	std::cout << "Primary rays: " << numPrimaryRays / totalRenderSeconds / 1e6 << " Mrays/s" << std::endl;
+
+	//Wall clock between the timer updates, unlike the render time this includes writing the frames
+	const FrameTimeStats frameTimes = timer.GetFrameTimeStats();
+	std::cout << "Frame time: p50 " << frameTimes.p50 * 1000.f << " ms, p90 " << frameTimes.p90 * 1000.f << " ms, p99 " << frameTimes.p99 * 1000.f
+		<< " ms, max " << frameTimes.max * 1000.f << " ms, " << frameTimes.numOverBudget << " over the " << settings.frameBudget * 1000.f << " ms budget" << std::endl;
+
+	if constexpr (RayStats::IsEnabled)
+		RayStats::Print(std::cout, totalRayStats, static_cast<uint32_t>(settings.numFrames));
+
+	return 0;
+}
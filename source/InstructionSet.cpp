@@ -0,0 +1,68 @@
+#include "InstructionSet.h"
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace dae
+{
+	namespace
+	{
+		InstructionSet DetectInstructionSet()
+		{
+#if defined(SIMD_X86)
+#if defined(_MSC_VER)
+			int info[4]{};
+			__cpuid(info, 0);
+			const int maxLeaf{ info[0] };
+
+			__cpuid(info, 1);
+			const bool hasSSE2{ (info[3] & (1 << 26)) != 0 };
+			const bool hasOSXSAVE{ (info[2] & (1 << 27)) != 0 };
+			const bool hasAVX{ (info[2] & (1 << 28)) != 0 };
+
+			//The OS has to save the ymm registers too, not just the CPU support them
+			if (maxLeaf >= 7 && hasOSXSAVE && hasAVX && (_xgetbv(0) & 0x6) == 0x6)
+			{
+				__cpuidex(info, 7, 0);
+				if ((info[1] & (1 << 5)) != 0)
+					return InstructionSet::AVX2;
+			}
+
+			if (hasSSE2)
+				return InstructionSet::SSE2;
+#else
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))
+				return InstructionSet::AVX2;
+			if (__builtin_cpu_supports("sse2"))
+				return InstructionSet::SSE2;
+#endif
+#endif
+			return InstructionSet::Scalar;
+		}
+	}
+
+	InstructionSet GetInstructionSet()
+	{
+		static const InstructionSet instructionSet{ DetectInstructionSet() };
+		return instructionSet;
+	}
+
+	const char* GetInstructionSetName(InstructionSet instructionSet)
+	{
+		switch (instructionSet)
+		{
+		case InstructionSet::AVX2:
+			return "AVX2";
+
+		case InstructionSet::SSE2:
+			return "SSE2";
+
+		case InstructionSet::Scalar:
+			break;
+		}
+
+		return "Scalar";
+	}
+}
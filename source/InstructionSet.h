@@ -0,0 +1,33 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+//SSE2 is part of the compile target (always on x64), code using it needs no runtime dispatch
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#endif
+
+//MSVC accepts every intrinsic anywhere, GCC/Clang need the instruction set enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+namespace dae
+{
+	enum class InstructionSet
+	{
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	//Widest instruction set both the CPU and the OS support, detected once per process
+	InstructionSet GetInstructionSet();
+	const char* GetInstructionSetName(InstructionSet instructionSet);
+}
@@ -0,0 +1,132 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this == &other)
+			return *this;
+
+		Close();
+
+		m_pData = std::exchange(other.m_pData, nullptr);
+		m_Size = std::exchange(other.m_Size, 0);
+		m_IsOpen = std::exchange(other.m_IsOpen, false);
+#if defined(_WIN32)
+		m_FileHandle = std::exchange(other.m_FileHandle, nullptr);
+		m_MappingHandle = std::exchange(other.m_MappingHandle, nullptr);
+#endif
+
+		return *this;
+	}
+
+	bool MappedFile::Open(const std::string& filePath)
+	{
+		Close();
+
+#if defined(_WIN32)
+		const HANDLE file{ CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		m_FileHandle = file;
+		m_Size = static_cast<size_t>(size.QuadPart);
+		m_IsOpen = true;
+
+		//Mapping an empty file fails
+		if (m_Size == 0)
+			return true;
+
+		m_MappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_MappingHandle)
+			m_pData = static_cast<const char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+		const int file{ open(filePath.c_str(), O_RDONLY) };
+		if (file < 0)
+			return false;
+
+		struct stat status{};
+		if (fstat(file, &status) != 0)
+		{
+			close(file);
+			return false;
+		}
+
+		m_Size = static_cast<size_t>(status.st_size);
+		m_IsOpen = true;
+
+		if (m_Size > 0)
+		{
+			void* pData{ mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0) };
+			if (pData != MAP_FAILED)
+			{
+				madvise(pData, m_Size, MADV_SEQUENTIAL);
+				m_pData = static_cast<const char*>(pData);
+			}
+		}
+
+		//The mapping keeps its own reference to the file
+		close(file);
+#endif
+
+		if (m_Size > 0 && !m_pData)
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+#if defined(_WIN32)
+		if (m_pData)
+			UnmapViewOfFile(m_pData);
+		if (m_MappingHandle)
+			CloseHandle(m_MappingHandle);
+		if (m_FileHandle)
+			CloseHandle(m_FileHandle);
+
+		m_FileHandle = nullptr;
+		m_MappingHandle = nullptr;
+#else
+		if (m_pData)
+			munmap(const_cast<char*>(m_pData), m_Size);
+#endif
+
+		m_pData = nullptr;
+		m_Size = 0;
+		m_IsOpen = false;
+	}
+}
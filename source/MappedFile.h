@@ -0,0 +1,41 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	/**
+	 * \brief Read-only view of a whole file mapped into memory (MapViewOfFile / mmap), pages get loaded by the OS on first access.
+	 * An empty file opens fine with a null view.
+	 */
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		//Returns false when the file can not be opened or mapped, any previous mapping is closed first
+		bool Open(const std::string& filePath);
+		void Close();
+
+		bool IsOpen() const { return m_IsOpen; }
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const char* m_pData{ nullptr };
+		size_t m_Size{ 0 };
+		bool m_IsOpen{ false };
+
+#if defined(_WIN32)
+		void* m_FileHandle{ nullptr };
+		void* m_MappingHandle{ nullptr };
+#endif
+	};
+}
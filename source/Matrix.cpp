@@ -82,6 +82,43 @@ namespace dae {
 		return out;
 	}
 
+	//Inverse of the affine transform used by TransformPoint (3x3 axes + translation row), the last column is ignored
+	const Matrix& Matrix::Inverse()
+	{
+		const Vector3 xAxis{ data[0] };
+		const Vector3 yAxis{ data[1] };
+		const Vector3 zAxis{ data[2] };
+		const Vector3 t{ data[3] };
+
+		//Rows of the inverse 3x3 are the (transposed) cross products of the axes, divided by the determinant
+		const Vector3 yz{ Vector3::Cross(yAxis, zAxis) };
+		const Vector3 zx{ Vector3::Cross(zAxis, xAxis) };
+		const Vector3 xy{ Vector3::Cross(xAxis, yAxis) };
+
+		const float determinant{ Vector3::Dot(xAxis, yz) };
+		assert(determinant != 0.f && "Matrix is not invertible");
+		const float inverseDeterminant{ 1.f / determinant };
+
+		const Vector3 invX{ yz.x * inverseDeterminant, zx.x * inverseDeterminant, xy.x * inverseDeterminant };
+		const Vector3 invY{ yz.y * inverseDeterminant, zx.y * inverseDeterminant, xy.y * inverseDeterminant };
+		const Vector3 invZ{ yz.z * inverseDeterminant, zx.z * inverseDeterminant, xy.z * inverseDeterminant };
+
+		data[0] = { invX, 0 };
+		data[1] = { invY, 0 };
+		data[2] = { invZ, 0 };
+		data[3] = { -(invX * t.x + invY * t.y + invZ * t.z), 1 };
+
+		return *this;
+	}
+
+	Matrix Matrix::Inverse(const Matrix& m)
+	{
+		Matrix out{ m };
+		out.Inverse();
+
+		return out;
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
@@ -0,0 +1,512 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "DataTypes.h"
+#include "MappedFile.h"
+#include "ObjLoader.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Bump whenever the layout or the BVH builder change, older caches then get rebuilt
+		//2: the triangle blocks are no longer stored, they get rebuilt from the validated BVH and indices on load
+		constexpr uint32_t MeshCacheVersion{ 2 };
+		constexpr char MeshCacheMagic[8]{ 'D', 'A', 'E', 'M', 'E', 'S', 'H', '\0' };
+		//Sections start on a cache line
+		constexpr uint64_t SectionAlignment{ 64 };
+
+		enum class MeshCacheSection : uint32_t
+		{
+			Positions,
+			Normals,
+			Indices,
+			BVHNodes,
+			BVHPrimitiveIndices,
+
+			Count
+		};
+
+		struct SectionRange
+		{
+			uint64_t offset{}; //bytes from the start of the file
+			uint64_t size{}; //bytes
+		};
+
+		struct MeshCacheHeader
+		{
+			char magic[8]{};
+			uint32_t version{};
+			uint32_t padding{};
+			uint64_t sourceHash{};
+			uint64_t sourceSize{};
+			Vector3 minAABB{};
+			Vector3 maxAABB{};
+			SectionRange sections[static_cast<uint32_t>(MeshCacheSection::Count)]{};
+		};
+
+		static_assert(std::is_trivially_copyable_v<MeshCacheHeader> && std::is_trivially_copyable_v<BVHNode>);
+
+		std::string GetEnvironmentVariable(const char* name)
+		{
+#ifdef _MSC_VER
+			char* pValue{};
+			size_t length{};
+			if (_dupenv_s(&pValue, &length, name) != 0 || !pValue)
+				return {};
+
+			std::string value{ pValue };
+			free(pValue);
+			return value;
+#else
+			const char* pValue{ std::getenv(name) };
+			return pValue ? pValue : std::string{};
+#endif
+		}
+
+		std::filesystem::path GetDefaultCacheDirectory()
+		{
+			if (const std::string directory{ GetEnvironmentVariable("RAYTRACER_MESH_CACHE_DIR") }; !directory.empty())
+				return directory;
+
+#ifdef _WIN32
+			if (const std::string localAppData{ GetEnvironmentVariable("LOCALAPPDATA") }; !localAppData.empty())
+				return std::filesystem::path{ localAppData } / "RayTracer" / "MeshCache";
+#else
+			if (const std::string cacheHome{ GetEnvironmentVariable("XDG_CACHE_HOME") }; !cacheHome.empty())
+				return std::filesystem::path{ cacheHome } / "raytracer" / "meshcache";
+			if (const std::string home{ GetEnvironmentVariable("HOME") }; !home.empty())
+				return std::filesystem::path{ home } / ".cache" / "raytracer" / "meshcache";
+#endif
+
+			std::error_code error{};
+			const std::filesystem::path temporaryDirectory{ std::filesystem::temp_directory_path(error) };
+			return error ? std::filesystem::path{} : temporaryDirectory / "raytracer-meshcache";
+		}
+
+		struct CacheDirectory
+		{
+			std::mutex mutex{};
+			std::string path{ GetDefaultCacheDirectory().string() };
+		};
+
+		CacheDirectory& GetCacheDirectory()
+		{
+			static CacheDirectory cacheDirectory{};
+			return cacheDirectory;
+		}
+
+		//Named after the OBJ for readability and after its content so OBJs with the same name never share a file, empty when caching is off
+		std::string GetCachePath(const std::string& objPath, uint64_t sourceHash)
+		{
+			const std::string directory{ GetMeshCacheDirectory() };
+			if (directory.empty())
+				return {};
+
+			char hashText[17]{};
+			std::snprintf(hashText, sizeof(hashText), "%016llx", static_cast<unsigned long long>(sourceHash));
+			return (std::filesystem::path{ directory } / (std::filesystem::path{ objPath }.filename().string() + '.' + hashText + ".meshcache")).string();
+		}
+
+		template<typename T>
+		bool ReadSection(const MappedFile& file, const MeshCacheHeader& header, MeshCacheSection section, std::vector<T>& values)
+		{
+			const SectionRange& range = header.sections[static_cast<uint32_t>(section)];
+			if (range.offset > file.GetSize() || range.size > file.GetSize() - range.offset || range.size % sizeof(T) != 0)
+				return false;
+
+			values.resize(range.size / sizeof(T));
+			if (range.size > 0)
+				std::memcpy(values.data(), file.GetData() + range.offset, range.size);
+			return true;
+		}
+
+		//A damaged cache must not send the traversal out of bounds or past the end of its stack, the triangle blocks are built from what passes this check so their triangle indices are in range as well
+		bool IsConsistent(const TriangleMeshGeometry& geometry, const std::vector<BVHNode>& nodes, const std::vector<uint32_t>& primitiveIndices)
+		{
+			const size_t numTriangles{ geometry.indices.size() / 3 };
+			if (geometry.indices.size() % 3 != 0 || geometry.normals.size() != numTriangles || primitiveIndices.size() != numTriangles)
+				return false;
+
+			const int numPositions{ static_cast<int>(geometry.positions.size()) };
+			if (std::any_of(geometry.indices.begin(), geometry.indices.end(), [numPositions](int index) { return index < 0 || index >= numPositions; }))
+				return false;
+
+			if (std::any_of(primitiveIndices.begin(), primitiveIndices.end(), [numTriangles](uint32_t triangle) { return triangle >= numTriangles; }))
+				return false;
+
+			if (nodes.empty())
+				return true;
+
+			//Walked from the root the way the traversal does: a tree (every node reached exactly once) no deeper than the builder goes, the traversal stacks hold BVH::MaxDepth + 1 entries
+			struct NodeEntry
+			{
+				uint32_t nodeIndex;
+				uint32_t depth;
+			};
+
+			std::vector<bool> isReached(nodes.size(), false);
+			std::vector<NodeEntry> stack{ { 0, 0 } };
+			size_t numReached{ 0 };
+			while (!stack.empty())
+			{
+				const NodeEntry entry = stack.back();
+				stack.pop_back();
+
+				if (entry.depth >= BVH::MaxDepth || isReached[entry.nodeIndex])
+					return false;
+
+				isReached[entry.nodeIndex] = true;
+				++numReached;
+
+				const BVHNode& node = nodes[entry.nodeIndex];
+				if (node.IsLeaf())
+				{
+					if (uint64_t{ node.leftFirst } + node.primitiveCount > primitiveIndices.size())
+						return false;
+				}
+				else
+				{
+					if (node.leftFirst <= entry.nodeIndex || uint64_t{ node.leftFirst } + 1 >= nodes.size())
+						return false;
+
+					stack.push_back({ node.leftFirst, entry.depth + 1 });
+					stack.push_back({ node.leftFirst + 1, entry.depth + 1 });
+				}
+			}
+
+			return numReached == nodes.size();
+		}
+
+		bool ReadMeshCache(const std::string& cachePath, uint64_t sourceHash, uint64_t sourceSize, TriangleMeshGeometry& geometry)
+		{
+			MappedFile file{};
+			if (!file.Open(cachePath) || file.GetSize() < sizeof(MeshCacheHeader))
+				return false;
+
+			MeshCacheHeader header{};
+			std::memcpy(&header, file.GetData(), sizeof(header));
+			if (std::memcmp(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic)) != 0 || header.version != MeshCacheVersion
+				|| header.sourceHash != sourceHash || header.sourceSize != sourceSize)
+				return false;
+
+			std::vector<BVHNode> nodes{};
+			std::vector<uint32_t> primitiveIndices{};
+			if (!ReadSection(file, header, MeshCacheSection::Positions, geometry.positions)
+				|| !ReadSection(file, header, MeshCacheSection::Normals, geometry.normals)
+				|| !ReadSection(file, header, MeshCacheSection::Indices, geometry.indices)
+				|| !ReadSection(file, header, MeshCacheSection::BVHNodes, nodes)
+				|| !ReadSection(file, header, MeshCacheSection::BVHPrimitiveIndices, primitiveIndices)
+				|| !IsConsistent(geometry, nodes, primitiveIndices))
+			{
+				geometry = {};
+				return false;
+			}
+
+			geometry.minAABB = header.minAABB;
+			geometry.maxAABB = header.maxAABB;
+			geometry.bvh.Assign(std::move(nodes), std::move(primitiveIndices));
+			//One linear pass, far cheaper than the BVH build and never trusts serialized lane data
+			geometry.triangleBlocks.Build(geometry.bvh, geometry.positions, geometry.indices);
+			return true;
+		}
+
+		//Written next to the final path and renamed at the end (the cache directory gets created first), an interrupted write never leaves a truncated cache behind
+		bool WriteMeshCache(const std::string& cachePath, uint64_t sourceHash, uint64_t sourceSize, const TriangleMeshGeometry& geometry)
+		{
+			MeshCacheHeader header{};
+			std::memcpy(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+			header.version = MeshCacheVersion;
+			header.sourceHash = sourceHash;
+			header.sourceSize = sourceSize;
+			header.minAABB = geometry.minAABB;
+			header.maxAABB = geometry.maxAABB;
+
+			struct SectionData
+			{
+				const void* pData;
+				uint64_t size;
+			};
+
+			const auto getSectionData = [](const auto& values) { return SectionData{ values.data(), values.size() * sizeof(values[0]) }; };
+			const SectionData sections[]{
+				getSectionData(geometry.positions),
+				getSectionData(geometry.normals),
+				getSectionData(geometry.indices),
+				getSectionData(geometry.bvh.GetNodes()),
+				getSectionData(geometry.bvh.GetPrimitiveIndices()) };
+			static_assert(std::size(sections) == static_cast<size_t>(MeshCacheSection::Count));
+
+			uint64_t offset{ sizeof(MeshCacheHeader) };
+			for (size_t i{ 0 }; i < std::size(sections); ++i)
+			{
+				offset = (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+				header.sections[i] = { offset, sections[i].size };
+				offset += sections[i].size;
+			}
+
+			std::error_code error{};
+			std::filesystem::create_directories(std::filesystem::path{ cachePath }.parent_path(), error);
+
+			const std::string temporaryPath{ cachePath + ".tmp" };
+			{
+				std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+				if (!file)
+					return false;
+
+				file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				for (size_t i{ 0 }; i < std::size(sections); ++i)
+				{
+					//Zero padding up to the section start
+					const char padding[SectionAlignment]{};
+					file.write(padding, static_cast<std::streamsize>(header.sections[i].offset - static_cast<uint64_t>(file.tellp())));
+					file.write(static_cast<const char*>(sections[i].pData), static_cast<std::streamsize>(sections[i].size));
+				}
+
+				if (!file)
+					return false;
+			}
+
+			std::filesystem::rename(temporaryPath, cachePath, error);
+			if (error)
+				std::filesystem::remove(temporaryPath, error);
+			return !error;
+		}
+
+		bool LoadHashedMeshGeometry(const std::string& objPath, uint64_t sourceHash, uint64_t sourceSize, TriangleMeshGeometry& geometry)
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			const std::string cachePath{ GetCachePath(objPath, sourceHash) };
+			if (!cachePath.empty() && ReadMeshCache(cachePath, sourceHash, sourceSize, geometry))
+			{
+				std::cout << objPath << ": " << geometry.indices.size() / 3 << " triangles from " << cachePath << " in "
+					<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+				return true;
+			}
+
+			geometry = {};
+			if (!Utils::ParseOBJ(objPath, geometry.positions, geometry.normals, geometry.indices))
+				return false;
+
+			geometry.Build();
+
+			if (cachePath.empty())
+				return true;
+
+			if (WriteMeshCache(cachePath, sourceHash, sourceSize, geometry))
+				std::cout << "Wrote " << cachePath << std::endl;
+			else
+				std::cout << "Could not write " << cachePath << std::endl;
+
+			return true;
+		}
+
+		//Hash and size of the OBJ, the content address of its geometry
+		using ContentKey = std::pair<uint64_t, uint64_t>;
+
+		struct SharedGeometry
+		{
+			std::weak_ptr<const TriangleMeshGeometry> pGeometry{};
+			//Ready once the thread loading it stored pGeometry (or gave up), other requests for the same content wait on it
+			std::shared_future<void> isLoaded{};
+		};
+
+		struct SharedGeometryStore
+		{
+			std::mutex mutex{};
+			std::map<ContentKey, SharedGeometry> geometries{};
+			MeshGeometryCacheStats stats{};
+		};
+
+		SharedGeometryStore& GetSharedGeometryStore()
+		{
+			static SharedGeometryStore store{};
+			return store;
+		}
+
+		uint64_t GetMemorySize(const TriangleMeshGeometry& geometry)
+		{
+			const auto getSize = [](const auto& values) { return static_cast<uint64_t>(values.capacity() * sizeof(values[0])); };
+			return sizeof(TriangleMeshGeometry) + getSize(geometry.positions) + getSize(geometry.normals) + getSize(geometry.indices)
+				+ getSize(geometry.bvh.GetNodes()) + getSize(geometry.bvh.GetPrimitiveIndices())
+				+ getSize(geometry.triangleBlocks.GetBlocks()) + getSize(geometry.triangleBlocks.GetNodeFirstBlocks());
+		}
+	}
+
+	uint64_t HashContent(const void* pData, size_t size)
+	{
+		//Four independent lanes keep the multiplies pipelined (xxHash64 style), the remaining bytes and the size get mixed in at the end
+		constexpr uint64_t prime1{ 0x9E3779B185EBCA87ull };
+		constexpr uint64_t prime2{ 0xC2B2AE3D27D4EB4Full };
+		constexpr uint64_t prime3{ 0x165667B19E3779F9ull };
+
+		const auto* pBytes = static_cast<const unsigned char*>(pData);
+		uint64_t lanes[4]{ prime1 + prime2, prime2, 0, 0 - prime1 };
+
+		size_t i{ 0 };
+		for (; i + 32 <= size; i += 32)
+		{
+			for (uint32_t lane{ 0 }; lane < 4; ++lane)
+			{
+				uint64_t word{};
+				std::memcpy(&word, pBytes + i + lane * 8, sizeof(word));
+				lanes[lane] = std::rotl(lanes[lane] + word * prime2, 31) * prime1;
+			}
+		}
+
+		uint64_t hash{ std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18) };
+		hash += static_cast<uint64_t>(size) * prime3;
+
+		for (; i < size; ++i)
+			hash = std::rotl(hash ^ (pBytes[i] * prime3), 11) * prime1;
+
+		hash ^= hash >> 33;
+		hash *= prime2;
+		hash ^= hash >> 29;
+		hash *= prime3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	void SetMeshCacheDirectory(const std::string& directory)
+	{
+		CacheDirectory& cacheDirectory = GetCacheDirectory();
+		const std::lock_guard lock{ cacheDirectory.mutex };
+		cacheDirectory.path = directory;
+	}
+
+	std::string GetMeshCacheDirectory()
+	{
+		CacheDirectory& cacheDirectory = GetCacheDirectory();
+		const std::lock_guard lock{ cacheDirectory.mutex };
+		return cacheDirectory.path;
+	}
+
+	bool LoadMeshGeometry(const std::string& objPath, TriangleMeshGeometry& geometry)
+	{
+		uint64_t sourceHash{};
+		uint64_t sourceSize{};
+		{
+			MappedFile source{};
+			if (!source.Open(objPath))
+			{
+				std::cout << "Could not load " << objPath << std::endl;
+				return false;
+			}
+
+			sourceHash = HashContent(source.GetData(), source.GetSize());
+			sourceSize = source.GetSize();
+		}
+
+		return LoadHashedMeshGeometry(objPath, sourceHash, sourceSize, geometry);
+	}
+
+	std::shared_ptr<const TriangleMeshGeometry> AcquireMeshGeometry(const std::string& objPath)
+	{
+		ContentKey key{};
+		{
+			MappedFile source{};
+			if (!source.Open(objPath))
+			{
+				std::cout << "Could not load " << objPath << std::endl;
+				return nullptr;
+			}
+
+			key = { HashContent(source.GetData(), source.GetSize()), source.GetSize() };
+		}
+
+		SharedGeometryStore& store = GetSharedGeometryStore();
+		std::unique_lock lock{ store.mutex };
+		while (true)
+		{
+			SharedGeometry& shared = store.geometries[key];
+			if (std::shared_ptr<const TriangleMeshGeometry> pGeometry = shared.pGeometry.lock())
+			{
+				++store.stats.numHits;
+				return pGeometry;
+			}
+
+			//Another thread is loading the same content, look again once it is done (it may also have failed or been freed already)
+			if (shared.isLoaded.valid() && shared.isLoaded.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready)
+			{
+				const std::shared_future<void> isLoaded{ shared.isLoaded };
+				lock.unlock();
+				isLoaded.wait();
+				lock.lock();
+				continue;
+			}
+
+			break;
+		}
+
+		//Every miss drops the entries of freed (or failed) geometries, loading and unloading assets over a long session does not grow the map
+		std::erase_if(store.geometries, [](const auto& entry)
+			{
+				const SharedGeometry& shared = entry.second;
+				const bool isLoading{ shared.isLoaded.valid() && shared.isLoaded.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready };
+				return !isLoading && shared.pGeometry.expired();
+			});
+
+		std::promise<void> isLoaded{};
+		store.geometries[key] = { {}, isLoaded.get_future().share() };
+		lock.unlock();
+
+		auto pGeometry = std::make_unique<TriangleMeshGeometry>();
+		const bool isValid{ LoadHashedMeshGeometry(objPath, key.first, key.second, *pGeometry) };
+
+		std::shared_ptr<const TriangleMeshGeometry> pShared{};
+		if (isValid)
+		{
+			//The deleter takes the geometry off the books, the store itself never keeps it alive
+			const uint64_t numBytes{ GetMemorySize(*pGeometry) };
+			pShared = std::shared_ptr<const TriangleMeshGeometry>(pGeometry.release(), [numBytes](const TriangleMeshGeometry* pFreed)
+				{
+					SharedGeometryStore& freedStore = GetSharedGeometryStore();
+					{
+						const std::lock_guard freedLock{ freedStore.mutex };
+						--freedStore.stats.numGeometries;
+						freedStore.stats.numBytes -= numBytes;
+					}
+					delete pFreed;
+				});
+		}
+
+		lock.lock();
+		if (pShared)
+		{
+			++store.stats.numGeometries;
+			store.stats.numBytes += GetMemorySize(*pShared);
+		}
+		++store.stats.numLoads;
+		store.geometries[key].pGeometry = pShared;
+		lock.unlock();
+
+		isLoaded.set_value();
+		return pShared;
+	}
+
+	MeshGeometryCacheStats GetMeshGeometryCacheStats()
+	{
+		SharedGeometryStore& store = GetSharedGeometryStore();
+		const std::lock_guard lock{ store.mutex };
+		MeshGeometryCacheStats stats{ store.stats };
+		stats.numEntries = static_cast<uint32_t>(store.geometries.size());
+		return stats;
+	}
+}
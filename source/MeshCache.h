@@ -0,0 +1,48 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace dae
+{
+	struct TriangleMeshGeometry;
+
+	//64 bit content hash (not cryptographic), identical bytes always give the same value on every platform
+	uint64_t HashContent(const void* pData, size_t size);
+
+	/**
+	 * \brief Directory of the binary mesh caches (<obj file name>.<content hash>.meshcache), created on the first write. Empty turns the cache off.
+	 * Default: RAYTRACER_MESH_CACHE_DIR, else the user cache directory (%LOCALAPPDATA%/RayTracer/MeshCache, $XDG_CACHE_HOME/raytracer/meshcache or ~/.cache/raytracer/meshcache).
+	 * Set it before the first mesh gets loaded, the asset directories are never written to
+	 */
+	void SetMeshCacheDirectory(const std::string& directory);
+	std::string GetMeshCacheDirectory();
+
+	/**
+	 * \brief Built geometry of an OBJ file through a binary cache in the mesh cache directory: positions, indices, normals, bounds and BVH.
+	 * The cache is keyed on a content hash of the OBJ and a format version, on a miss the OBJ gets parsed and built (Utils::ParseOBJ, Build) and the cache (re)written.
+	 * A hit memory maps the cache, copies and validates every section and only rebuilds the triangle blocks from the BVH, nothing gets parsed and no BVH gets built.
+	 * Returns false when the OBJ can not be loaded, a cache that can not be written only costs the next startup.
+	 */
+	bool LoadMeshGeometry(const std::string& objPath, TriangleMeshGeometry& geometry);
+
+	struct MeshGeometryCacheStats
+	{
+		uint32_t numGeometries{}; //alive right now, one per unique OBJ content
+		uint64_t numBytes{}; //of those geometries, every one counted once however many meshes use it
+		uint64_t numHits{}; //requests served by a geometry that was already loaded (or being loaded)
+		uint64_t numLoads{};
+		uint32_t numEntries{}; //content addresses the store tracks, freed geometries get dropped on the next load
+	};
+
+	/**
+	 * \brief Process wide, content addressed store of OBJ geometry: requests for a file with the same content (same path or a copy elsewhere) share one immutable geometry.
+	 * The file is hashed on every request, a changed file gets loaded again, LoadMeshGeometry does the loading.
+	 * The store only keeps weak references, a geometry is freed once the last mesh using it is gone. Thread safe, concurrent requests for the same content load it once.
+	 * Returns nullptr when the OBJ can not be loaded.
+	 */
+	std::shared_ptr<const TriangleMeshGeometry> AcquireMeshGeometry(const std::string& objPath);
+	MeshGeometryCacheStats GetMeshGeometryCacheStats();
+}
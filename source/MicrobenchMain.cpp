@@ -0,0 +1,599 @@
+//Microbenchmarks for the GeometryUtils intersection kernels, the triangle/sphere block kernels (per instruction set the CPU supports) and the BRDFs,
+//every kernel runs in isolation over seeded random inputs
+//Command line: see Usage below (RayTracerMicrobench --help)
+
+//Standard includes
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+//Project includes
+#include "BRDFs.h"
+#include "CommandLine.h"
+#include "InstructionSet.h"
+#include "SphereBlock.h"
+#include "TriangleBlock.h"
+#include "Utils.h"
+
+using namespace dae;
+
+namespace
+{
+	constexpr const char* Usage{ R"(Usage: RayTracerMicrobench [--kernel <name filter>] [--seed 1234] [--samples 4096] [--repetitions 200] [--runs 5]
+Hit-heavy rays aim at a random point on the primitive, miss-heavy rays go in a random direction (or away from the plane)
+Block kernels test every ray against the block holding its own primitive, ns/test is per primitive (block time / block width) so it compares to the single primitive kernels)" };
+
+	struct MicrobenchSettings
+	{
+		std::string kernelFilter{}; //only kernels whose name contains it, empty runs all of them
+		uint32_t seed{ 1234 };
+		int numSamples{ 4096 }; //small enough to stay in cache, the kernel is measured and not the memory
+		int numRepetitions{ 200 }; //passes over the samples per run
+		int numRuns{ 5 }; //the fastest run is reported
+		bool showUsage{ false };
+	};
+
+	enum class RayDistribution
+	{
+		HitHeavy,
+		MissHeavy
+	};
+
+	const char* GetDistributionName(RayDistribution distribution)
+	{
+		return distribution == RayDistribution::HitHeavy ? "hit-heavy" : "miss-heavy";
+	}
+
+	//Every kernel gets the same random source, so the inputs only depend on the seed
+	class SampleGenerator final
+	{
+	public:
+		explicit SampleGenerator(uint32_t seed) : m_Engine{ seed } {}
+
+		float GetFloat(float min, float max) { return std::uniform_real_distribution<float>{ min, max }(m_Engine); }
+		Vector3 GetPoint(float extent) { return { GetFloat(-extent, extent), GetFloat(-extent, extent), GetFloat(-extent, extent) }; }
+
+		Vector3 GetDirection()
+		{
+			//Rejection sampling in the unit ball keeps the directions uniform
+			while (true)
+			{
+				const Vector3 point{ GetPoint(1.f) };
+				if (const float sqrMagnitude{ point.SqrMagnitude() }; sqrMagnitude > 0.0001f && sqrMagnitude <= 1.f)
+					return point / sqrtf(sqrMagnitude);
+			}
+		}
+
+		//Origin on a shell around center, aimed at target (hit-heavy) or anywhere (miss-heavy)
+		Ray GetRay(const Vector3& center, float distance, const Vector3& target, RayDistribution distribution)
+		{
+			const Vector3 origin{ center + GetDirection() * distance };
+			const Vector3 direction{ distribution == RayDistribution::HitHeavy ? (target - origin).Normalized() : GetDirection() };
+			return { origin, direction };
+		}
+
+	private:
+		std::mt19937 m_Engine;
+	};
+
+	//Hit count of a full pass, also keeps the compiler from dropping the kernel calls
+	using KernelPass = std::function<uint32_t()>;
+
+	struct KernelResult
+	{
+		double nanosecondsPerTest{};
+		double hitRate{};
+	};
+
+	KernelResult MeasureKernel(const KernelPass& pass, const MicrobenchSettings& settings, uint32_t numTestsPerSample)
+	{
+		//One untimed pass pulls the samples into the cache
+		const uint32_t numHits{ pass() };
+
+		double bestTime{ DBL_MAX };
+		for (int run{ 0 }; run < settings.numRuns; ++run)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			for (int repetition{ 0 }; repetition < settings.numRepetitions; ++repetition)
+				pass();
+			bestTime = std::min(bestTime, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		const double numTests{ static_cast<double>(settings.numSamples) * settings.numRepetitions * numTestsPerSample };
+		return { bestTime * 1e9 / numTests, static_cast<double>(numHits) / settings.numSamples };
+	}
+
+	struct Kernel
+	{
+		std::string name{};
+		//Builds the samples for the distribution and returns the pass that tests all of them
+		std::function<KernelPass(SampleGenerator&, RayDistribution, bool populateHitRecord)> createPass{};
+		bool hasDistributions{ true }; //false for kernels that do not trace rays (BRDFs)
+		bool hasHitRecord{ true };
+		uint32_t numTestsPerSample{ 1 }; //primitives one kernel call tests
+	};
+
+	//Sums a value of every result into a sink, a kernel whose output is never read would get optimized away
+	volatile float g_Sink{};
+
+#pragma region Kernels
+	//Random sphere, rays aim at a random point inside it
+	void CreateSphereSample(SampleGenerator& generator, RayDistribution distribution, Sphere& sphere, Ray& ray)
+	{
+		sphere.origin = generator.GetPoint(50.f);
+		sphere.radius = generator.GetFloat(0.5f, 2.f);
+
+		const Vector3 target{ sphere.origin + generator.GetDirection() * sphere.radius * generator.GetFloat(0.f, 0.9f) };
+		ray = generator.GetRay(sphere.origin, 20.f, target, distribution);
+	}
+
+	KernelPass CreateSpherePass(SampleGenerator& generator, RayDistribution distribution, bool populateHitRecord, int numSamples)
+	{
+		auto spheres = std::make_shared<std::vector<Sphere>>(numSamples);
+		auto rays = std::make_shared<std::vector<Ray>>(numSamples);
+
+		for (int i{ 0 }; i < numSamples; ++i)
+			CreateSphereSample(generator, distribution, (*spheres)[i], (*rays)[i]);
+
+		return [=]
+			{
+				uint32_t numHits{ 0 };
+				HitRecord hitRecord{};
+				for (size_t i{ 0 }; i < spheres->size(); ++i)
+				{
+					if (populateHitRecord ? GeometryUtils::HitTest_Sphere((*spheres)[i], (*rays)[i], hitRecord) : GeometryUtils::HitTest_Sphere((*spheres)[i], (*rays)[i]))
+						++numHits;
+				}
+				g_Sink = g_Sink + hitRecord.t;
+				return numHits;
+			};
+	}
+
+	KernelPass CreatePlanePass(SampleGenerator& generator, RayDistribution distribution, bool populateHitRecord, int numSamples)
+	{
+		auto planes = std::make_shared<std::vector<Plane>>(numSamples);
+		auto rays = std::make_shared<std::vector<Ray>>(numSamples);
+
+		for (int i{ 0 }; i < numSamples; ++i)
+		{
+			Plane& plane{ (*planes)[i] };
+			plane.origin = generator.GetPoint(50.f);
+			plane.normal = generator.GetDirection();
+
+			//Origin in front of the plane, the direction decides: towards (hit) or away from it (miss)
+			Ray& ray{ (*rays)[i] };
+			ray.origin = plane.origin + plane.normal * generator.GetFloat(1.f, 20.f) + generator.GetPoint(10.f);
+			ray.direction = generator.GetDirection();
+
+			const bool facesPlane{ Vector3::Dot(ray.direction, plane.normal) < 0.f };
+			if (facesPlane != (distribution == RayDistribution::HitHeavy))
+				ray.direction = -ray.direction;
+		}
+
+		return [=]
+			{
+				uint32_t numHits{ 0 };
+				HitRecord hitRecord{};
+				for (size_t i{ 0 }; i < planes->size(); ++i)
+				{
+					if (populateHitRecord ? GeometryUtils::HitTest_Plane((*planes)[i], (*rays)[i], hitRecord) : GeometryUtils::HitTest_Plane((*planes)[i], (*rays)[i]))
+						++numHits;
+				}
+				g_Sink = g_Sink + hitRecord.t;
+				return numHits;
+			};
+	}
+
+	//Random triangle around a random center, rays aim at a random point inside it
+	void CreateTriangleSample(SampleGenerator& generator, RayDistribution distribution, Vector3 (&vertices)[3], Ray& ray)
+	{
+		const Vector3 center{ generator.GetPoint(50.f) };
+		for (Vector3& vertex : vertices)
+			vertex = center + generator.GetPoint(2.f);
+
+		float u{ generator.GetFloat(0.f, 1.f) };
+		float v{ generator.GetFloat(0.f, 1.f) };
+		if (u + v > 1.f)
+		{
+			u = 1.f - u;
+			v = 1.f - v;
+		}
+
+		const Vector3 target{ vertices[0] + (vertices[1] - vertices[0]) * u + (vertices[2] - vertices[0]) * v };
+		ray = generator.GetRay(center, 20.f, target, distribution);
+	}
+
+	//Both kernels get no culling, otherwise half of the hit-heavy rays would miss
+	KernelPass CreateTrianglePass(SampleGenerator& generator, RayDistribution distribution, bool populateHitRecord, int numSamples)
+	{
+		auto triangles = std::make_shared<std::vector<Triangle>>(numSamples);
+		auto rays = std::make_shared<std::vector<Ray>>(numSamples);
+
+		for (int i{ 0 }; i < numSamples; ++i)
+		{
+			Vector3 vertices[3]{};
+			CreateTriangleSample(generator, distribution, vertices, (*rays)[i]);
+
+			Triangle& triangle{ (*triangles)[i] };
+			triangle = { vertices[0], vertices[1], vertices[2] };
+			triangle.cullMode = TriangleCullMode::NoCulling;
+		}
+
+		return [=]
+			{
+				uint32_t numHits{ 0 };
+				HitRecord hitRecord{};
+				for (size_t i{ 0 }; i < triangles->size(); ++i)
+				{
+					if (populateHitRecord ? GeometryUtils::HitTest_Triangle((*triangles)[i], (*rays)[i], hitRecord) : GeometryUtils::HitTest_Triangle((*triangles)[i], (*rays)[i]))
+						++numHits;
+				}
+				g_Sink = g_Sink + hitRecord.t;
+				return numHits;
+			};
+	}
+
+	//Same samples as HitTest_Triangle for the same seed, so both kernels can be compared directly
+	KernelPass CreateTriangleRecordPass(SampleGenerator& generator, RayDistribution distribution, bool, int numSamples)
+	{
+		auto triangles = std::make_shared<std::vector<TriangleRecord>>(numSamples);
+		auto rays = std::make_shared<std::vector<Ray>>(numSamples);
+
+		for (int i{ 0 }; i < numSamples; ++i)
+		{
+			Vector3 vertices[3]{};
+			CreateTriangleSample(generator, distribution, vertices, (*rays)[i]);
+			(*triangles)[i] = { vertices[0], vertices[1], vertices[2] };
+		}
+
+		return [=]
+			{
+				uint32_t numHits{ 0 };
+				float t{};
+				for (size_t i{ 0 }; i < triangles->size(); ++i)
+				{
+					if (GeometryUtils::HitTest_TriangleRecord<TriangleCullMode::NoCulling>((*triangles)[i], (*rays)[i], t))
+						++numHits;
+				}
+				g_Sink = g_Sink + t;
+				return numHits;
+			};
+	}
+
+	//Same samples as HitTest_Triangle for the same seed, packed TriangleBlock::Width to a block in sample order. Unused lanes stay degenerate
+	KernelPass CreateTriangleBlockPass(SampleGenerator& generator, RayDistribution distribution, int numSamples, TriangleBlockKernel kernel)
+	{
+		auto blocks = std::make_shared<std::vector<TriangleBlock>>(TriangleBlock::GetBlockCount(static_cast<uint32_t>(numSamples)));
+		auto rays = std::make_shared<std::vector<Ray>>(numSamples);
+
+		for (int i{ 0 }; i < numSamples; ++i)
+		{
+			Vector3 vertices[3]{};
+			CreateTriangleSample(generator, distribution, vertices, (*rays)[i]);
+
+			TriangleBlock& block{ (*blocks)[i / TriangleBlock::Width] };
+			const uint32_t lane{ static_cast<uint32_t>(i) % TriangleBlock::Width };
+			const Vector3 edge1{ vertices[1] - vertices[0] };
+			const Vector3 edge2{ vertices[2] - vertices[0] };
+
+			block.v0x[lane] = vertices[0].x;
+			block.v0y[lane] = vertices[0].y;
+			block.v0z[lane] = vertices[0].z;
+			block.edge1x[lane] = edge1.x;
+			block.edge1y[lane] = edge1.y;
+			block.edge1z[lane] = edge1.z;
+			block.edge2x[lane] = edge2.x;
+			block.edge2y[lane] = edge2.y;
+			block.edge2z[lane] = edge2.z;
+			block.triangleIndex[lane] = static_cast<uint32_t>(i);
+		}
+
+		return [=]
+			{
+				uint32_t numHits{ 0 };
+				float t{};
+				for (size_t i{ 0 }; i < rays->size(); ++i)
+				{
+					const Ray& ray{ (*rays)[i] };
+					float tMax{ ray.max };
+					uint32_t triangleIndex{};
+					if (kernel(blocks->data() + i / TriangleBlock::Width, 1, ray.origin, ray.direction, ray.min, tMax, triangleIndex))
+					{
+						++numHits;
+						t = tMax;
+					}
+				}
+				g_Sink = g_Sink + t;
+				return numHits;
+			};
+	}
+
+	//Same samples as HitTest_Sphere for the same seed, packed SphereBlock::Width to a block in sample order. Unused lanes can never be hit
+	KernelPass CreateSphereBlockPass(SampleGenerator& generator, RayDistribution distribution, int numSamples, SphereBlockKernel kernel)
+	{
+		auto blocks = std::make_shared<std::vector<SphereBlock>>(SphereBlock::GetBlockCount(static_cast<uint32_t>(numSamples)));
+		auto rays = std::make_shared<std::vector<Ray>>(numSamples);
+
+		for (SphereBlock& block : *blocks)
+		{
+			std::fill(std::begin(block.radiusSquared), std::end(block.radiusSquared), -FLT_MAX);
+			std::fill(std::begin(block.sphereIndex), std::end(block.sphereIndex), 0u);
+		}
+
+		for (int i{ 0 }; i < numSamples; ++i)
+		{
+			Sphere sphere{};
+			CreateSphereSample(generator, distribution, sphere, (*rays)[i]);
+
+			SphereBlock& block{ (*blocks)[i / SphereBlock::Width] };
+			const uint32_t lane{ static_cast<uint32_t>(i) % SphereBlock::Width };
+			block.originX[lane] = sphere.origin.x;
+			block.originY[lane] = sphere.origin.y;
+			block.originZ[lane] = sphere.origin.z;
+			block.radiusSquared[lane] = sphere.radius * sphere.radius;
+			block.sphereIndex[lane] = static_cast<uint32_t>(i);
+		}
+
+		return [=]
+			{
+				uint32_t numHits{ 0 };
+				float t{};
+				for (size_t i{ 0 }; i < rays->size(); ++i)
+				{
+					const Ray& ray{ (*rays)[i] };
+					float tMax{ ray.max };
+					uint32_t sphereIndex{};
+					if (kernel(blocks->data() + i / SphereBlock::Width, 1, ray.origin, ray.direction, ray.min, tMax, sphereIndex))
+					{
+						++numHits;
+						t = tMax;
+					}
+				}
+				g_Sink = g_Sink + t;
+				return numHits;
+			};
+	}
+
+	KernelPass CreateSlabPass(SampleGenerator& generator, RayDistribution distribution, bool, int numSamples)
+	{
+		auto meshes = std::make_shared<std::vector<TriangleMesh>>(numSamples);
+		auto rays = std::make_shared<std::vector<Ray>>(numSamples);
+
+		for (int i{ 0 }; i < numSamples; ++i)
+		{
+			//Only the world space box is read by the slab test, the mesh can stay empty
+			TriangleMesh& mesh{ (*meshes)[i] };
+			const Vector3 center{ generator.GetPoint(50.f) };
+			const Vector3 halfExtent{ generator.GetFloat(0.5f, 3.f), generator.GetFloat(0.5f, 3.f), generator.GetFloat(0.5f, 3.f) };
+			mesh.transformedMinAABB = center - halfExtent;
+			mesh.transformedMaxAABB = center + halfExtent;
+
+			const Vector3 target{ center + Vector3{ halfExtent.x * generator.GetFloat(-1.f, 1.f), halfExtent.y * generator.GetFloat(-1.f, 1.f), halfExtent.z * generator.GetFloat(-1.f, 1.f) } };
+			(*rays)[i] = generator.GetRay(center, 20.f, target, distribution);
+		}
+
+		return [=]
+			{
+				uint32_t numHits{ 0 };
+				for (size_t i{ 0 }; i < meshes->size(); ++i)
+				{
+					if (GeometryUtils::SlabTest_TriangleMesh((*meshes)[i], (*rays)[i]))
+						++numHits;
+				}
+				return numHits;
+			};
+	}
+
+	//Normal, view and light directions on the same hemisphere, as the shading code feeds them
+	struct ShadingSample
+	{
+		Vector3 n{};
+		Vector3 v{};
+		Vector3 l{};
+		Vector3 h{};
+		float roughness{};
+	};
+
+	std::shared_ptr<std::vector<ShadingSample>> CreateShadingSamples(SampleGenerator& generator, int numSamples)
+	{
+		auto samples = std::make_shared<std::vector<ShadingSample>>(numSamples);
+		for (ShadingSample& sample : *samples)
+		{
+			sample.n = generator.GetDirection();
+			sample.v = generator.GetDirection();
+			sample.l = generator.GetDirection();
+			if (Vector3::Dot(sample.n, sample.v) < 0.f)
+				sample.v = -sample.v;
+			if (Vector3::Dot(sample.n, sample.l) < 0.f)
+				sample.l = -sample.l;
+
+			sample.h = (sample.v + sample.l).Normalized();
+			sample.roughness = generator.GetFloat(0.1f, 1.f);
+		}
+		return samples;
+	}
+
+	//Passes over the shading samples, numHits is just the number of calls
+	template<typename Brdf>
+	KernelPass CreateBrdfPass(SampleGenerator& generator, int numSamples, Brdf brdf)
+	{
+		auto samples = CreateShadingSamples(generator, numSamples);
+		return [=]
+			{
+				float sum{ 0.f };
+				for (const ShadingSample& sample : *samples)
+					sum += brdf(sample);
+				g_Sink = g_Sink + sum;
+				return static_cast<uint32_t>(samples->size());
+			};
+	}
+#pragma endregion
+
+	std::vector<Kernel> CreateKernels(int numSamples)
+	{
+		const auto bindRayKernel = [numSamples](KernelPass(*createPass)(SampleGenerator&, RayDistribution, bool, int))
+			{
+				return [=](SampleGenerator& generator, RayDistribution distribution, bool populateHitRecord)
+					{
+						return createPass(generator, distribution, populateHitRecord, numSamples);
+					};
+			};
+
+		const auto bindBrdf = [numSamples](auto brdf)
+			{
+				return [=](SampleGenerator& generator, RayDistribution, bool)
+					{
+						return CreateBrdfPass(generator, numSamples, brdf);
+					};
+			};
+
+		const ColorRGB f0{ 0.04f, 0.04f, 0.04f };
+		const ColorRGB diffuseColor{ 0.75f, 0.5f, 0.25f };
+
+		std::vector<Kernel> kernels{
+			{ "HitTest_Sphere", bindRayKernel(CreateSpherePass) },
+			{ "HitTest_Plane", bindRayKernel(CreatePlanePass) },
+			{ "HitTest_Triangle", bindRayKernel(CreateTrianglePass) },
+			{ "HitTest_TriangleRecord", bindRayKernel(CreateTriangleRecordPass), true, false },
+			{ "SlabTest_TriangleMesh", bindRayKernel(CreateSlabPass), true, false },
+			{ "BRDF::Lambert", bindBrdf([=](const ShadingSample& sample) { return BRDF::Lambert(sample.roughness, diffuseColor).r; }), false, false },
+			{ "BRDF::Phong", bindBrdf([](const ShadingSample& sample) { return BRDF::Phong(0.5f, 60.f, sample.l, sample.v, sample.n).r; }), false, false },
+			{ "BRDF::FresnelFunction_Schlick", bindBrdf([=](const ShadingSample& sample) { return BRDF::FresnelFunction_Schlick(sample.h, sample.v, f0).r; }), false, false },
+			{ "BRDF::NormalDistribution_GGX", bindBrdf([](const ShadingSample& sample) { return BRDF::NormalDistribution_GGX(sample.n, sample.h, sample.roughness); }), false, false },
+			{ "BRDF::GeometryFunction_Smith", bindBrdf([](const ShadingSample& sample) { return BRDF::GeometryFunction_Smith(sample.n, sample.v, sample.l, sample.roughness); }), false, false },
+		};
+
+		//Every instruction set up to the one the renderer picks, the block kernels without culling like HitTest_Triangle
+		for (const InstructionSet instructionSet : { InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2 })
+		{
+			if (instructionSet > GetInstructionSet())
+				break;
+
+			const std::string suffix{ std::string{ "/" } + GetInstructionSetName(instructionSet) };
+			for (const bool anyHit : { false, true })
+			{
+				const TriangleBlockKernel triangleKernel{ GetTriangleBlockKernel(TriangleCullMode::NoCulling, anyHit, instructionSet) };
+				kernels.push_back({ (anyHit ? "TriangleBlock_AnyHit" : "TriangleBlock_ClosestHit") + suffix,
+					[=](SampleGenerator& generator, RayDistribution distribution, bool) { return CreateTriangleBlockPass(generator, distribution, numSamples, triangleKernel); },
+					true, false, TriangleBlock::Width });
+
+				const SphereBlockKernel sphereKernel{ GetSphereBlockKernel(anyHit, instructionSet) };
+				kernels.push_back({ (anyHit ? "SphereBlock_AnyHit" : "SphereBlock_ClosestHit") + suffix,
+					[=](SampleGenerator& generator, RayDistribution distribution, bool) { return CreateSphereBlockPass(generator, distribution, numSamples, sphereKernel); },
+					true, false, SphereBlock::Width });
+			}
+		}
+
+		return kernels;
+	}
+
+	bool ParseSettings(int argc, char* args[], MicrobenchSettings& settings)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const std::string argument{ args[i] };
+			if (argument == "--help" || argument == "-h")
+			{
+				settings.showUsage = true;
+				return true;
+			}
+
+			if (i + 1 >= argc)
+			{
+				std::cout << "Missing value for " << argument << std::endl;
+				return false;
+			}
+
+			const std::string value{ args[++i] };
+
+			if (argument == "--kernel")
+				settings.kernelFilter = value;
+			else if (argument == "--seed")
+			{
+				if (!ParseArgumentValue(argument, value, settings.seed))
+					return false;
+			}
+			else if (argument == "--samples")
+			{
+				if (!ParseArgumentValue(argument, value, settings.numSamples))
+					return false;
+			}
+			else if (argument == "--repetitions")
+			{
+				if (!ParseArgumentValue(argument, value, settings.numRepetitions))
+					return false;
+			}
+			else if (argument == "--runs")
+			{
+				if (!ParseArgumentValue(argument, value, settings.numRuns))
+					return false;
+			}
+			else
+			{
+				std::cout << "Unknown argument " << argument << " (see --help)" << std::endl;
+				return false;
+			}
+		}
+
+		return CheckArgument(settings.numSamples > 0, "--samples needs to be at least 1")
+			&& CheckArgument(settings.numRepetitions > 0, "--repetitions needs to be at least 1")
+			&& CheckArgument(settings.numRuns > 0, "--runs needs to be at least 1");
+	}
+}
+
+int main(int argc, char* args[])
+{
+	MicrobenchSettings settings{};
+	if (!ParseSettings(argc, args, settings))
+		return 1;
+
+	if (settings.showUsage)
+	{
+		std::cout << Usage << std::endl;
+		return 0;
+	}
+
+	std::cout << "Instruction set: " << GetInstructionSetName(GetInstructionSet()) << ", seed " << settings.seed
+		<< ", " << settings.numSamples << " samples x " << settings.numRepetitions << " repetitions, best of " << settings.numRuns << " runs" << std::endl;
+	std::printf("%-32s %-12s %-12s %10s %10s\n", "kernel", "rays", "hit record", "ns/test", "hit rate");
+
+	for (const Kernel& kernel : CreateKernels(settings.numSamples))
+	{
+		if (kernel.name.find(settings.kernelFilter) == std::string::npos)
+			continue;
+
+		for (const RayDistribution distribution : { RayDistribution::HitHeavy, RayDistribution::MissHeavy })
+		{
+			if (!kernel.hasDistributions && distribution == RayDistribution::MissHeavy)
+				continue;
+
+			for (const bool populateHitRecord : { false, true })
+			{
+				if (!kernel.hasHitRecord && populateHitRecord)
+					continue;
+
+				//Reseeded per configuration, so a kernel always sees the same inputs no matter which others run
+				SampleGenerator generator{ settings.seed };
+				const KernelResult result{ MeasureKernel(kernel.createPass(generator, distribution, populateHitRecord), settings, kernel.numTestsPerSample) };
+
+				char hitRate[16]{ "-" };
+				if (kernel.hasDistributions)
+					std::snprintf(hitRate, sizeof(hitRate), "%.1f%%", result.hitRate * 100.0);
+
+				std::printf("%-32s %-12s %-12s %10.2f %10s\n", kernel.name.c_str(),
+					kernel.hasDistributions ? GetDistributionName(distribution) : "-",
+					kernel.hasHitRecord ? (populateHitRecord ? "yes" : "no") : "-",
+					result.nanosecondsPerTest, hitRate);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,388 @@
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#include "MappedFile.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Files below this size (per thread) are not worth splitting further
+		constexpr size_t MinChunkSize{ 1 << 20 };
+
+		//Helper threads every load running at the same time draws from (the calling threads come on top), streamed meshes share the cores instead of each starting one thread per core
+		std::atomic<int> g_NumFreeHelperThreads{ static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)) - 1 };
+
+		//Position, texture coordinate, normal: the order of the indices of a face corner
+		constexpr int NumAttributes{ 3 };
+		using Corner = std::array<int, NumAttributes>;
+
+		struct Chunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+
+			std::vector<Vector3> elements[NumAttributes]{};
+			//Zero based, -1 when left out. Negative indices in the file are stored relative to the first element of this chunk
+			std::vector<int> indices[NumAttributes]{};
+			//Entries of indices that still need the element offset of this chunk
+			std::vector<size_t> relativeIndices[NumAttributes]{};
+
+			std::vector<Corner> faceCorners{};
+			bool isValid{ true };
+		};
+
+		bool IsSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		const char* SkipSpaces(const char* p, const char* pEnd)
+		{
+			while (p != pEnd && IsSpace(*p))
+				++p;
+			return p;
+		}
+
+		bool ParseFloat(const char*& p, const char* pEnd, float& value)
+		{
+			p = SkipSpaces(p, pEnd);
+			//from_chars does not accept an explicit plus sign
+			if (p != pEnd && *p == '+')
+				++p;
+
+			const auto [pNext, error] = std::from_chars(p, pEnd, value);
+			if (error != std::errc{})
+				return false;
+
+			p = pNext;
+			return true;
+		}
+
+		//v, v/vt, v//vn or v/vt/vn, the parts that are left out stay 0
+		bool ParseCorner(const char*& p, const char* pEnd, Corner& corner)
+		{
+			for (int attribute{ 0 }; attribute < NumAttributes; ++attribute)
+			{
+				if (attribute > 0)
+				{
+					if (p == pEnd || *p != '/')
+						break;
+					++p;
+				}
+
+				if (p == pEnd || *p == '/' || IsSpace(*p))
+				{
+					//Only the position is required
+					if (attribute == 0)
+						return false;
+					continue;
+				}
+
+				const auto [pNext, error] = std::from_chars(p, pEnd, corner[attribute]);
+				if (error != std::errc{} || corner[attribute] == 0)
+					return false;
+				p = pNext;
+			}
+
+			return p == pEnd || IsSpace(*p);
+		}
+
+		void AddCorner(Chunk& chunk, const Corner& corner)
+		{
+			for (int attribute{ 0 }; attribute < NumAttributes; ++attribute)
+			{
+				std::vector<int>& indices = chunk.indices[attribute];
+				const int index{ corner[attribute] };
+
+				if (index > 0)
+					indices.push_back(index - 1);
+				else if (index < 0)
+				{
+					//-1 is the last element written so far
+					chunk.relativeIndices[attribute].push_back(indices.size());
+					indices.push_back(static_cast<int>(chunk.elements[attribute].size()) + index);
+				}
+				else
+					indices.push_back(-1);
+			}
+		}
+
+		bool ParseLine(const char* p, const char* pEnd, Chunk& chunk)
+		{
+			//Comments may also follow a statement
+			if (const void* pComment{ std::memchr(p, '#', pEnd - p) })
+				pEnd = static_cast<const char*>(pComment);
+
+			p = SkipSpaces(p, pEnd);
+			if (pEnd - p < 2)
+				return true;
+
+			if (p[0] == 'v')
+			{
+				int attribute{ 0 };
+				if (p[1] == 't')
+					attribute = 1;
+				else if (p[1] == 'n')
+					attribute = 2;
+
+				p += attribute == 0 ? 1 : 2;
+				//vp and other statements starting with v
+				if (p != pEnd && !IsSpace(*p))
+					return true;
+
+				//Texture coordinates only need u
+				const int numRequired{ attribute == 1 ? 1 : 3 };
+				Vector3 element{};
+				float* components[]{ &element.x, &element.y, &element.z };
+				for (int i{ 0 }; i < 3; ++i)
+				{
+					if (!ParseFloat(p, pEnd, *components[i]))
+					{
+						if (i < numRequired)
+							return false;
+						break;
+					}
+				}
+
+				chunk.elements[attribute].push_back(element);
+			}
+			else if (p[0] == 'f' && IsSpace(p[1]))
+			{
+				p += 1;
+				chunk.faceCorners.clear();
+				for (p = SkipSpaces(p, pEnd); p != pEnd; p = SkipSpaces(p, pEnd))
+				{
+					Corner corner{};
+					if (!ParseCorner(p, pEnd, corner))
+						return false;
+					chunk.faceCorners.push_back(corner);
+				}
+
+				if (chunk.faceCorners.size() < 3)
+					return false;
+
+				//Fan around the first corner
+				for (size_t i{ 1 }; i + 1 < chunk.faceCorners.size(); ++i)
+				{
+					AddCorner(chunk, chunk.faceCorners[0]);
+					AddCorner(chunk, chunk.faceCorners[i]);
+					AddCorner(chunk, chunk.faceCorners[i + 1]);
+				}
+			}
+
+			return true;
+		}
+
+		void ParseChunk(Chunk& chunk)
+		{
+			const char* p{ chunk.pBegin };
+			while (p != chunk.pEnd && chunk.isValid)
+			{
+				const void* pLineBreak{ std::memchr(p, '\n', chunk.pEnd - p) };
+				const char* pLineEnd{ pLineBreak ? static_cast<const char*>(pLineBreak) : chunk.pEnd };
+
+				chunk.isValid = ParseLine(p, pLineEnd, chunk);
+				p = pLineBreak ? pLineEnd + 1 : pLineEnd;
+			}
+		}
+
+		//One chunk per hardware thread, every chunk ends right after a line break. With fewer threads available they take the chunks in turn
+		std::vector<Chunk> SplitIntoChunks(const char* pData, size_t size)
+		{
+			const size_t numThreads{ std::max(std::thread::hardware_concurrency(), 1u) };
+			const size_t numChunks{ std::clamp<size_t>(size / MinChunkSize, 1, numThreads) };
+
+			std::vector<Chunk> chunks(numChunks);
+			const char* const pDataEnd{ pData + size };
+			const char* pBegin{ pData };
+			for (size_t i{ 0 }; i < numChunks; ++i)
+			{
+				const char* pEnd{ pDataEnd };
+				if (i + 1 < numChunks)
+				{
+					//Searching from the last byte keeps a split that already is on a line start
+					const char* pSearch{ std::max(pData + size * (i + 1) / numChunks - 1, pBegin) };
+					const void* pLineBreak{ std::memchr(pSearch, '\n', pDataEnd - pSearch) };
+					pEnd = pLineBreak ? static_cast<const char*>(pLineBreak) + 1 : pDataEnd;
+				}
+
+				chunks[i].pBegin = pBegin;
+				chunks[i].pEnd = pEnd;
+				pBegin = pEnd;
+			}
+
+			return chunks;
+		}
+
+		//Takes up to numWanted helper threads from the shared budget, never blocks
+		uint32_t AcquireHelperThreads(uint32_t numWanted)
+		{
+			int numFree{ g_NumFreeHelperThreads.load(std::memory_order_relaxed) };
+			int numTaken{};
+			do
+			{
+				numTaken = std::clamp(numFree, 0, static_cast<int>(numWanted));
+			} while (numTaken > 0 && !g_NumFreeHelperThreads.compare_exchange_weak(numFree, numFree - numTaken, std::memory_order_relaxed));
+
+			return static_cast<uint32_t>(numTaken);
+		}
+
+		//task(index) for every index in [0, numTasks) on the calling thread plus whatever helpers the budget has left, returns the number of threads used
+		uint32_t RunParallel(size_t numTasks, const std::function<void(size_t index)>& task)
+		{
+			const uint32_t numHelperThreads{ AcquireHelperThreads(static_cast<uint32_t>(std::max<size_t>(numTasks, 1) - 1)) };
+
+			std::atomic<size_t> nextTask{ 0 };
+			const auto runTasks = [&task, &nextTask, numTasks]()
+				{
+					for (size_t i{ nextTask++ }; i < numTasks; i = nextTask++)
+						task(i);
+				};
+
+			std::vector<std::thread> threads{};
+			threads.reserve(numHelperThreads);
+			for (uint32_t i{ 0 }; i < numHelperThreads; ++i)
+				threads.emplace_back(runTasks);
+
+			runTasks();
+
+			for (std::thread& thread : threads)
+				thread.join();
+
+			g_NumFreeHelperThreads.fetch_add(static_cast<int>(numHelperThreads), std::memory_order_relaxed);
+			return numHelperThreads + 1;
+		}
+
+		//Concatenates the chunks in file order (exactly sized, in parallel), resolves relative indices and checks every index
+		bool MergeChunks(std::vector<Chunk>& chunks, ObjMesh& mesh)
+		{
+			std::vector<Vector3>* meshElements[NumAttributes]{ &mesh.positions, &mesh.texCoords, &mesh.normals };
+			std::vector<int>* meshIndices[NumAttributes]{ &mesh.positionIndices, &mesh.texCoordIndices, &mesh.normalIndices };
+
+			//Every corner writes all attributes, so one corner offset per chunk is enough
+			std::vector<std::array<size_t, NumAttributes>> elementOffsets(chunks.size());
+			std::vector<size_t> cornerOffsets(chunks.size());
+
+			std::array<size_t, NumAttributes> numElements{};
+			size_t numCorners{ 0 };
+			for (size_t i{ 0 }; i < chunks.size(); ++i)
+			{
+				for (int attribute{ 0 }; attribute < NumAttributes; ++attribute)
+				{
+					elementOffsets[i][attribute] = numElements[attribute];
+					numElements[attribute] += chunks[i].elements[attribute].size();
+				}
+
+				cornerOffsets[i] = numCorners;
+				numCorners += chunks[i].indices[0].size();
+			}
+
+			for (int attribute{ 0 }; attribute < NumAttributes; ++attribute)
+			{
+				meshElements[attribute]->resize(numElements[attribute]);
+				meshIndices[attribute]->resize(numCorners);
+			}
+
+			RunParallel(chunks.size(), [&](size_t chunkIndex)
+				{
+					Chunk& chunk = chunks[chunkIndex];
+					for (int attribute{ 0 }; attribute < NumAttributes; ++attribute)
+					{
+						std::vector<Vector3>& elements = chunk.elements[attribute];
+						std::copy(elements.begin(), elements.end(), meshElements[attribute]->data() + elementOffsets[chunkIndex][attribute]);
+						elements = {};
+
+						std::vector<int>& indices = chunk.indices[attribute];
+						for (const size_t relativeIndex : chunk.relativeIndices[attribute])
+						{
+							indices[relativeIndex] += static_cast<int>(elementOffsets[chunkIndex][attribute]);
+							if (indices[relativeIndex] < 0)
+								chunk.isValid = false;
+						}
+
+						//Only the position is required
+						const int minIndex{ attribute == 0 ? 0 : -1 };
+						const int maxIndex{ static_cast<int>(numElements[attribute]) - 1 };
+						int* pMeshIndices{ meshIndices[attribute]->data() + cornerOffsets[chunkIndex] };
+						for (size_t i{ 0 }; i < indices.size(); ++i)
+						{
+							if (indices[i] < minIndex || indices[i] > maxIndex)
+								chunk.isValid = false;
+							pMeshIndices[i] = indices[i];
+						}
+						indices = {};
+					}
+				});
+
+			return std::all_of(chunks.begin(), chunks.end(), [](const Chunk& chunk) { return chunk.isValid; });
+		}
+	}
+
+	bool LoadOBJ(const std::string& filePath, ObjMesh& mesh, ObjLoadStats* pStats)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		MappedFile file{};
+		if (!file.Open(filePath))
+			return false;
+
+		std::vector<Chunk> chunks{ SplitIntoChunks(file.GetData(), file.GetSize()) };
+		const uint32_t numThreads{ RunParallel(chunks.size(), [&chunks](size_t chunkIndex) { ParseChunk(chunks[chunkIndex]); }) };
+
+		mesh = {};
+		if (!std::all_of(chunks.begin(), chunks.end(), [](const Chunk& chunk) { return chunk.isValid; }) || !MergeChunks(chunks, mesh))
+		{
+			mesh = {};
+			return false;
+		}
+
+		if (pStats)
+		{
+			pStats->numBytes = file.GetSize();
+			pStats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			pStats->numThreads = numThreads;
+		}
+
+		return true;
+	}
+
+	bool Utils::ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+	{
+		ObjMesh mesh{};
+		ObjLoadStats stats{};
+		if (!LoadOBJ(filename, mesh, &stats))
+		{
+			std::cout << "Could not load " << filename << std::endl;
+			return false;
+		}
+
+		std::cout << filename << ": " << mesh.positionIndices.size() / 3 << " triangles, " << static_cast<double>(stats.numBytes) / 1e6 << " MB in "
+			<< stats.seconds * 1000.0 << " ms (" << stats.GetMegabytesPerSecond() << " MB/s, " << stats.numThreads << " threads)" << std::endl;
+
+		positions = std::move(mesh.positions);
+		indices = std::move(mesh.positionIndices);
+
+		//Precompute normals
+		normals.clear();
+		normals.reserve(indices.size() / 3);
+		for (size_t index{ 0 }; index < indices.size(); index += 3)
+		{
+			const Vector3 edgeV0V1{ positions[indices[index + 1]] - positions[indices[index]] };
+			const Vector3 edgeV0V2{ positions[indices[index + 2]] - positions[indices[index]] };
+
+			normals.emplace_back(Vector3::Cross(edgeV0V1, edgeV0V2).Normalized());
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,45 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct ObjMesh
+	{
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> texCoords{}; //u, v, w (missing components are 0)
+		std::vector<Vector3> normals{}; //vn as written in the file, not normalized
+
+		//Three corners per triangle, zero based. -1 when the face leaves out the texture coordinate or the normal
+		std::vector<int> positionIndices{};
+		std::vector<int> texCoordIndices{};
+		std::vector<int> normalIndices{};
+	};
+
+	struct ObjLoadStats
+	{
+		uint64_t numBytes{};
+		double seconds{}; //mapping, parsing and merging
+		uint32_t numThreads{}; //that parsed, the calling one plus the helpers the shared budget had left
+
+		double GetMegabytesPerSecond() const { return seconds > 0.0 ? static_cast<double>(numBytes) / 1e6 / seconds : 0.0; }
+	};
+
+	/**
+	 * \brief Wavefront OBJ loader: the file gets memory mapped and split into line aligned chunks that are parsed in parallel (std::from_chars),
+	 * then the chunks are merged in file order. Concurrent loads share one budget of helper threads (one per hardware thread, minus one) so they do not oversubscribe the cores. Reads v, vt, vn and f with every corner syntax (v, v/vt, v//vn, v/vt/vn, negative relative indices),
+	 * polygons are fan triangulated (convex faces). Every other statement (groups, materials, lines, ...) is skipped.
+	 * Returns false when the file can not be mapped, a statement is malformed or a face references an element that does not exist.
+	 */
+	bool LoadOBJ(const std::string& filePath, ObjMesh& mesh, ObjLoadStats* pStats = nullptr);
+
+	namespace Utils
+	{
+		//Positions and indices through LoadOBJ plus one normal per triangle, prints the parse rate
+		bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices);
+	}
+}
@@ -0,0 +1,31 @@
+#include "Platform.h"
+
+//Standard includes
+#include <chrono>
+
+using namespace dae;
+
+namespace
+{
+	InputState g_InputState{};
+}
+
+uint64_t Platform::GetPerformanceCounter()
+{
+	return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+uint64_t Platform::GetPerformanceFrequency()
+{
+	return static_cast<uint64_t>(std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num);
+}
+
+void Platform::SetInputState(const InputState& inputState)
+{
+	g_InputState = inputState;
+}
+
+const InputState& Platform::GetInputState()
+{
+	return g_InputState;
+}
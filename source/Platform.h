@@ -0,0 +1,37 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+
+//Standard includes
+#include <cstdint>
+
+namespace dae
+{
+	//Camera controls of the current frame, filled in by the window front end, stays empty when headless
+	struct InputState
+	{
+		bool isForwardDown{};
+		bool isBackwardDown{};
+		bool isLeftDown{};
+		bool isRightDown{};
+
+		bool isLeftMouseDown{};
+		bool isRightMouseDown{};
+		int mouseDeltaX{};
+		int mouseDeltaY{};
+	};
+
+	/**
+	 * \brief Everything the renderer core needs from the platform (clock and input), so the headless and microbenchmark targets build and run without SDL.
+	 * Only the window front end (main.cpp) talks to SDL
+	 */
+	namespace Platform
+	{
+		//Monotonic clock, GetPerformanceFrequency counts per second
+		uint64_t GetPerformanceCounter();
+		uint64_t GetPerformanceFrequency();
+
+		//Main thread only
+		void SetInputState(const InputState& inputState);
+		const InputState& GetInputState();
+	}
+}
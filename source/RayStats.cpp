@@ -0,0 +1,104 @@
+#include "RayStats.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace dae
+{
+	namespace
+	{
+		//Blocks of every thread that ever counted something, threads of the pool live as long as the renderer so this stays small
+		struct ThreadCountersRegistry
+		{
+			std::mutex mutex{};
+			std::vector<std::unique_ptr<RayStats::ThreadCounters>> blocks{};
+		};
+
+		ThreadCountersRegistry& GetRegistry()
+		{
+			static ThreadCountersRegistry registry{};
+			return registry;
+		}
+
+		double GetRate(uint64_t numerator, uint64_t denominator)
+		{
+			return denominator > 0 ? static_cast<double>(numerator) / static_cast<double>(denominator) * 100.0 : 0.0;
+		}
+	}
+
+	const char* GetRayStatCounterName(RayStatCounter counter)
+	{
+		switch (counter)
+		{
+		case RayStatCounter::ClosestHitRays: return "closest hit rays";
+		case RayStatCounter::RayPackets: return "ray packets";
+		case RayStatCounter::OcclusionRays: return "occlusion rays";
+		case RayStatCounter::OcclusionRaysBlocked: return "occlusion rays blocked";
+		case RayStatCounter::OccluderCacheHits: return "occluder cache hits";
+		case RayStatCounter::NodesVisited: return "BVH nodes visited";
+		case RayStatCounter::SlabTests: return "slab tests";
+		case RayStatCounter::SlabTestsPassed: return "slab tests passed";
+		case RayStatCounter::SphereTests: return "sphere tests";
+		case RayStatCounter::PlaneTests: return "plane tests";
+		case RayStatCounter::TriangleTests: return "triangle tests";
+		case RayStatCounter::Count: break;
+		}
+
+		return "unknown";
+	}
+
+	RayStatCounters& RayStatCounters::operator+=(const RayStatCounters& other)
+	{
+		for (uint32_t i{ 0 }; i < static_cast<uint32_t>(RayStatCounter::Count); ++i)
+			values[i] += other.values[i];
+
+		return *this;
+	}
+
+	RayStats::ThreadCounters& RayStats::RegisterThreadCounters()
+	{
+		ThreadCountersRegistry& registry = GetRegistry();
+		const std::lock_guard lock{ registry.mutex };
+
+		t_pThreadCounters = registry.blocks.emplace_back(std::make_unique<ThreadCounters>()).get();
+		return *t_pThreadCounters;
+	}
+
+	RayStatCounters RayStats::CollectFrame()
+	{
+		ThreadCountersRegistry& registry = GetRegistry();
+		const std::lock_guard lock{ registry.mutex };
+
+		RayStatCounters frame{};
+		for (const auto& pBlock : registry.blocks)
+		{
+			frame += *pBlock;
+			*pBlock = {};
+		}
+
+		return frame;
+	}
+
+	void RayStats::Print(std::ostream& stream, const RayStatCounters& counters, uint32_t numFrames)
+	{
+		if (numFrames == 0)
+			return;
+
+		stream << "Per frame (average of " << numFrames << "):\n";
+		for (uint32_t i{ 0 }; i < static_cast<uint32_t>(RayStatCounter::Count); ++i)
+		{
+			stream << "  " << std::left << std::setw(24) << GetRayStatCounterName(static_cast<RayStatCounter>(i))
+				<< std::right << std::setw(14) << counters.values[i] / numFrames << '\n';
+		}
+
+		const auto previousFlags = stream.flags();
+		stream << std::fixed << std::setprecision(1)
+			<< "  slab tests passed: " << GetRate(counters[RayStatCounter::SlabTestsPassed], counters[RayStatCounter::SlabTests]) << "%"
+			<< ", occlusion rays blocked: " << GetRate(counters[RayStatCounter::OcclusionRaysBlocked], counters[RayStatCounter::OcclusionRays]) << "%"
+			<< " (" << GetRate(counters[RayStatCounter::OccluderCacheHits], counters[RayStatCounter::OcclusionRays]) << "% by the occluder cache)" << std::endl;
+		stream.flags(previousFlags);
+	}
+}
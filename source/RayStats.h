@@ -0,0 +1,78 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+
+//Define RAY_STATS (project wide) to count rays and traversal work, without it every RAY_STATS_* macro compiles to nothing
+#if defined(RAY_STATS)
+#define RAY_STATS_ADD(counter, value) (::dae::RayStats::GetThreadCounters().values[static_cast<uint32_t>(::dae::RayStatCounter::counter)] += (value))
+#else
+#define RAY_STATS_ADD(counter, value) ((void)0)
+#endif
+
+#define RAY_STATS_INC(counter) RAY_STATS_ADD(counter, 1)
+
+namespace dae
+{
+	enum class RayStatCounter : uint32_t
+	{
+		ClosestHitRays, //Scene::GetClosestHit and every lane of Scene::GetClosestHits
+		RayPackets,
+		OcclusionRays, //Scene::DoesHit
+		OcclusionRaysBlocked,
+		OccluderCacheHits, //blocked by the occluder of the previous shadow ray, no traversal needed
+		NodesVisited, //BVH nodes popped from the traversal stack, packets count once per node
+		SlabTests, //per ray, a packet counts one per active lane
+		SlabTestsPassed,
+		SphereTests, //spheres in the leaves that were handed to the kernels, any-hit kernels may stop before the last one
+		PlaneTests,
+		TriangleTests,
+
+		Count
+	};
+
+	const char* GetRayStatCounterName(RayStatCounter counter);
+
+	struct RayStatCounters
+	{
+		uint64_t values[static_cast<uint32_t>(RayStatCounter::Count)]{};
+
+		uint64_t operator[](RayStatCounter counter) const { return values[static_cast<uint32_t>(counter)]; }
+		RayStatCounters& operator+=(const RayStatCounters& other);
+	};
+
+	/**
+	 * \brief Per thread counters, every thread writes its own cache line padded block without any synchronization.
+	 * CollectFrame sums and clears the blocks of all threads, call it only while no thread traces (end of the frame)
+	 */
+	namespace RayStats
+	{
+#if defined(RAY_STATS)
+		constexpr bool IsEnabled{ true };
+#else
+		constexpr bool IsEnabled{ false };
+#endif
+
+		struct alignas(64) ThreadCounters : RayStatCounters {};
+
+		//Block of the calling thread, null until its first increment. Constant initialized, so reading it is a plain TLS load without an init guard
+		inline thread_local ThreadCounters* t_pThreadCounters{ nullptr };
+
+		//Out of line slow path, registers a block for the calling thread (kept until the process ends) and stores it in t_pThreadCounters
+		ThreadCounters& RegisterThreadCounters();
+
+		//Inline so an increment is one TLS load and an add, only the first one of a thread leaves the header
+		inline ThreadCounters& GetThreadCounters()
+		{
+			ThreadCounters* pCounters{ t_pThreadCounters };
+			if (!pCounters) [[unlikely]]
+				return RegisterThreadCounters();
+			return *pCounters;
+		}
+
+		RayStatCounters CollectFrame();
+
+		//Averages over numFrames frames, one line per counter with the slab test and shadow ray rates at the end
+		void Print(std::ostream& stream, const RayStatCounters& counters, uint32_t numFrames);
+	}
+}
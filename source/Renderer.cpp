@@ -1,34 +1,102 @@
-//External includes
-#include "SDL.h"
-#include "SDL_surface.h"
-
 //Project includes
 #include "Renderer.h"
+#include "FrameTrace.h"
 #include "Math.h"
 #include "Matrix.h"
 #include "Material.h"
 #include "Scene.h"
 #include "Utils.h"
 
-#include <future>
-#include <ppl.h>
+#include <bit>
+#include <chrono>
+#include <fstream>
 
 using namespace dae;
 
-//#define ASYNC
-#define PARALLEL_FOR
+namespace
+{
+	//Ray from just above the hit point towards the light, max is the distance to the light
+	Ray GetShadowRay(const HitRecord& closestHit, const Light& light)
+	{
+		const Vector3 origin{ closestHit.origin + (closestHit.normal * 0.0001f) };
+		const Vector3 lightDir{ LightUtils::GetDirectionToLight(light, origin) };
+
+		return { origin, lightDir.Normalized(), 0.0001f, lightDir.Magnitude() };
+	}
+
+	double GetSecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//One per thread and per light, consecutive shadow rays of a thread mostly come from neighbouring pixels
+	Occluder& GetLastOccluder(size_t lightIndex)
+	{
+		thread_local std::vector<Occluder> lastOccluders{};
+		if (lightIndex >= lastOccluders.size())
+			lastOccluders.resize(lightIndex + 1);
+
+		return lastOccluders[lightIndex];
+	}
+
+	//Work done by the calling thread so far, only counts with RAY_STATS
+	uint64_t GetCostCount(Renderer::CostView costView)
+	{
+		if constexpr (!RayStats::IsEnabled)
+			return 0;
+
+		const RayStatCounters& counters = RayStats::GetThreadCounters();
+		if (costView == Renderer::CostView::Traversal)
+			return counters[RayStatCounter::NodesVisited] + counters[RayStatCounter::SlabTests];
+
+		return counters[RayStatCounter::SphereTests] + counters[RayStatCounter::PlaneTests] + counters[RayStatCounter::TriangleTests];
+	}
+
+	//t in [0, 1]: dark blue, blue, cyan, yellow, red
+	ColorRGB GetHeatmapColor(float t)
+	{
+		static const ColorRGB stops[]{ { 0.f, 0.f, 0.3f }, { 0.f, 0.2f, 1.f }, { 0.f, 1.f, 1.f }, { 1.f, 1.f, 0.f }, { 1.f, 0.f, 0.f } };
+		constexpr int lastStop{ static_cast<int>(std::size(stops)) - 1 };
+
+		const float position{ std::clamp(t, 0.f, 1.f) * static_cast<float>(lastStop) };
+		const int stop{ std::min(static_cast<int>(position), lastStop - 1) };
+		const float blend{ position - static_cast<float>(stop) };
+
+		return stops[stop] * (1.f - blend) + stops[stop + 1] * blend;
+	}
+
+	//Framebuffer format, color channels in [0, 1]
+	uint32_t PackARGB(const ColorRGB& color)
+	{
+		return 0xFF000000u
+			| static_cast<uint32_t>(static_cast<uint8_t>(color.r * 255)) << 16
+			| static_cast<uint32_t>(static_cast<uint8_t>(color.g * 255)) << 8
+			| static_cast<uint32_t>(static_cast<uint8_t>(color.b * 255));
+	}
+}
 
-Renderer::Renderer(SDL_Window * pWindow) :
-	m_pWindow(pWindow),
-	m_pBuffer(SDL_GetWindowSurface(pWindow))
+Renderer::Renderer(int width, int height, PresentFunction present) :
+	m_Present(std::move(present)),
+	m_Width(width),
+	m_Height(height),
+	m_Pitch((static_cast<uint32_t>(width) + PitchAlignment - 1) / PitchAlignment * PitchAlignment),
+	m_BufferPixels(static_cast<size_t>(m_Pitch) * height)
 {
-	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
-	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
 }
 
-void Renderer::Render(Scene* pScene) const
+void Renderer::Render(Scene* pScene)
 {
+	RenderStats stats{};
+	auto passStart = std::chrono::steady_clock::now();
+
+	{
+		TRACE_ZONE("UpdateTransforms");
+		pScene->UpdateTransforms();
+		pScene->UpdateTopLevelBVH();
+	}
+
+	stats.updateTransformsTime = GetSecondsSince(passStart);
+
 	Camera& camera = pScene->GetCamera();
 	camera.CalculateCameraToWorld();
 
@@ -41,70 +109,215 @@ void Renderer::Render(Scene* pScene) const
 	auto& lights = pScene->GetLights();
 
 	const uint32_t numPixels = m_Width * m_Height;
+	m_PrimaryHits.assign(static_cast<size_t>(m_Pitch) * m_Height, {});
+	stats.numPrimaryRays = numPixels;
 
-#if defined(ASYNC)
-	//Async
+	if (m_CostView != CostView::Off)
+	{
+		//Trace and shade run as one pass, the whole pass counts as trace time
+		passStart = std::chrono::steady_clock::now();
+		stats.numShadowRays = RenderCostPass(pScene, fov, aspectRatio, camera, lights, materials);
+		DrawCostHeatmap();
+		stats.traceTime = GetSecondsSince(passStart);
+	}
+	else
+	{
+		//Primary rays: one task per tile, traced pixel by pixel or as packets of RayPacket::Width x RayPacket::Width pixels
+		passStart = std::chrono::steady_clock::now();
+		{
+			TRACE_ZONE("TracePrimaryRays");
+			m_TileScheduler.RunTiles(m_Width, m_Height, [&](const Tile& tile)
+				{
+					if (m_PacketTracingEnabled)
+					{
+						//Tile origins and heights are multiples of the packet width, packets only stick out of the image itself
+						for (uint32_t y{ tile.y }; y < tile.y + tile.height; y += RayPacket::Width)
+							for (uint32_t x{ tile.x }; x < tile.x + tile.width; x += RayPacket::Width)
+								TracePacket(pScene, static_cast<int>(x), static_cast<int>(y), fov, aspectRatio, camera);
+					}
+					else
+					{
+						for (uint32_t y{ tile.y }; y < tile.y + tile.height; ++y)
+							for (uint32_t x{ tile.x }; x < tile.x + tile.width; ++x)
+								TracePixel(pScene, y * m_Pitch + x, fov, aspectRatio, camera);
+					}
+				});
+		}
 
-	const uint32_t numCores = std::thread::hardware_concurrency();
-	std::vector<std::future<void>> async_futures{};
-	const uint32_t numPixelsPerTask = numPixels / numCores;
-	uint32_t numUnassignedPixels = numPixels % numCores;
-	uint32_t currPixelIndex = 0;
+		stats.traceTime = GetSecondsSince(passStart);
 
-	for (uint32_t coreId{0}; coreId < numCores; ++coreId)
-	{
-		uint32_t taskSize = numPixelsPerTask;
-		if (numUnassignedPixels > 0)
+		//Shadow rays: either one stream for the whole frame, or traced while shading
+		const bool streamShadowRays{ m_ShadowsEnabled && m_ShadowRayStreamEnabled && CanStreamShadowRays(lights.size()) };
+		if (streamShadowRays)
 		{
-			++taskSize;
-			--numUnassignedPixels;
+			passStart = std::chrono::steady_clock::now();
+			stats.numShadowRays = TraceShadowRayStream(pScene, lights);
+			stats.shadowTraceTime = GetSecondsSince(passStart);
 		}
 
-		async_futures.push_back(std::async(std::launch::async, [=, this]
-			{
-				// render all pixels for this task (currPixelIndex > currPixelIndex + taskSize)
-				const uint32_t pixelIndexEnd = currPixelIndex + taskSize;
-				for (uint32_t pixelIndex{ currPixelIndex }; pixelIndex < pixelIndexEnd; ++pixelIndex)
+		passStart = std::chrono::steady_clock::now();
+		m_NumInlineShadowRays.store(0, std::memory_order_relaxed);
+
+		{
+			TRACE_ZONE("Shade");
+			m_TileScheduler.RunTiles(m_Width, m_Height, [&](const Tile& tile)
 				{
-					RenderPixel(pScene, pixelIndex, fov, aspectRatio, camera, lights, materials);
-				}
-			}));
+					uint32_t numShadowRays{ 0 };
+
+					for (uint32_t y{ tile.y }; y < tile.y + tile.height; ++y)
+					{
+						for (uint32_t x{ tile.x }; x < tile.x + tile.width; ++x)
+						{
+							const uint32_t pixelIndex{ y * m_Pitch + x };
+							const uint8_t* pOcclusion{ streamShadowRays ? m_ShadowOcclusion.data() + static_cast<size_t>(pixelIndex) * lights.size() : nullptr };
+							numShadowRays += ShadePixel(pScene, pixelIndex, camera, lights, materials, pOcclusion);
+						}
+					}
+
+					//Once per tile, keeps the shared counter out of the pixel loop
+					m_NumInlineShadowRays.fetch_add(numShadowRays, std::memory_order_relaxed);
+				});
+		}
 
-		currPixelIndex += taskSize;
+		stats.numShadowRays += m_NumInlineShadowRays.load(std::memory_order_relaxed);
+		stats.shadeTime = GetSecondsSince(passStart);
+	}
 
-		// wait for async completion of all tasks
-		for (const std::future<void>& f : async_futures)
-			f.wait();
+	//@END
+	//Present
+	passStart = std::chrono::steady_clock::now();
+	if (m_Present)
+	{
+		TRACE_ZONE("Present");
+		m_Present(m_BufferPixels.data(), m_Width, m_Height, m_Pitch);
 	}
+	stats.presentTime = GetSecondsSince(passStart);
 
-#elif defined(PARALLEL_FOR)
-	//Parallel for
+	if constexpr (RayStats::IsEnabled)
+		stats.rayStats = RayStats::CollectFrame();
 
-	concurrency::parallel_for(0u, numPixels, [=, this](int i)
-		{
-			RenderPixel(pScene, i, fov, aspectRatio, camera, lights, materials);
-		});
+	m_LastFrameStats = stats;
+}
+
+void Renderer::TracePixel(const Scene* pScene, const uint32_t pixelIndex, const float fov, const float aspectRatio, const Camera& camera)
+{
+	const int px = static_cast<int>(pixelIndex % m_Pitch);
+	const int py = static_cast<int>(pixelIndex / m_Pitch);
+
+	const Ray viewRay{ GetViewRay(px, py, fov, aspectRatio, camera) };
 
-#else
-	// no threading
-	for (uint32_t i{0}; i < numPixels; ++i)
+	pScene->GetClosestHit(viewRay, m_PrimaryHits[pixelIndex]);
+}
+
+void Renderer::TracePacket(const Scene* pScene, const int firstX, const int firstY, const float fov, const float aspectRatio, const Camera& camera)
+{
+	//Lanes past the screen edge still get a ray (keeps the packet frustum intact), they just stay masked off
+	RayPacket packet{};
+	uint32_t laneMask{ 0 };
+
+	for (uint32_t lane{ 0 }; lane < RayPacket::Size; ++lane)
 	{
-		RenderPixel(pScene, i, fov, aspectRatio, camera, lights, materials);
+		const int px = firstX + static_cast<int>(lane % RayPacket::Width);
+		const int py = firstY + static_cast<int>(lane / RayPacket::Width);
+
+		packet.SetRay(lane, GetViewRay(px, py, fov, aspectRatio, camera));
+
+		if (px < m_Width && py < m_Height)
+			laneMask |= 1u << lane;
 	}
 
-#endif
+	packet.UpdateFrustum();
 
-	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	HitRecord closestHits[RayPacket::Size]{};
+	pScene->GetClosestHits(packet, laneMask, closestHits);
+
+	for (; laneMask != 0; laneMask &= laneMask - 1)
+	{
+		const uint32_t lane = std::countr_zero(laneMask);
+		const int px = firstX + static_cast<int>(lane % RayPacket::Width);
+		const int py = firstY + static_cast<int>(lane / RayPacket::Width);
+
+		m_PrimaryHits[px + (py * m_Pitch)] = closestHits[lane];
+	}
 }
 
-void Renderer::RenderPixel(const Scene* pScene, const uint32_t pixelIndex, const float fov, const float aspectRatio, const Camera& camera,
-                           const std::vector<Light>& lights, const std::vector<Material*>& materials) const
+uint32_t Renderer::TraceShadowRayStream(const Scene* pScene, const std::vector<Light>& lights)
 {
-	const int px = static_cast<int>(pixelIndex) % m_Width;
-	const int py = static_cast<int>(pixelIndex) / m_Width;
+	TRACE_ZONE("TraceShadowRayStream");
+
+	const uint32_t numLights = static_cast<uint32_t>(lights.size());
+	//Checked by CanStreamShadowRays, every slot and bin fits in a uint32_t below NoShadowRay
+	const size_t numSlots = m_PrimaryHits.size() * numLights;
+	const size_t numBins = static_cast<size_t>(numLights) * 8;
+
+	m_ShadowRayBins.assign(numSlots, NoShadowRay); //padding columns stay empty
+	m_ShadowRaySlots.resize(numSlots);
+	m_ShadowOcclusion.assign(numSlots, 0);
+
+	//Generate: one slot per (pixel, light), binned by light and by the octant of the ray direction
+	m_TileScheduler.RunTiles(m_Width, m_Height, [&](const Tile& tile)
+		{
+			for (uint32_t y{ tile.y }; y < tile.y + tile.height; ++y)
+			{
+				for (uint32_t x{ tile.x }; x < tile.x + tile.width; ++x)
+				{
+					const uint32_t pixelIndex{ y * m_Pitch + x };
+					const HitRecord& closestHit = m_PrimaryHits[pixelIndex];
+
+					for (uint32_t lightIndex{ 0 }; lightIndex < numLights; ++lightIndex)
+					{
+						const uint32_t slot{ pixelIndex * numLights + lightIndex };
+						if (!closestHit.didHit)
+							continue;
+
+						const Ray shadowRay{ GetShadowRay(closestHit, lights[lightIndex]) };
+						if (Vector3::Dot(closestHit.normal, shadowRay.direction) < 0)
+							continue;
+
+						const uint32_t octant{ (shadowRay.direction.x < 0.f ? 1u : 0u) | (shadowRay.direction.y < 0.f ? 2u : 0u) | (shadowRay.direction.z < 0.f ? 4u : 0u) };
+						m_ShadowRayBins[slot] = lightIndex * 8 + octant;
+					}
+				}
+			}
+		});
 
+	//Sort: counting sort on the bin, stable so every bin stays in screen order
+	std::vector<uint32_t> binOffsets(numBins + 1, 0);
+	for (const uint32_t bin : m_ShadowRayBins)
+		if (bin != NoShadowRay)
+			++binOffsets[bin + 1];
+
+	for (size_t bin{ 0 }; bin < numBins; ++bin)
+		binOffsets[bin + 1] += binOffsets[bin];
+
+	const uint32_t numShadowRays{ binOffsets[numBins] };
+	for (uint32_t slot{ 0 }; slot < static_cast<uint32_t>(numSlots); ++slot)
+		if (m_ShadowRayBins[slot] != NoShadowRay)
+			m_ShadowRaySlots[binOffsets[m_ShadowRayBins[slot]]++] = slot;
+
+	//Trace: contiguous batches of the sorted stream, results get scattered back to their slot
+	const uint32_t numBatches{ (numShadowRays + ShadowRayBatchSize - 1) / ShadowRayBatchSize };
+	m_TileScheduler.Run(numBatches, [&](uint32_t batchIndex)
+		{
+			TRACE_ZONE("ShadowRayBatch");
+
+			const uint32_t first{ batchIndex * ShadowRayBatchSize };
+			const uint32_t last{ std::min(first + ShadowRayBatchSize, numShadowRays) };
+
+			for (uint32_t i{ first }; i < last; ++i)
+			{
+				const uint32_t slot{ m_ShadowRaySlots[i] };
+				const Ray shadowRay{ GetShadowRay(m_PrimaryHits[slot / numLights], lights[slot % numLights]) };
+
+				m_ShadowOcclusion[slot] = pScene->DoesHit(shadowRay, GetLastOccluder(slot % numLights)) ? 1 : 0;
+			}
+		});
+
+	return numShadowRays;
+}
+
+Ray Renderer::GetViewRay(const int px, const int py, const float fov, const float aspectRatio, const Camera& camera) const
+{
 	const float rx = static_cast<float>(px) + 0.5f;
 	const float ry = static_cast<float>(py) + 0.5f;
 
@@ -115,31 +328,47 @@ void Renderer::RenderPixel(const Scene* pScene, const uint32_t pixelIndex, const
 	rayDirection = camera.cameraToWorld.TransformVector(rayDirection);
 	rayDirection.Normalize();
 
-	const Ray viewRay{ camera.origin, rayDirection };
-	ColorRGB finalColor{};
-	HitRecord closestHit{};
+	return { camera.origin, rayDirection };
+}
 
-	pScene->GetClosestHit(viewRay, closestHit);
+uint32_t Renderer::ShadePixel(const Scene* pScene, const uint32_t pixelIndex, const Camera& camera, const std::vector<Light>& lights,
+                          const std::vector<Material*>& materials, const uint8_t* pOcclusion)
+{
+	const HitRecord& closestHit = m_PrimaryHits[pixelIndex];
+	ColorRGB finalColor{};
+	uint32_t numShadowRays{ 0 };
 
 	if (!closestHit.didHit)
 		finalColor = colors::Black;
 
 	else
 	{
-		for (const auto& light : lights)
+		for (size_t lightIndex{ 0 }; lightIndex < lights.size(); ++lightIndex)
 		{
-			Vector3 lightDir{ LightUtils::GetDirectionToLight(light, closestHit.origin + (closestHit.normal * 0.0001f)) };
-			Vector3 normalizedLightDir{ lightDir.Normalized() };
+			const Light& light = lights[lightIndex];
 
-			Ray lightRay{ closestHit.origin + (closestHit.normal * 0.0001f),normalizedLightDir,0.0001f, lightDir.Magnitude() };
+			const Ray lightRay{ GetShadowRay(closestHit, light) };
+			const Vector3& normalizedLightDir{ lightRay.direction };
 
 			const float observedArea{ Vector3::Dot(closestHit.normal,normalizedLightDir) };
 			if (observedArea < 0)
 				continue;
 
 			if (m_ShadowsEnabled)
-				if (pScene->DoesHit(lightRay))
-					continue;
+			{
+				//Streamed shadow rays were traced up front, the rest is traced right here
+				if (pOcclusion)
+				{
+					if (pOcclusion[lightIndex] != 0)
+						continue;
+				}
+				else
+				{
+					++numShadowRays;
+					if (pScene->DoesHit(lightRay, GetLastOccluder(lightIndex)))
+						continue;
+				}
+			}
 
 			switch (m_CurrentLightingMode)
 			{
@@ -164,15 +393,154 @@ void Renderer::RenderPixel(const Scene* pScene, const uint32_t pixelIndex, const
 	//Update Color in Buffer
 	finalColor.MaxToOne();
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+	m_BufferPixels[pixelIndex] = PackARGB(finalColor);
+
+	return numShadowRays;
+}
+
+uint32_t Renderer::RenderCostPass(const Scene* pScene, const float fov, const float aspectRatio, const Camera& camera, const std::vector<Light>& lights,
+                                  const std::vector<Material*>& materials)
+{
+	TRACE_ZONE("CostPass");
+
+	m_PixelCosts.assign(m_PrimaryHits.size(), 0.f);
+	m_NumInlineShadowRays.store(0, std::memory_order_relaxed);
+
+	m_TileScheduler.RunTiles(m_Width, m_Height, [&](const Tile& tile)
+		{
+			uint32_t numShadowRays{ 0 };
+
+			for (uint32_t y{ tile.y }; y < tile.y + tile.height; ++y)
+			{
+				for (uint32_t x{ tile.x }; x < tile.x + tile.width; ++x)
+				{
+					const uint32_t pixelIndex{ y * m_Pitch + x };
+					const uint64_t countBefore{ GetCostCount(m_CostView) };
+					const auto pixelStart = std::chrono::steady_clock::now();
+
+					TracePixel(pScene, pixelIndex, fov, aspectRatio, camera);
+					numShadowRays += ShadePixel(pScene, pixelIndex, camera, lights, materials, nullptr);
+
+					if (m_CostView == CostView::Time)
+						m_PixelCosts[pixelIndex] = static_cast<float>(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - pixelStart).count());
+					else
+						m_PixelCosts[pixelIndex] = static_cast<float>(GetCostCount(m_CostView) - countBefore);
+				}
+			}
+
+			m_NumInlineShadowRays.fetch_add(numShadowRays, std::memory_order_relaxed);
+		});
+
+	return static_cast<uint32_t>(m_NumInlineShadowRays.load(std::memory_order_relaxed));
+}
+
+void Renderer::DrawCostHeatmap()
+{
+	TRACE_ZONE("DrawCostHeatmap");
+
+	if (m_PixelCosts.empty())
+		return;
+
+	//Scaled to the 99th percentile, a handful of extreme pixels would wash out the rest otherwise
+	std::vector<float> sortedCosts{};
+	sortedCosts.reserve(static_cast<size_t>(m_Width) * m_Height);
+	for (int y{ 0 }; y < m_Height; ++y)
+	{
+		const auto row = m_PixelCosts.begin() + static_cast<ptrdiff_t>(y) * m_Pitch;
+		sortedCosts.insert(sortedCosts.end(), row, row + m_Width);
+	}
+
+	const auto percentile = sortedCosts.begin() + static_cast<ptrdiff_t>(sortedCosts.size() * 99 / 100);
+	std::nth_element(sortedCosts.begin(), percentile, sortedCosts.end());
+	const float inverseMaxCost{ 1.f / std::max(*percentile, 1.f) };
+
+	for (uint32_t y{ 0 }; y < static_cast<uint32_t>(m_Height); ++y)
+	{
+		for (uint32_t x{ 0 }; x < static_cast<uint32_t>(m_Width); ++x)
+		{
+			const uint32_t pixelIndex{ y * m_Pitch + x };
+			m_BufferPixels[pixelIndex] = PackARGB(GetHeatmapColor(m_PixelCosts[pixelIndex] * inverseMaxCost));
+		}
+	}
 }
 
-bool Renderer::SaveBufferToImage() const
+bool Renderer::SaveBufferToImage(const char* filePath) const
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	std::ofstream file{ filePath, std::ios::binary };
+	if (!file)
+		return true;
+
+	//BITMAPFILEHEADER + BITMAPINFOHEADER, little endian. 32 bit BI_RGB pixels are stored as B, G, R, X: the ARGB8888 words as they are in memory
+	const uint32_t imageSize{ static_cast<uint32_t>(static_cast<size_t>(m_Width) * m_Height * sizeof(uint32_t)) };
+	constexpr uint32_t headerSize{ 14 + 40 };
+
+	uint8_t header[headerSize]{};
+	const auto write16 = [&header](size_t offset, uint16_t value)
+		{
+			header[offset] = static_cast<uint8_t>(value);
+			header[offset + 1] = static_cast<uint8_t>(value >> 8);
+		};
+	const auto write32 = [&header](size_t offset, uint32_t value)
+		{
+			for (size_t byte{ 0 }; byte < 4; ++byte)
+				header[offset + byte] = static_cast<uint8_t>(value >> (byte * 8));
+		};
+
+	header[0] = 'B';
+	header[1] = 'M';
+	write32(2, headerSize + imageSize);
+	write32(10, headerSize);
+	write32(14, 40);
+	write32(18, static_cast<uint32_t>(m_Width));
+	write32(22, static_cast<uint32_t>(-m_Height)); //negative height: rows stored top to bottom
+	write16(26, 1);
+	write16(28, 32);
+	write32(34, imageSize);
+	write32(38, 2835); //72 DPI
+	write32(42, 2835);
+
+	file.write(reinterpret_cast<const char*>(header), headerSize);
+	for (int y{ 0 }; y < m_Height; ++y)
+	{
+		for (int x{ 0 }; x < m_Width; ++x)
+		{
+			const uint32_t pixel{ m_BufferPixels[static_cast<size_t>(y) * m_Pitch + x] };
+			const uint8_t bgra[4]{ static_cast<uint8_t>(pixel), static_cast<uint8_t>(pixel >> 8), static_cast<uint8_t>(pixel >> 16), static_cast<uint8_t>(pixel >> 24) };
+			file.write(reinterpret_cast<const char*>(bgra), 4);
+		}
+	}
+
+	return !file;
+}
+
+bool Renderer::SaveCostsToFile(const char* filePath) const
+{
+	if (m_PixelCosts.empty())
+		return true;
+
+	std::ofstream file{ filePath, std::ios::binary };
+	if (!file)
+		return true;
+
+	//PFM: text header, negative scale = little endian, rows stored bottom to top
+	file << "Pf\n" << m_Width << ' ' << m_Height << "\n-1.0\n";
+	for (int y{ m_Height - 1 }; y >= 0; --y)
+		file.write(reinterpret_cast<const char*>(m_PixelCosts.data() + static_cast<size_t>(y) * m_Pitch), static_cast<std::streamsize>(m_Width * sizeof(float)));
+
+	return !file;
+}
+
+void Renderer::CycleExecutionBackend()
+{
+	constexpr int numBackends{ static_cast<int>(ExecutionBackendType::StdPar) + 1 };
+	int next = static_cast<int>(GetExecutionBackend());
+
+	for (int i{ 0 }; i < numBackends; ++i)
+	{
+		next = (next + 1) % numBackends;
+		if (SetExecutionBackend(static_cast<ExecutionBackendType>(next)))
+			return;
+	}
 }
 
 void Renderer::CycleLightingMode()
@@ -187,3 +555,38 @@ void Renderer::CycleLightingMode()
 	++temp;
 	m_CurrentLightingMode = static_cast<LightingMode>(temp);
 }
+
+void Renderer::CycleCostView()
+{
+	constexpr int numCostViews{ static_cast<int>(CostView::Primitives) + 1 };
+	int next = static_cast<int>(m_CostView);
+
+	for (int i{ 0 }; i < numCostViews; ++i)
+	{
+		next = (next + 1) % numCostViews;
+		if (SetCostView(static_cast<CostView>(next)))
+			return;
+	}
+}
+
+bool Renderer::SetCostView(CostView costView)
+{
+	if (!RayStats::IsEnabled && (costView == CostView::Traversal || costView == CostView::Primitives))
+		return false;
+
+	m_CostView = costView;
+	return true;
+}
+
+const char* Renderer::GetCostViewName(CostView costView)
+{
+	switch (costView)
+	{
+	case CostView::Off: return "off";
+	case CostView::Time: return "time";
+	case CostView::Traversal: return "traversal";
+	case CostView::Primitives: return "primitives";
+	}
+
+	return "unknown";
+}
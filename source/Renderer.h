@@ -1,23 +1,65 @@
 // ReSharper disable CppInconsistentNaming
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <new>
 #include <vector>
 
-struct SDL_Window;
-struct SDL_Surface;
+#include "DataTypes.h"
+#include "RayStats.h"
+#include "TileScheduler.h"
 
 namespace dae
 {
 	class Material;
-	struct Light;
 	struct Camera;
 	class Scene;
 
+	//std::vector storage that starts on a 64 byte cache line
+	template<typename T>
+	struct CacheLineAllocator
+	{
+		using value_type = T;
+		static constexpr std::align_val_t Alignment{ 64 };
+
+		CacheLineAllocator() = default;
+		template<typename U>
+		CacheLineAllocator(const CacheLineAllocator<U>&) noexcept {}
+
+		T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), Alignment)); }
+		void deallocate(T* pValues, size_t) noexcept { ::operator delete(pValues, Alignment); }
+
+		template<typename U>
+		bool operator==(const CacheLineAllocator<U>&) const noexcept { return true; }
+	};
+
+	//Measurements of the last Render call, times in seconds
+	struct RenderStats
+	{
+		uint64_t numPrimaryRays{};
+		uint64_t numShadowRays{};
+
+		double updateTransformsTime{}; //Scene::UpdateTransforms + UpdateTopLevelBVH
+		double traceTime{}; //primary rays
+		double shadowTraceTime{}; //shadow ray stream only, inline shadow rays are part of shadeTime
+		double shadeTime{};
+		double presentTime{};
+
+		//Merged per thread counters of the frame, all zero unless RAY_STATS is defined
+		RayStatCounters rayStats{};
+	};
+
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		//Hands the finished frame (ARGB8888, row major from the top left, rows pitch pixels apart) to the platform, e.g. the SDL window of main.cpp
+		using PresentFunction = std::function<void(const uint32_t* pPixels, int width, int height, uint32_t pitch)>;
+
+		//The renderer always draws into its own framebuffer, without a present function (headless) nothing gets presented
+		Renderer(int width, int height, PresentFunction present = {});
 		~Renderer() = default;
 
 		Renderer(const Renderer&) = delete;
@@ -25,14 +67,57 @@ namespace dae
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
+		void Render(Scene* pScene);
 
-		void RenderPixel(const Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const;
+		//32 bit BMP, returns true when saving failed (SDL_SaveBMP convention)
+		bool SaveBufferToImage(const char* filePath = "RayTracing_Buffer.bmp") const;
 
-		bool SaveBufferToImage() const;
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+		uint32_t GetPitch() const { return m_Pitch; }
+		const RenderStats& GetLastFrameStats() const { return m_LastFrameStats; }
 
 		void CycleLightingMode();
 		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; }
+		void TogglePacketTracing() { m_PacketTracingEnabled = !m_PacketTracingEnabled; }
+		void ToggleShadowRayStream() { m_ShadowRayStreamEnabled = !m_ShadowRayStreamEnabled; }
+		void SetShadowRayStreamEnabled(bool isEnabled) { m_ShadowRayStreamEnabled = isEnabled; }
+
+		/**
+		 * \brief Debug view of where the render time goes: every pixel is traced and shaded on its own (no packets, no shadow ray stream)
+		 * and its cost is drawn as a heatmap. Time: nanoseconds per pixel. Traversal: BVH nodes + slab tests. Primitives: sphere, plane and triangle tests.
+		 * The count views need RAY_STATS, without it they get skipped
+		 */
+		enum class CostView
+		{
+			Off,
+			Time,
+			Traversal,
+			Primitives
+		};
+
+		void CycleCostView();
+		//Returns false (and keeps the current one) when the view needs RAY_STATS
+		bool SetCostView(CostView costView);
+		CostView GetCostView() const { return m_CostView; }
+		static const char* GetCostViewName(CostView costView);
+
+		//Raw per pixel costs of the last cost view frame as a grayscale PFM, returns true when saving failed (SDL_SaveBMP convention)
+		bool SaveCostsToFile(const char* filePath = "RayTracing_Cost.pfm") const;
+
+		uint32_t GetNumWorkers() const { return m_TileScheduler.GetNumWorkers(); }
+
+		//Returns false (and keeps the current one) when the backend is not available in this build
+		bool SetExecutionBackend(ExecutionBackendType type) { return m_TileScheduler.SetBackend(type); }
+		ExecutionBackendType GetExecutionBackend() const { return m_TileScheduler.GetBackend(); }
+		//Skips the backends that are not available in this build
+		void CycleExecutionBackend();
+
+		//Width gets rounded up to a multiple of TileScheduler::TileWidthAlignment, height to a multiple of RayPacket::Width
+		void SetTileSize(uint32_t width, uint32_t height)
+		{
+			m_TileScheduler.SetTileSize(width, (std::max(height, 1u) + RayPacket::Width - 1) / RayPacket::Width * RayPacket::Width);
+		}
 
 	private:
 		enum class LightingMode
@@ -45,14 +130,60 @@ namespace dae
 
 		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
 		bool m_ShadowsEnabled{ true };
+		bool m_PacketTracingEnabled{ true };
+		bool m_ShadowRayStreamEnabled{ false };
+		CostView m_CostView{ CostView::Off };
 
-		SDL_Window* m_pWindow{};
-
-		SDL_Surface* m_pBuffer{};
-		uint32_t* m_pBufferPixels{};
-
+		PresentFunction m_Present{}; //empty when headless
 
 		int m_Width{};
 		int m_Height{};
+
+		//Every per pixel buffer is pixelIndex = y * m_Pitch + x: the width rounded up to TileScheduler::TileWidthAlignment pixels (a 64 byte line of uint32_t / float),
+		//together with the cache line aligned storage below every tile edge falls on a line boundary and no two tiles share a line
+		static constexpr uint32_t PitchAlignment{ TileScheduler::TileWidthAlignment };
+		uint32_t m_Pitch{};
+
+		std::vector<uint32_t, CacheLineAllocator<uint32_t>> m_BufferPixels{}; //ARGB8888, padding columns stay unused
+
+		//Every pass of a frame runs through here, one task per tile (or per shadow ray batch)
+		TileScheduler m_TileScheduler{};
+
+		//Per frame buffers, primary hits are traced first and shaded afterwards
+		std::vector<HitRecord> m_PrimaryHits{};
+
+		RenderStats m_LastFrameStats{};
+		std::atomic<uint64_t> m_NumInlineShadowRays{ 0 };
+
+		//Shadow ray stream, one slot per (pixel, light): slot = pixelIndex * #lights + lightIndex
+		//Slots and bins are uint32_t, a frame with more slots than MaxShadowRaySlots traces its shadow rays inline (see CanStreamShadowRays)
+		static constexpr uint32_t NoShadowRay{ UINT32_MAX };
+		static constexpr uint64_t MaxShadowRaySlots{ NoShadowRay };
+		static constexpr uint32_t ShadowRayBatchSize{ 256 };
+
+		std::vector<uint32_t> m_ShadowRayBins{}; //lightIndex * 8 + direction octant, NoShadowRay when the light is behind the surface
+		std::vector<uint32_t> m_ShadowRaySlots{}; //slots sorted by bin
+		std::vector<uint8_t> m_ShadowOcclusion{}; //1 when the shadow ray of the slot is blocked
+
+		std::vector<float, CacheLineAllocator<float>> m_PixelCosts{}; //cost view only, rows m_Pitch apart
+
+		void TracePixel(const Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera);
+		//Traces the RayPacket::Width x RayPacket::Width block of camera rays starting at (firstX, firstY) as one packet
+		void TracePacket(const Scene* pScene, int firstX, int firstY, float fov, float aspectRatio, const Camera& camera);
+		//Generates every shadow ray of the frame, bins them by light and direction octant and traces the bins in batches
+		//Returns the number of shadow rays traced
+		uint32_t TraceShadowRayStream(const Scene* pScene, const std::vector<Light>& lights);
+		//Every slot index and every bin (at most #lights * 8, below the slot count) has to stay below NoShadowRay
+		bool CanStreamShadowRays(size_t numLights) const { return static_cast<uint64_t>(m_Pitch) * m_Height * numLights < MaxShadowRaySlots; }
+
+		Ray GetViewRay(int px, int py, float fov, float aspectRatio, const Camera& camera) const;
+		//pOcclusion: streamed shadow ray results of this pixel (one per light), nullptr traces the shadow rays inline
+		//Returns the number of shadow rays traced inline
+		uint32_t ShadePixel(const Scene* pScene, uint32_t pixelIndex, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials, const uint8_t* pOcclusion);
+
+		//Traces and shades every pixel on its own while measuring its cost, returns the number of shadow rays traced
+		uint32_t RenderCostPass(const Scene* pScene, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials);
+		//Overwrites the frame with the false color map of m_PixelCosts
+		void DrawCostHeatmap();
 	};
 }
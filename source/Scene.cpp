@@ -2,8 +2,13 @@
 #include "Scene.h"
 
 #include <algorithm>
+#include <bit>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
 
 #include "Utils.h"
+#include "MeshCache.h"
 #include "Material.h"
 
 namespace dae {
@@ -13,9 +18,10 @@ namespace dae {
 	Scene::Scene():
 		m_Materials({ new Material_SolidColor({1,0,0})})
 	{
-		m_SphereGeometries.reserve(32);
+		m_Spheres.Reserve(32);
 		m_PlaneGeometries.reserve(32);
 		m_TriangleMeshGeometries.reserve(32);
+		m_TriangleMeshInstances.reserve(32);
 		m_Lights.reserve(32);
 	}
 
@@ -32,63 +38,227 @@ namespace dae {
 
 	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
-		HitRecord tempHitRecord;  // t is set to FLT_MAX by default
+		RAY_STATS_INC(ClosestHitRays);
 
-		for (const auto& sphere : m_SphereGeometries)
-		{
-			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
-
-			if (closestHit.t < tempHitRecord.t)
-				tempHitRecord = closestHit;
-			else
-				closestHit = tempHitRecord;
-		}
+		//Every closer hit shrinks the ray, so farther geometry and BVH nodes get culled
+		Ray localRay{ ray };
+		HitRecord tempHitRecord{};
 
 		for (const auto& plane : m_PlaneGeometries)
 		{
-			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
-
-			if (closestHit.t < tempHitRecord.t)
-				tempHitRecord = closestHit;
-			else
+			if (GeometryUtils::HitTest_Plane(plane, localRay, tempHitRecord) && tempHitRecord.t < closestHit.t)
+			{
 				closestHit = tempHitRecord;
+				localRay.max = closestHit.t;
+			}
 		}
 
-		for (const auto& triangleMesh : m_TriangleMeshGeometries)
-		{
-			GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray, closestHit);
+		if (GeometryUtils::HitTest_SphereSet(m_Spheres, localRay, closestHit))
+			localRay.max = closestHit.t;
 
-			if (closestHit.t < tempHitRecord.t)
-				tempHitRecord = closestHit;
-			else
-				closestHit = tempHitRecord;
+		const uint32_t firstInstance = static_cast<uint32_t>(m_TriangleMeshGeometries.size());
+
+		GeometryUtils::TraverseBVH(m_TopLevelBVH, localRay, false, [&](uint32_t primitiveIndex)
+			{
+				if (primitiveIndex < firstInstance)
+				{
+					if (!GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitiveIndex], localRay, closestHit))
+						return false;
+				}
+				else if (!GeometryUtils::HitTest_TriangleMeshInstance(m_TriangleMeshInstances[primitiveIndex - firstInstance], localRay, closestHit))
+					return false;
+
+				localRay.max = closestHit.t;
+				return true;
+			});
+	}
+
+	void Scene::GetClosestHits(RayPacket& packet, uint32_t laneMask, HitRecord* closestHits) const
+	{
+		RAY_STATS_INC(RayPackets);
+		RAY_STATS_ADD(ClosestHitRays, std::popcount(laneMask));
+
+		//Planes are cheap and unbounded, no need to trace them as a packet
+		for (uint32_t lanes{ laneMask }; lanes != 0; lanes &= lanes - 1)
+		{
+			const uint32_t lane = std::countr_zero(lanes);
+			const Ray ray{ packet.GetRay(lane) };
+			HitRecord tempHitRecord{};
+
+			for (const auto& plane : m_PlaneGeometries)
+			{
+				if (GeometryUtils::HitTest_Plane(plane, ray, tempHitRecord) && tempHitRecord.t < closestHits[lane].t)
+				{
+					closestHits[lane] = tempHitRecord;
+					packet.max[lane] = std::min(packet.max[lane], tempHitRecord.t);
+				}
+			}
 		}
+
+		GeometryUtils::HitTest_SphereSet(m_Spheres, packet, laneMask, closestHits);
+
+		const uint32_t firstInstance = static_cast<uint32_t>(m_TriangleMeshGeometries.size());
+		const auto& primitiveIndices = m_TopLevelBVH.GetPrimitiveIndices();
+
+		GeometryUtils::TraverseBVHPacket(m_TopLevelBVH, packet, laneMask, [&](uint32_t, const BVHNode& leaf, uint32_t leafMask)
+			{
+				for (uint32_t i{ leaf.leftFirst }; i < leaf.leftFirst + leaf.primitiveCount; ++i)
+				{
+					const uint32_t primitiveIndex = primitiveIndices[i];
+
+					if (primitiveIndex < firstInstance)
+						GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitiveIndex], packet, leafMask, closestHits);
+					else
+						GeometryUtils::HitTest_TriangleMeshInstance(m_TriangleMeshInstances[primitiveIndex - firstInstance], packet, leafMask, closestHits);
+				}
+			});
 	}
 
 	bool Scene::DoesHit(const Ray& ray) const
 	{
-		if (std::ranges::any_of(m_SphereGeometries.begin(), m_SphereGeometries.end(), [&](const auto& sphere) {return GeometryUtils::HitTest_Sphere(sphere, ray); }))
-			return true;
+		Occluder occluder{};
+		return DoesHit(ray, occluder);
+	}
+
+	bool Scene::DoesHit(const Ray& ray, Occluder& lastOccluder) const
+	{
+		RAY_STATS_INC(OcclusionRays);
 
-		if (std::ranges::any_of(m_PlaneGeometries.begin(), m_PlaneGeometries.end(), [&](const auto& plane) {return GeometryUtils::HitTest_Plane(plane, ray); }))
+		if (IsOccludedBy(lastOccluder, ray))
+		{
+			RAY_STATS_INC(OccluderCacheHits);
+			RAY_STATS_INC(OcclusionRaysBlocked);
 			return true;
+		}
+
+		for (uint32_t i{ 0 }; i < static_cast<uint32_t>(m_PlaneGeometries.size()); ++i)
+		{
+			if (GeometryUtils::HitTest_Plane(m_PlaneGeometries[i], ray))
+			{
+				RAY_STATS_INC(OcclusionRaysBlocked);
+				lastOccluder = { Occluder::Type::Plane, i };
+				return true;
+			}
+		}
 
-		if (std::ranges::any_of(m_TriangleMeshGeometries.begin(), m_TriangleMeshGeometries.end(), [&](const auto& triangleMesh) {return GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray); }))
+		uint32_t sphereIndex{};
+		if (GeometryUtils::HitTest_SphereSet(m_Spheres, ray, sphereIndex))
+		{
+			RAY_STATS_INC(OcclusionRaysBlocked);
+			lastOccluder = { Occluder::Type::Sphere, sphereIndex };
 			return true;
+		}
+
+		const uint32_t firstInstance = static_cast<uint32_t>(m_TriangleMeshGeometries.size());
+		Ray localRay{ ray };
+
+		const bool isBlocked = GeometryUtils::TraverseBVH(m_TopLevelBVH, localRay, true, [&](uint32_t primitiveIndex)
+			{
+				uint32_t triangleIndex{};
+
+				if (primitiveIndex < firstInstance)
+				{
+					if (!GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitiveIndex], ray, triangleIndex))
+						return false;
+
+					lastOccluder = { Occluder::Type::TriangleMesh, primitiveIndex, triangleIndex };
+					return true;
+				}
+
+				if (!GeometryUtils::HitTest_TriangleMeshInstance(m_TriangleMeshInstances[primitiveIndex - firstInstance], ray, triangleIndex))
+					return false;
+
+				lastOccluder = { Occluder::Type::TriangleMeshInstance, primitiveIndex - firstInstance, triangleIndex };
+				return true;
+			});
+
+		RAY_STATS_ADD(OcclusionRaysBlocked, isBlocked ? 1 : 0);
+		return isBlocked;
+	}
+
+	//Single primitive test, the indices get validated since the occluder may stem from an older state of the scene
+	bool Scene::IsOccludedBy(const Occluder& occluder, const Ray& ray) const
+	{
+		switch (occluder.type)
+		{
+		case Occluder::Type::Plane:
+			return occluder.objectIndex < m_PlaneGeometries.size()
+				&& GeometryUtils::HitTest_Plane(m_PlaneGeometries[occluder.objectIndex], ray);
+
+		case Occluder::Type::Sphere:
+			return occluder.objectIndex < m_Spheres.GetCount()
+				&& GeometryUtils::HitTest_SphereSet(m_Spheres, occluder.objectIndex, ray);
+
+		case Occluder::Type::TriangleMesh:
+		{
+			if (occluder.objectIndex >= m_TriangleMeshGeometries.size())
+				return false;
+
+			const TriangleMesh& triangleMesh = m_TriangleMeshGeometries[occluder.objectIndex];
+			return occluder.triangleIndex < triangleMesh.indices.size() / 3
+				&& GeometryUtils::HitTest_TriangleMesh(triangleMesh, occluder.triangleIndex, ray);
+		}
+
+		case Occluder::Type::TriangleMeshInstance:
+		{
+			if (occluder.objectIndex >= m_TriangleMeshInstances.size())
+				return false;
+
+			const TriangleMeshInstance& instance = m_TriangleMeshInstances[occluder.objectIndex];
+			return occluder.triangleIndex < instance.pGeometry->indices.size() / 3
+				&& GeometryUtils::HitTest_TriangleMeshInstance(instance, occluder.triangleIndex, ray);
+		}
+
+		case Occluder::Type::None:
+			break;
+		}
 
 		return false;
 	}
 
-#pragma region Scene Helpers
-	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
+	void Scene::UpdateTopLevelBVH()
 	{
-		Sphere s;
-		s.origin = origin;
-		s.radius = radius;
-		s.materialIndex = materialIndex;
+		m_Spheres.UpdateBVH();
+
+		const uint32_t firstInstance = static_cast<uint32_t>(m_TriangleMeshGeometries.size());
+		const size_t numPrimitives{ firstInstance + m_TriangleMeshInstances.size() };
+
+		const auto primitiveBounds = [&](uint32_t primitiveIndex, Vector3& primitiveMin, Vector3& primitiveMax)
+		{
+			if (primitiveIndex < firstInstance)
+			{
+				const TriangleMesh& triangleMesh = m_TriangleMeshGeometries[primitiveIndex];
+				primitiveMin = triangleMesh.transformedMinAABB;
+				primitiveMax = triangleMesh.transformedMaxAABB;
+				return;
+			}
+
+			const TriangleMeshInstance& instance = m_TriangleMeshInstances[primitiveIndex - firstInstance];
+			primitiveMin = instance.transformedMinAABB;
+			primitiveMax = instance.transformedMaxAABB;
+		};
+
+		//Same objects as last frame: only the bounds moved
+		if (!m_TopLevelBVH.IsEmpty() && m_TopLevelBVH.GetPrimitiveCount() == numPrimitives)
+		{
+			m_TopLevelBVH.Refit(primitiveBounds);
+			if (m_TopLevelBVH.GetDegradation() <= m_TopLevelBVHRebuildThreshold)
+				return;
+		}
+
+		std::vector<Vector3> primitiveMin(numPrimitives);
+		std::vector<Vector3> primitiveMax(numPrimitives);
+
+		for (uint32_t i{ 0 }; i < static_cast<uint32_t>(numPrimitives); ++i)
+			primitiveBounds(i, primitiveMin[i], primitiveMax[i]);
+
+		m_TopLevelBVH.Build(primitiveMin, primitiveMax, 2);
+	}
 
-		m_SphereGeometries.emplace_back(s);
-		return &m_SphereGeometries.back();
+#pragma region Scene Helpers
+	uint32_t Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
+	{
+		return m_Spheres.Add(origin, radius, materialIndex);
 	}
 
 	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
@@ -112,6 +282,18 @@ namespace dae {
 		return &m_TriangleMeshGeometries.back();
 	}
 
+	TriangleMeshInstance* Scene::AddTriangleMeshInstance(const std::shared_ptr<const TriangleMeshGeometry>& pGeometry, TriangleCullMode cullMode, unsigned char materialIndex)
+	{
+		TriangleMeshInstance i{};
+		i.pGeometry = pGeometry;
+		i.cullMode = cullMode;
+		i.materialIndex = materialIndex;
+		i.UpdateTransforms();
+
+		m_TriangleMeshInstances.emplace_back(i);
+		return &m_TriangleMeshInstances.back();
+	}
+
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
@@ -144,285 +326,285 @@ namespace dae {
 #pragma endregion
 #pragma endregion
 	
-#pragma region SCENE W1
-	void Scene_W1::Initialize()
+#pragma region SCENE FILE
+	Scene_File::Scene_File(std::string name, SceneDescription description, std::string directory):
+		m_Description{ std::move(description) },
+		m_Directory{ std::move(directory) }
 	{
-				//default: Material id0 >> SolidColor Material (RED)
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
-
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
-
-		//Spheres
-		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
-		AddSphere({ 25.f, 0.f, 100.f }, 50.f, matId_Solid_Blue);
-
-		//Plane
-		AddPlane({ -75.f, 0.f, 0.f }, { 1.f, 0.f,0.f }, matId_Solid_Green);
-		AddPlane({ 75.f, 0.f, 0.f }, { -1.f, 0.f,0.f }, matId_Solid_Green);
-		AddPlane({ 0.f, -75.f, 0.f }, { 0.f, 1.f,0.f }, matId_Solid_Yellow);
-		AddPlane({ 0.f, 75.f, 0.f }, { 0.f, -1.f,0.f }, matId_Solid_Yellow);
-		AddPlane({ 0.f, 0.f, 125.f }, { 0.f, 0.f,-1.f }, matId_Solid_Magenta);
+		sceneName = std::move(name);
 	}
-#pragma endregion
 
-#pragma region SCENE W2
-	void Scene_W2::Initialize()
+	Scene_File::~Scene_File()
 	{
-		m_Camera.origin = { 0.f,3.f,-9.f };
-		m_Camera.fovAngle = 45.f;
-
-		//default: Material id0 >> SolidColor Material (RED)
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
-
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
-
-		////Plane
-		AddPlane({ -5.f,0.f,0.f }, { 1.f,0.f,0.f }, matId_Solid_Green);
-		AddPlane({ 5.f,0.f,0.f }, { -1.f,0.f,0.f }, matId_Solid_Green);
-		AddPlane({ 0.f,0.f,0.f }, { 0.f,1.f,0.f }, matId_Solid_Yellow);
-		AddPlane({ 0.f,10.f,0.f }, { 0.f,-1.f,0.f }, matId_Solid_Yellow);
-		AddPlane({ 0.f,0.f,10.f }, { 0.f,0.f,-1.f }, matId_Solid_Magenta);
-
-		////Spheres
-		AddSphere({ -1.75f,1.f,0.f }, .75f, matId_Solid_Red);
-		AddSphere({ 0.f,1.f,0.f }, .75f, matId_Solid_Blue);
-		AddSphere({ 1.75f,1.f,0.f }, .75f, matId_Solid_Red);
-		AddSphere({ -1.75f,3.f,0.f }, .75f, matId_Solid_Blue);
-		AddSphere({ 0.f,3.f,0.f }, .75f, matId_Solid_Red);
-		AddSphere({ 1.75f,3.f,0.f }, .75f, matId_Solid_Blue);
-
-		////Light
-		AddPointLight({ 0.f,5.f,-5.f }, 70.f, colors::White);
+		//A load that started can not be interrupted, the ones no thread picked up yet are skipped
+		m_NextMeshAsset = m_MeshAssets.size();
+		for (std::thread& thread : m_LoadThreads)
+			thread.join();
 	}
-#pragma endregion
 
-#pragma region SCENE W3
-	void Scene_W3::Initialize()
+	void Scene_File::Initialize()
 	{
-		m_Camera.origin = {0.f,3.f,-9.f};
-		m_Camera.fovAngle = 45.f;
-
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f,.960f,.915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f,.960f,.915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f,.960f,.915f }, 1.f, .1f));
-
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f,.75f,.75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f,.75f,.75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f,.75f,.75f }, .0f, .1f));
-
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f,.57f,.57f }, 1.f));
+		m_LoadStart = std::chrono::steady_clock::now();
+
+		m_Camera.origin = m_Description.camera.origin;
+		m_Camera.fovAngle = m_Description.camera.fovAngle;
+		m_Camera.totalPitch = m_Description.camera.pitch;
+		m_Camera.totalYaw = m_Description.camera.yaw;
+
+		//Everything gets added up front or between frames, no container grows (or moves its elements) while the scene is built
+		size_t numInstances{};
+		for (const MeshDescription& mesh : m_Description.meshes)
+			numInstances += mesh.filePath.empty() && mesh.animation == MeshAnimationType::None ? 0 : 1;
+
+		m_Materials.reserve(m_Materials.size() + m_Description.materials.size());
+		m_PlaneGeometries.reserve(m_Description.planes.size());
+		m_Spheres.Reserve(static_cast<uint32_t>(m_Description.spheres.size()));
+		m_TriangleMeshGeometries.reserve(m_Description.meshes.size() - numInstances);
+		m_TriangleMeshInstances.reserve(numInstances);
+		m_Lights.reserve(m_Description.lights.size());
+
+		//The OBJ files are the slow part, they load while the rest gets added and the first frames render
+		StartMeshLoads();
+
+		//Materials
+		for (const MaterialDescription& material : m_Description.materials)
+		{
+			const float* p{ material.parameters };
+			switch (material.type)
+			{
+			case MaterialType::SolidColor:
+				AddMaterial(new Material_SolidColor{ material.color });
+				break;
+			case MaterialType::Lambert:
+				AddMaterial(new Material_Lambert{ material.color, p[0] });
+				break;
+			case MaterialType::LambertPhong:
+				AddMaterial(new Material_LambertPhong{ material.color, p[0], p[1], p[2] });
+				break;
+			case MaterialType::CookTorrence:
+				AddMaterial(new Material_CookTorrence{ material.color, p[0], p[1] });
+				break;
+			}
+		}
 
 		//Plane
-		AddPlane({ .0f,.0f,10.0f }, { 0.f,0.f,-1.f }, matLambert_GrayBlue); //Back
-		AddPlane({ .0f,.0f,0.0f }, { 0.f,1.f,0.f }, matLambert_GrayBlue); //Bottom
-		AddPlane({ .0f,10.0f,10.0f }, { 0.f,-1.f,0.f }, matLambert_GrayBlue); //Top
-		AddPlane({ 5.0f,.0f,.0f }, { -1.f,0.f,0.f }, matLambert_GrayBlue); //Right
-		AddPlane({ -5.0f,.0f,.0f }, { 1.f,0.f,0.f }, matLambert_GrayBlue); //Left
+		for (const PlaneDescription& plane : m_Description.planes)
+			AddPlane(plane.origin, plane.normal, static_cast<unsigned char>(plane.materialIndex));
 
 		//Spheres
-		//bottom row
-		AddSphere({ -1.75f,1.f,.0f }, .75f, matCT_GrayRoughMetal);
-		AddSphere({ .0f,1.f,.0f }, .75f, matCT_GrayMediumMetal);
-		AddSphere({ 1.75f,1.f,.0f }, .75f, matCT_GraySmoothMetal);
-		//top row
-		AddSphere({ -1.75f,3.f,.0f }, .75f, matCT_GrayRoughPlastic);
-		AddSphere({ 0.f,3.f,.0f }, .75f, matCT_GrayMediumPlastic);
-		AddSphere({ 1.75f,3.f,.0f }, .75f, matCT_GraySmoothPlastic);
+		for (const SphereDescription& sphere : m_Description.spheres)
+			AddSphere(sphere.origin, sphere.radius, static_cast<unsigned char>(sphere.materialIndex));
+
+		//Inline meshes, only a handful of triangles
+		for (uint32_t i{ 0 }; i < m_Description.meshes.size(); ++i)
+		{
+			const MeshDescription& description = m_Description.meshes[i];
+			if (!description.filePath.empty())
+				continue;
+
+			//Animated ones stay in object space as an instance: a frame only updates the matrix, not every vertex, the BVH and the triangle blocks
+			if (description.animation != MeshAnimationType::None)
+			{
+				const auto pGeometry = std::make_shared<TriangleMeshGeometry>();
+				pGeometry->positions = description.positions;
+				pGeometry->indices = description.indices;
+				pGeometry->Build();
+				AddMeshInstance(pGeometry, i);
+				continue;
+			}
+
+			TriangleMesh* pMesh = AddTriangleMesh(description.cullMode, static_cast<unsigned char>(description.materialIndex));
+			pMesh->positions = description.positions;
+			pMesh->indices = description.indices;
+			pMesh->CalculateNormals();
+			pMesh->Translate(description.translation);
+			pMesh->RotateY(description.yaw);
+			pMesh->Scale(description.scale);
+			pMesh->UpdateAABB();
+			pMesh->UpdateTransforms();
+		}
 
 		//Light
-		AddPointLight({ 0.f,5.f,5.f }, 50.f, { 1.f,.61f,.45f }); // Back Light
-		AddPointLight({ -2.5f,5.f,-5.f }, 70.f, { 1.f,.8f,.45f }); // Front Light Left
-		AddPointLight({ 2.5f,2.5f,-5.f }, 50.f, { .34f,.47f,.68f });
-	}
-#pragma endregion
+		for (const LightDescription& light : m_Description.lights)
+		{
+			if (light.type == LightType::Point)
+				AddPointLight(light.originOrDirection, light.intensity, light.color);
+			else
+				AddDirectionalLight(light.originOrDirection, light.intensity, light.color);
+		}
 
-#pragma region SCENE W4
-	void Scene_W4::Initialize()
-	{
-		m_Camera.origin = { 0.f,1.f,-5.f };
-		m_Camera.fovAngle = 45.f;
-
-
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f,.57f,.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
-
-		////Plane
-		AddPlane({ .0f,.0f,10.0f }, { 0.f,0.f,-1.f }, matLambert_GrayBlue); //Back
-		AddPlane({ .0f,.0f,0.0f }, { 0.f,1.f,0.f }, matLambert_GrayBlue); //Bottom
-		AddPlane({ .0f,10.0f,0.0f }, { 0.f,-1.f,0.f }, matLambert_GrayBlue); //Top
-		AddPlane({ 5.0f,.0f,.0f }, { -1.f,0.f,0.f }, matLambert_GrayBlue); //Right
-		AddPlane({ -5.0f,.0f,.0f }, { 1.f,0.f,0.f }, matLambert_GrayBlue); //Left
-		
-		//Triangle Mesh 2
-		pMesh = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		pMesh->positions = {
-			{-.75f,-1.f,.0f},   // V0
-			{-.75f, 1.f, .0f},  // V1
-			{.75f, 1.f, 1.f},    // V2
-			{.75f, -1.f, 0.f} }; // V4
-
-		pMesh->indices = {
-			0,1,2,
-			0,2,3
-			};
-
-		pMesh->CalculateNormals();
-		pMesh->Translate({ .0f,1.5f,.0f });
-		pMesh->RotateY(45);
-		pMesh->UpdateTransforms();
-		
-
-		
-		//pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		//Utils::ParseOBJ("Resources/simple_cube.obj",
-		//	pMesh->positions,
-		//	pMesh->normals,
-		//	pMesh->indices);
-
-		////No need to calculate the normals, these are calculated inside the ParseOBJ function
-		//pMesh->UpdateTransforms();
-
-		//pMesh->Scale({ .7f,.7f,.7f });
-		//pMesh->Translate({ .0f,1.f,0.f });
-		
+		std::cout << "Scene " << sceneName << " ready in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_LoadStart).count() << " ms";
+		if (m_NumPendingMeshAssets > 0)
+			std::cout << ", loading " << m_NumPendingMeshAssets << " mesh(es) in the background";
+		std::cout << std::endl;
 
-		//Light
-		AddPointLight({ 0.f,5.f,5.f }, 50.f, { 1.f,.61f,.45f });
-		AddPointLight({ -2.5f,5.f,-5.f }, 70.f, { 1.f,.8f,.45f });
-		AddPointLight({ 2.5f,2.5f,-5.f }, 50.f, { .34f,.47f,.68f });
+		//Whatever finished in the meantime is there from the first frame on
+		PublishMeshAssets();
 	}
 
-	/*void Scene_W4::Update(Timer* pTimer)
+	void Scene_File::StartMeshLoads()
 	{
-		Scene::Update(pTimer);
+		//Meshes sharing a file share its geometry, every file gets loaded once
+		std::vector<std::string> paths{};
+		m_MeshAssetIndices.assign(m_Description.meshes.size(), SIZE_MAX);
+		for (size_t i{ 0 }; i < m_Description.meshes.size(); ++i)
+		{
+			const std::string& filePath{ m_Description.meshes[i].filePath };
+			if (filePath.empty())
+				continue;
+
+			const std::string path{ (std::filesystem::path(m_Directory) / filePath).lexically_normal().string() };
+			const auto it = std::find(paths.begin(), paths.end(), path);
+			m_MeshAssetIndices[i] = static_cast<size_t>(it - paths.begin());
+			if (it == paths.end())
+				paths.push_back(path);
+		}
 
-		pMesh->RotateY(PI_DIV_2 * pTimer->GetTotal());
-		pMesh->UpdateTransforms();
-	}*/
-#pragma endregion
+		//Sized once, the atomics can not move
+		m_MeshAssets = std::vector<MeshAsset>(paths.size());
+		for (size_t i{ 0 }; i < paths.size(); ++i)
+			m_MeshAssets[i].path = std::move(paths[i]);
+		m_NumPendingMeshAssets = m_MeshAssets.size();
+
+		//One file per thread at a time, the render threads keep the other hardware threads busy as well so never more than half of them
+		const size_t numThreads{ std::min<size_t>(m_MeshAssets.size(), std::max(std::thread::hardware_concurrency() / 2, 1u)) };
+		m_LoadThreads.reserve(numThreads);
+		for (size_t i{ 0 }; i < numThreads; ++i)
+			m_LoadThreads.emplace_back(&Scene_File::LoadMeshAssets, this);
+	}
 
-#pragma region SCENE W4 REFERENCE SCENE
-	void Scene_W4_ReferenceScene::Initialize()
+	void Scene_File::LoadMeshAssets()
 	{
-		m_Camera.origin = { 0.f,3.f,-9.f };
-		m_Camera.fovAngle = 45.f;
+		//No TRACE_ZONE: the trace buffers may only be written while a frame is in flight, these threads run across frames
+		for (size_t i{ m_NextMeshAsset++ }; i < m_MeshAssets.size(); i = m_NextMeshAsset++)
+		{
+			MeshAsset& asset = m_MeshAssets[i];
+			const auto start = std::chrono::steady_clock::now();
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f,.960f,.915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f,.960f,.915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f,.960f,.915f }, 1.f, .1f));
+			//Parse (or cache hit), normals and BVH, all of it before the scene can see the geometry
+			//Content already loaded by this or another scene is shared instead
+			asset.pGeometry = AcquireMeshGeometry(asset.path);
+			asset.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f,.75f,.75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f,.75f,.75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f,.75f,.75f }, .0f, .1f));
+			asset.state.store(asset.pGeometry ? MeshAssetState::Loaded : MeshAssetState::Failed, std::memory_order_release);
+		}
+	}
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f,.57f,.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+	void Scene_File::PublishMeshAssets()
+	{
+		if (m_NumPendingMeshAssets == 0)
+			return;
 
-		//Plane
-		AddPlane({ .0f,.0f,10.0f }, { 0.f,0.f,-1.f }, matLambert_GrayBlue); //Back
-		AddPlane({ .0f,.0f,0.0f }, { 0.f,1.f,0.f }, matLambert_GrayBlue); //Bottom
-		AddPlane({ .0f,10.0f,0.0f }, { 0.f,-1.f,0.f }, matLambert_GrayBlue); //Top
-		AddPlane({ 5.0f,.0f,.0f }, { -1.f,0.f,0.f }, matLambert_GrayBlue); //Right
-		AddPlane({ -5.0f,.0f,.0f }, { 1.f,0.f,0.f }, matLambert_GrayBlue); //Left
+		for (size_t assetIndex{ 0 }; assetIndex < m_MeshAssets.size(); ++assetIndex)
+		{
+			MeshAsset& asset = m_MeshAssets[assetIndex];
+			const MeshAssetState state{ asset.state.load(std::memory_order_acquire) };
+			if (asset.isPublished || state == MeshAssetState::Loading)
+				continue;
+
+			asset.isPublished = true;
+			--m_NumPendingMeshAssets;
+			if (state == MeshAssetState::Failed)
+				continue;
+
+			std::cout << "  " << asset.path << ": " << asset.milliseconds << " ms" << std::endl;
+
+			//Instanced: the geometry stays in object space and is shared by every mesh using the file, animating it only changes the matrix
+			for (uint32_t i{ 0 }; i < m_Description.meshes.size(); ++i)
+			{
+				if (m_MeshAssetIndices[i] == assetIndex)
+					AddMeshInstance(asset.pGeometry, i);
+			}
+		}
 
-		//Spheres
-		//bottom row
-		AddSphere({ -1.75f,1.f,.0f }, .75f, matCT_GrayRoughMetal);
-		AddSphere({ .0f,1.f,.0f }, .75f, matCT_GrayMediumMetal);
-		AddSphere({ 1.75f,1.f,.0f }, .75f, matCT_GraySmoothMetal);
-		//top row
-		AddSphere({ -1.75f,3.f,.0f }, .75f, matCT_GrayRoughPlastic);
-		AddSphere({ 0.f,3.f,.0f }, .75f, matCT_GrayMediumPlastic);
-		AddSphere({ 1.75f,3.f,.0f }, .75f, matCT_GraySmoothPlastic);
-
-		const Triangle baseTriangle = { Vector3(-.75f,1.5f,0.f),Vector3(.75f,0.f,0.f),Vector3(-.75f,0.f,0.f) };
-
-		m_Meshes[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		m_Meshes[0]->AppendTriangle(baseTriangle, true);
-		m_Meshes[0]->Translate({ -1.75f,4.5f,0.f });
-		m_Meshes[0]->UpdateAABB();
-		m_Meshes[0]->UpdateTransforms();
-
-		m_Meshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		m_Meshes[1]->AppendTriangle(baseTriangle, true);
-		m_Meshes[1]->Translate({ 0.f,4.5f,0.f });
-		m_Meshes[1]->UpdateAABB();
-		m_Meshes[1]->UpdateTransforms();
-
-		m_Meshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		m_Meshes[2]->AppendTriangle(baseTriangle, true);
-		m_Meshes[2]->Translate({ 1.75f,4.5f,0.f });
-		m_Meshes[2]->UpdateAABB();
-		m_Meshes[2]->UpdateTransforms();
+		if (m_NumPendingMeshAssets == 0)
+		{
+			const MeshGeometryCacheStats cacheStats{ GetMeshGeometryCacheStats() };
+			std::cout << "Scene " << sceneName << " fully loaded after "
+				<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_LoadStart).count() << " ms ("
+				<< cacheStats.numGeometries << " unique mesh(es) in memory, " << static_cast<double>(cacheStats.numBytes) / (1024.0 * 1024.0) << " MB, "
+				<< cacheStats.numHits << " shared load(s))" << std::endl;
+		}
+	}
+
+	void Scene_File::AddMeshInstance(const std::shared_ptr<const TriangleMeshGeometry>& pGeometry, uint32_t descriptionIndex)
+	{
+		const MeshDescription& description = m_Description.meshes[descriptionIndex];
+		TriangleMeshInstance* pInstance = AddTriangleMeshInstance(pGeometry, description.cullMode, static_cast<unsigned char>(description.materialIndex));
+		pInstance->Translate(description.translation);
+		pInstance->RotateY(description.yaw);
+		pInstance->Scale(description.scale);
+		pInstance->UpdateTransforms();
+
+		if (description.animation != MeshAnimationType::None)
+			m_AnimatedMeshes.push_back({ static_cast<uint32_t>(m_TriangleMeshInstances.size() - 1), descriptionIndex });
+	}
 
+	void Scene_File::WaitUntilLoaded()
+	{
+		for (std::thread& thread : m_LoadThreads)
+			thread.join();
+		m_LoadThreads.clear();
 
-		//Light
-		AddPointLight({ 0.f,5.f,5.f }, 50.f, { 1.f,.61f,.45f });
-		AddPointLight({ -2.5f,5.f,-5.f }, 70.f, { 1.f,.8f,.45f });
-		AddPointLight({ 2.5f,2.5f,-5.f }, 50.f, { .34f,.47f,.68f });
+		PublishMeshAssets();
 	}
 
-	void Scene_W4_ReferenceScene::Update(Timer* pTimer)
+	void Scene_File::Update(Timer* pTimer)
 	{
 		Scene::Update(pTimer);
+		PublishMeshAssets();
 
-		const auto yawAngle = (cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2;
-		for (const auto m : m_Meshes)
+		const float totalTime{ pTimer->GetTotal() };
+		for (const AnimatedMesh& animatedMesh : m_AnimatedMeshes)
 		{
-			m->RotateY(yawAngle);
-			m->UpdateTransforms();
+			const MeshDescription& description = m_Description.meshes[animatedMesh.descriptionIndex];
+			const float* p{ description.animationParameters };
+
+			float yawAngle{ description.yaw };
+			if (description.animation == MeshAnimationType::Spin)
+				yawAngle += p[0] * totalTime;
+			else
+				yawAngle += p[0] + (p[1] - p[0]) * (1.f - cosf(p[2] * totalTime)) * .5f;
+
+			m_TriangleMeshInstances[animatedMesh.instanceIndex].RotateY(yawAngle);
 		}
 	}
-#pragma endregion
 
-#pragma region SCENE W4 BUNNY SCENE
-	void Scene_W4_BunnyScene::Initialize()
+	void Scene_File::UpdateTransforms()
 	{
-		m_Camera.origin = { 0.f,3.f,-9.f };
-		m_Camera.fovAngle = 45.f;
-
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f,.57f,.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
-
-		//Plane
-		AddPlane({ .0f,.0f,10.0f }, { 0.f,0.f,-1.f }, matLambert_GrayBlue); //Back
-		AddPlane({ .0f,.0f,0.0f }, { 0.f,1.f,0.f }, matLambert_GrayBlue);   //Bottom
-		AddPlane({ .0f,10.0f,0.0f }, { 0.f,-1.f,0.f }, matLambert_GrayBlue); //Top
-		AddPlane({ 5.0f,.0f,.0f }, { -1.f,0.f,0.f }, matLambert_GrayBlue);   //Right
-		AddPlane({ -5.0f,.0f,.0f }, { 1.f,0.f,0.f }, matLambert_GrayBlue);   //Left
+		//O(1) per mesh, nothing depends on the vertex count
+		for (const AnimatedMesh& animatedMesh : m_AnimatedMeshes)
+			m_TriangleMeshInstances[animatedMesh.instanceIndex].UpdateTransforms();
+	}
+#pragma endregion
 
-		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/lowpoly_bunny.obj",
-			pMesh->positions,
-			pMesh->normals,
-			pMesh->indices);
+#pragma region SCENE FACTORY
+	std::unique_ptr<Scene> CreateScene(const std::string& name)
+	{
+		const std::filesystem::path path{ GetSceneFilePath(name) };
 
-		//No need to calculate the normals, these are calculated inside the ParseOBJ function
+		SceneDescription description{};
+		if (!LoadSceneDescription(path.string(), description))
+			return nullptr;
 
-		pMesh->Scale({ 2.f,2.f,2.f });
-	
-		pMesh->UpdateAABB();
+		return std::make_unique<Scene_File>(path.stem().string(), std::move(description), path.parent_path().string());
+	}
 
-		pMesh->UpdateTransforms();
+	std::string GetSceneFilePath(const std::string& name)
+	{
+		//A path to a scene file or the name of one in Resources/Scenes
+		const std::filesystem::path extension{ std::filesystem::path(name).extension() };
+		if (extension == ".scene" || extension == ".sceneb")
+			return name;
 
-		//Light
-		AddPointLight({ 0.f,5.f,5.f }, 50.f, { 1.f,.61f,.45f });
-		AddPointLight({ -2.5f,5.f,-5.f }, 70.f, { 1.f,.8f,.45f });
-		AddPointLight({ 2.5f,2.5f,-5.f }, 50.f, { .34f,.47f,.68f });
+		return (std::filesystem::path("Resources/Scenes") / (name + ".scene")).string();
 	}
 
-	void Scene_W4_BunnyScene::Update(Timer* pTimer)
+	const std::vector<std::string>& GetSceneNames()
 	{
-		Scene::Update(pTimer);
-
-		pMesh->RotateY(PI_DIV_2 * pTimer->GetTotal());
-		pMesh->UpdateTransforms();
+		static const std::vector<std::string> sceneNames{ "W1", "W2", "W3", "W4", "W4_Reference", "W4_Bunny" };
+		return sceneNames;
 	}
 #pragma endregion
 }
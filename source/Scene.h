@@ -1,10 +1,15 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "SceneDescription.h"
 
 namespace dae
 {
@@ -32,13 +37,28 @@ namespace dae
 		{
 			m_Camera.Update(pTimer);
 		}
+		//Applies the transforms set in Update to the geometry, the renderer calls it right before UpdateTopLevelBVH
+		virtual void UpdateTransforms() {}
+
+		//Scenes that stream their assets keep loading after Initialize, the geometry shows up in the Update after it is ready
+		virtual bool IsLoading() const { return false; }
+		//Blocks until every asset is loaded and part of the scene, call it on the thread that updates and renders the scene
+		virtual void WaitUntilLoaded() {}
 
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
+		//Traces the lanes in laneMask as one packet, closestHits holds one record per lane
+		void GetClosestHits(RayPacket& packet, uint32_t laneMask, HitRecord* closestHits) const;
 		bool DoesHit(const Ray& ray) const;
+		//Tests lastOccluder first and stores whatever blocked the ray in it, neighbouring shadow rays towards the same light mostly hit the same primitive
+		bool DoesHit(const Ray& ray, Occluder& lastOccluder) const;
+
+		//Refits the sphere BVH and the top level BVH to the current sphere/mesh bounds (rebuilds when objects were added or the tree degraded)
+		//Call after the scene updated its transforms
+		void UpdateTopLevelBVH();
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
-		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
+		const SphereSet& GetSpheres() const { return m_Spheres; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
 		const std::vector<Material*> GetMaterials() const { return m_Materials; }
 
@@ -46,16 +66,26 @@ namespace dae
 		std::string	sceneName;
 
 		std::vector<Plane> m_PlaneGeometries{};
-		std::vector<Sphere> m_SphereGeometries{};
+		SphereSet m_Spheres{};
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
+		std::vector<TriangleMeshInstance> m_TriangleMeshInstances{};
 		std::vector<Light> m_Lights{};
 		std::vector<Material*> m_Materials{};
 
 		Camera m_Camera{};
 
-		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
+		//Top level BVH over all meshes, planes are unbounded and spheres have their own BVH, both get tested separately
+		//Primitive indices: [0, #meshes) triangle meshes, then #instances triangle mesh instances
+		BVH m_TopLevelBVH{};
+		float m_TopLevelBVHRebuildThreshold{ 1.5f };
+
+		bool IsOccludedBy(const Occluder& occluder, const Ray& ray) const;
+
+		//Returns the index of the sphere in m_Spheres, use it to move the sphere later on
+		uint32_t AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		TriangleMeshInstance* AddTriangleMeshInstance(const std::shared_ptr<const TriangleMeshGeometry>& pGeometry, TriangleCullMode cullMode, unsigned char materialIndex = 0);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
@@ -63,110 +93,77 @@ namespace dae
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
-	//WEEK 1 Test Scene
-	class Scene_W1 final : public Scene
+	//Scene File
+	//Built from a SceneDescription: geometry, materials, lights and camera come from the file, animated meshes get their yaw every Update
+	class Scene_File final : public Scene
 	{
 	public:
-		Scene_W1() = default;
-		~Scene_W1() override = default;
+		//OBJ paths in the description are relative to directory (the one of the scene file)
+		Scene_File(std::string name, SceneDescription description, std::string directory);
+		//Waits for the loads that already started, the queued ones are dropped
+		~Scene_File() override;
 
-		Scene_W1(const Scene_W1&) = delete;
-		Scene_W1(Scene_W1&&) noexcept = delete;
-		Scene_W1& operator=(const Scene_W1&) = delete;
-		Scene_W1& operator=(Scene_W1&&) noexcept = delete;
+		Scene_File(const Scene_File&) = delete;
+		Scene_File(Scene_File&&) noexcept = delete;
+		Scene_File& operator=(const Scene_File&) = delete;
+		Scene_File& operator=(Scene_File&&) noexcept = delete;
 
+		//Adds everything but the OBJ meshes and starts loading those in the background, the first frame does not wait for them
 		void Initialize() override;
-	};
-
-	//+++++++++++++++++++++++++++++++++++++++++
-	//WEEK 2 Test Scene
-	class Scene_W2 final : public Scene
-	{
-	public:
-		Scene_W2() = default;
-		~Scene_W2() override = default;
-
-		Scene_W2(const Scene_W2&) = delete;
-		Scene_W2(Scene_W2&&) noexcept = delete;
-		Scene_W2& operator=(const Scene_W2&) = delete;
-		Scene_W2& operator=(Scene_W2&&) noexcept = delete;
-
-		void Initialize() override;
-	};
-
-	//+++++++++++++++++++++++++++++++++++++++++
-	//WEEK 3 Test Scene
-	class Scene_W3 final : public Scene
-	{
-	public:
-		Scene_W3() = default;
-		~Scene_W3() override = default;
-
-		Scene_W3(const Scene_W3&) = delete;
-		Scene_W3(Scene_W3&&) noexcept = delete;
-		Scene_W3& operator=(const Scene_W3&) = delete;
-		Scene_W3& operator=(Scene_W3&&) noexcept = delete;
-
-		void Initialize() override;
-	};
-
-	//+++++++++++++++++++++++++++++++++++++++++
-	//WEEK 4 Test Scene
-	class Scene_W4 final : public Scene
-	{
-	public:
-		Scene_W4() = default;
-		~Scene_W4() override = default;
-
-		Scene_W4(const Scene_W4&) = delete;
-		Scene_W4(Scene_W4&&) noexcept = delete;
-		Scene_W4& operator=(const Scene_W4&) = delete;
-		Scene_W4& operator=(Scene_W4&&) noexcept = delete;
+		void Update(Timer* pTimer) override;
+		void UpdateTransforms() override;
 
-		void Initialize() override;
-		//void Update(Timer* pTimer) override;
+		bool IsLoading() const override { return m_NumPendingMeshAssets > 0; }
+		void WaitUntilLoaded() override;
 
 	private:
-		TriangleMesh* pMesh{ nullptr };
-	};
-
-	//+++++++++++++++++++++++++++++++++++++++++
-	//WEEK 4 Reference Scene
-	class Scene_W4_ReferenceScene final : public Scene
-	{
-	public:
-		Scene_W4_ReferenceScene() = default;
-		~Scene_W4_ReferenceScene() override = default;
-
-		Scene_W4_ReferenceScene(const Scene_W4_ReferenceScene&) = delete;
-		Scene_W4_ReferenceScene(Scene_W4_ReferenceScene&&) noexcept = delete;
-		Scene_W4_ReferenceScene& operator=(const Scene_W4_ReferenceScene&) = delete;
-		Scene_W4_ReferenceScene& operator=(Scene_W4_ReferenceScene&&) noexcept = delete;
+		//Animated meshes are always instances (inline ones included), so a frame only touches their matrices
+		struct AnimatedMesh
+		{
+			uint32_t instanceIndex{};
+			uint32_t descriptionIndex{};
+		};
 
-		void Initialize() override;
-		void Update(Timer* pTimer) override;
+		enum class MeshAssetState : uint8_t
+		{
+			Loading,
+			Loaded,
+			Failed
+		};
 
-	private:
-		TriangleMesh* m_Meshes[3]{};
+		//One per unique OBJ file, a loader thread owns the geometry until it sets the state (release), the main thread only reads it after seeing that (acquire)
+		struct MeshAsset
+		{
+			std::string path{};
+			std::shared_ptr<const TriangleMeshGeometry> pGeometry{};
+			double milliseconds{};
+			std::atomic<MeshAssetState> state{ MeshAssetState::Loading };
+			bool isPublished{}; //main thread only
+		};
+
+		SceneDescription m_Description;
+		std::string m_Directory;
+		std::vector<AnimatedMesh> m_AnimatedMeshes{};
+
+		std::vector<MeshAsset> m_MeshAssets{};
+		std::vector<size_t> m_MeshAssetIndices{}; //per mesh of the description, SIZE_MAX for inline meshes
+		std::atomic<size_t> m_NextMeshAsset{ 0 };
+		std::vector<std::thread> m_LoadThreads{};
+		size_t m_NumPendingMeshAssets{};
+		std::chrono::steady_clock::time_point m_LoadStart{};
+
+		void StartMeshLoads();
+		void LoadMeshAssets();
+		//Adds the instances of every asset that finished loading since the last call, between two frames so the renderer never sees a half added mesh
+		void PublishMeshAssets();
+		void AddMeshInstance(const std::shared_ptr<const TriangleMeshGeometry>& pGeometry, uint32_t descriptionIndex);
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
-	//WEEK 4 Bunny Scene
-	class Scene_W4_BunnyScene final : public Scene
-	{
-	public:
-		Scene_W4_BunnyScene() = default;
-		~Scene_W4_BunnyScene() override = default;
-
-		Scene_W4_BunnyScene(const Scene_W4_BunnyScene&) = delete;
-		Scene_W4_BunnyScene(Scene_W4_BunnyScene&&) noexcept = delete;
-		Scene_W4_BunnyScene& operator=(const Scene_W4_BunnyScene&) = delete;
-		Scene_W4_BunnyScene& operator=(Scene_W4_BunnyScene&&) noexcept = delete;
-
-		void Initialize() override;
-		void Update(Timer* pTimer) override;
-
-	private:
-		TriangleMesh* pMesh{ nullptr };
-	};
+	//Scene Factory
+	//Names: a scene in Resources/Scenes ("W1", "W2", "W3", "W4", "W4_Reference", "W4_Bunny") or the path of a .scene/.sceneb file
+	//Returns nullptr when the scene can not be loaded, the scene is not initialized yet
+	std::unique_ptr<Scene> CreateScene(const std::string& name);
+	std::string GetSceneFilePath(const std::string& name);
+	const std::vector<std::string>& GetSceneNames();
 }
\ No newline at end of file
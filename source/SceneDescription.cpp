@@ -0,0 +1,514 @@
+#include "SceneDescription.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <type_traits>
+
+#include "MappedFile.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Bump whenever a description struct changes
+		constexpr uint32_t SceneBinaryVersion{ 1 };
+		constexpr char SceneBinaryMagic[8]{ 'D', 'A', 'E', 'S', 'C', 'E', 'N', 'E' };
+
+		static_assert(std::is_trivially_copyable_v<CameraDescription> && std::is_trivially_copyable_v<PlaneDescription>
+			&& std::is_trivially_copyable_v<SphereDescription> && std::is_trivially_copyable_v<LightDescription>);
+
+#pragma region Text
+		bool Read(std::istream& stream, Vector3& value)
+		{
+			return static_cast<bool>(stream >> value.x >> value.y >> value.z);
+		}
+
+		bool Read(std::istream& stream, ColorRGB& value)
+		{
+			return static_cast<bool>(stream >> value.r >> value.g >> value.b);
+		}
+
+		bool IsAtLineEnd(std::istream& stream)
+		{
+			return (stream >> std::ws).eof();
+		}
+
+		bool ReadCullMode(std::istream& stream, TriangleCullMode& cullMode)
+		{
+			std::string name{};
+			stream >> name;
+
+			if (name == "backface")
+				cullMode = TriangleCullMode::BackFaceCulling;
+			else if (name == "frontface")
+				cullMode = TriangleCullMode::FrontFaceCulling;
+			else if (name == "none")
+				cullMode = TriangleCullMode::NoCulling;
+			else
+				return false;
+
+			return true;
+		}
+
+		bool ReadMaterialIndex(std::istream& stream, const SceneDescription& description, uint32_t& materialIndex)
+		{
+			std::string name{};
+			if (!(stream >> name))
+				return false;
+
+			if (name == "default")
+			{
+				materialIndex = 0;
+				return true;
+			}
+
+			const auto it = std::find_if(description.materials.begin(), description.materials.end(), [&name](const MaterialDescription& material) { return material.name == name; });
+			materialIndex = static_cast<uint32_t>(it - description.materials.begin()) + 1;
+			return it != description.materials.end();
+		}
+
+		MeshDescription* FindMesh(std::istream& stream, SceneDescription& description)
+		{
+			std::string name{};
+			stream >> name;
+
+			const auto it = std::find_if(description.meshes.begin(), description.meshes.end(), [&name](const MeshDescription& mesh) { return mesh.name == name; });
+			return it != description.meshes.end() ? &*it : nullptr;
+		}
+
+		bool ReadMaterial(std::istream& stream, SceneDescription& description)
+		{
+			MaterialDescription material{};
+			std::string type{};
+			if (!(stream >> material.name >> type) || material.name == "default" || !Read(stream, material.color))
+				return false;
+
+			bool isValid{ false };
+			if (type == "solid")
+			{
+				material.type = MaterialType::SolidColor;
+				isValid = true;
+			}
+			else if (type == "lambert")
+			{
+				material.type = MaterialType::Lambert;
+				isValid = static_cast<bool>(stream >> material.parameters[0]);
+			}
+			else if (type == "phong")
+			{
+				material.type = MaterialType::LambertPhong;
+				isValid = static_cast<bool>(stream >> material.parameters[0] >> material.parameters[1] >> material.parameters[2]);
+			}
+			else if (type == "cooktorrence")
+			{
+				material.type = MaterialType::CookTorrence;
+				isValid = static_cast<bool>(stream >> material.parameters[0] >> material.parameters[1]);
+			}
+
+			if (isValid)
+				description.materials.emplace_back(material);
+			return isValid;
+		}
+
+		bool ReadMesh(std::istream& stream, SceneDescription& description, bool& isInline)
+		{
+			MeshDescription mesh{};
+			if (!(stream >> mesh.name >> mesh.filePath) || !ReadCullMode(stream, mesh.cullMode) || !ReadMaterialIndex(stream, description, mesh.materialIndex))
+				return false;
+
+			isInline = mesh.filePath == "inline";
+			if (isInline)
+				mesh.filePath.clear();
+
+			description.meshes.emplace_back(std::move(mesh));
+			return true;
+		}
+
+		bool ReadAnimation(std::istream& stream, MeshDescription& mesh)
+		{
+			std::string type{};
+			stream >> type;
+
+			if (type == "spin")
+			{
+				mesh.animation = MeshAnimationType::Spin;
+				return static_cast<bool>(stream >> mesh.animationParameters[0]);
+			}
+
+			if (type == "swing")
+			{
+				mesh.animation = MeshAnimationType::Swing;
+				return static_cast<bool>(stream >> mesh.animationParameters[0] >> mesh.animationParameters[1] >> mesh.animationParameters[2]);
+			}
+
+			return false;
+		}
+
+		bool ReadLight(std::istream& stream, SceneDescription& description)
+		{
+			LightDescription light{};
+			std::string type{};
+			stream >> type;
+
+			if (type == "point")
+				light.type = LightType::Point;
+			else if (type == "directional")
+				light.type = LightType::Directional;
+			else
+				return false;
+
+			if (!Read(stream, light.originOrDirection) || !(stream >> light.intensity) || !Read(stream, light.color))
+				return false;
+
+			description.lights.emplace_back(light);
+			return true;
+		}
+
+		//Statements inside "mesh <name> inline ..." up to "end"
+		bool ReadInlineMeshStatement(const std::string& statement, std::istream& stream, MeshDescription& mesh, bool& isInline)
+		{
+			if (statement == "vertex")
+				return Read(stream, mesh.positions.emplace_back());
+
+			if (statement == "triangle")
+			{
+				int triangle[3]{};
+				if (!(stream >> triangle[0] >> triangle[1] >> triangle[2]))
+					return false;
+
+				mesh.indices.insert(mesh.indices.end(), std::begin(triangle), std::end(triangle));
+				return true;
+			}
+
+			if (statement == "end")
+			{
+				isInline = false;
+				return true;
+			}
+
+			return false;
+		}
+
+		bool ReadStatement(const std::string& statement, std::istream& stream, SceneDescription& description, bool& isInline)
+		{
+			if (statement == "camera")
+			{
+				CameraDescription& camera = description.camera;
+				if (!Read(stream, camera.origin) || !(stream >> camera.fovAngle))
+					return false;
+
+				//Pitch and yaw are optional
+				if (!IsAtLineEnd(stream))
+					return static_cast<bool>(stream >> camera.pitch >> camera.yaw);
+				return true;
+			}
+
+			if (statement == "material")
+				return ReadMaterial(stream, description);
+
+			if (statement == "plane")
+			{
+				PlaneDescription& plane = description.planes.emplace_back();
+				return Read(stream, plane.origin) && Read(stream, plane.normal) && ReadMaterialIndex(stream, description, plane.materialIndex);
+			}
+
+			if (statement == "sphere")
+			{
+				SphereDescription& sphere = description.spheres.emplace_back();
+				return Read(stream, sphere.origin) && stream >> sphere.radius && ReadMaterialIndex(stream, description, sphere.materialIndex);
+			}
+
+			if (statement == "mesh")
+				return ReadMesh(stream, description, isInline);
+
+			if (statement == "light")
+				return ReadLight(stream, description);
+
+			//Statements on a mesh defined earlier
+			if (statement != "translate" && statement != "rotate" && statement != "scale" && statement != "animate")
+				return false;
+
+			MeshDescription* pMesh{ FindMesh(stream, description) };
+			if (!pMesh)
+				return false;
+
+			if (statement == "translate")
+				return Read(stream, pMesh->translation);
+			if (statement == "rotate")
+				return static_cast<bool>(stream >> pMesh->yaw);
+			if (statement == "scale")
+				return Read(stream, pMesh->scale);
+
+			return ReadAnimation(stream, *pMesh);
+		}
+
+		bool LoadText(const std::string& filePath, SceneDescription& description)
+		{
+			std::ifstream file(filePath);
+			if (!file)
+			{
+				std::cout << "Could not open " << filePath << std::endl;
+				return false;
+			}
+
+			bool isInline{ false };
+			uint32_t lineNumber{ 0 };
+			std::string line{};
+			while (std::getline(file, line))
+			{
+				++lineNumber;
+
+				if (const size_t comment{ line.find('#') }; comment != std::string::npos)
+					line.erase(comment);
+
+				std::istringstream lineStream(line);
+				std::string statement{};
+				if (!(lineStream >> statement))
+					continue;
+
+				const bool isValid{ isInline
+					? ReadInlineMeshStatement(statement, lineStream, description.meshes.back(), isInline)
+					: ReadStatement(statement, lineStream, description, isInline) };
+
+				if (!isValid || !IsAtLineEnd(lineStream))
+				{
+					std::cout << filePath << '(' << lineNumber << "): invalid " << statement << " statement" << std::endl;
+					return false;
+				}
+			}
+
+			if (isInline)
+			{
+				std::cout << filePath << ": inline mesh " << description.meshes.back().name << " has no end" << std::endl;
+				return false;
+			}
+
+			return true;
+		}
+#pragma endregion
+
+#pragma region Binary
+		class BinaryWriter final
+		{
+		public:
+			explicit BinaryWriter(const std::string& filePath) : m_File{ filePath, std::ios::binary | std::ios::trunc } {}
+
+			bool IsValid() const { return static_cast<bool>(m_File); }
+
+			template<typename T>
+			void Write(const T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				m_File.write(reinterpret_cast<const char*>(&value), sizeof(T));
+			}
+
+			template<typename T>
+			void WriteArray(const std::vector<T>& values)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				Write(static_cast<uint32_t>(values.size()));
+				m_File.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+			}
+
+			void WriteString(const std::string& value)
+			{
+				Write(static_cast<uint32_t>(value.size()));
+				m_File.write(value.data(), static_cast<std::streamsize>(value.size()));
+			}
+
+		private:
+			std::ofstream m_File;
+		};
+
+		//Every read is bounds checked, a truncated file fails instead of reading past the mapping
+		class BinaryReader final
+		{
+		public:
+			BinaryReader(const char* pData, size_t size) : m_pData{ pData }, m_Size{ size } {}
+
+			template<typename T>
+			bool Read(T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				return ReadBytes(&value, sizeof(T));
+			}
+
+			template<typename T>
+			bool ReadArray(std::vector<T>& values)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				uint32_t count{};
+				if (!Read(count) || count > (m_Size - m_Offset) / sizeof(T))
+					return false;
+
+				values.resize(count);
+				return ReadBytes(values.data(), count * sizeof(T));
+			}
+
+			bool ReadString(std::string& value)
+			{
+				uint32_t length{};
+				if (!Read(length) || length > m_Size - m_Offset)
+					return false;
+
+				value.assign(m_pData + m_Offset, length);
+				m_Offset += length;
+				return true;
+			}
+
+			bool IsAtEnd() const { return m_Offset == m_Size; }
+
+		private:
+			const char* m_pData;
+			size_t m_Size;
+			size_t m_Offset{ 0 };
+
+			bool ReadBytes(void* pDestination, size_t size)
+			{
+				if (size > m_Size - m_Offset)
+					return false;
+
+				if (size > 0)
+					std::memcpy(pDestination, m_pData + m_Offset, size);
+				m_Offset += size;
+				return true;
+			}
+		};
+
+		bool ReadBinaryMaterial(BinaryReader& reader, MaterialDescription& material)
+		{
+			return reader.ReadString(material.name) && reader.Read(material.type) && reader.Read(material.color) && reader.Read(material.parameters)
+				&& material.type <= MaterialType::CookTorrence;
+		}
+
+		bool ReadBinaryMesh(BinaryReader& reader, MeshDescription& mesh)
+		{
+			return reader.ReadString(mesh.name) && reader.ReadString(mesh.filePath) && reader.ReadArray(mesh.positions) && reader.ReadArray(mesh.indices)
+				&& reader.Read(mesh.cullMode) && reader.Read(mesh.materialIndex) && reader.Read(mesh.translation) && reader.Read(mesh.yaw) && reader.Read(mesh.scale)
+				&& reader.Read(mesh.animation) && reader.Read(mesh.animationParameters)
+				&& mesh.cullMode <= TriangleCullMode::NoCulling && mesh.animation <= MeshAnimationType::Swing;
+		}
+
+		bool LoadBinary(const std::string& filePath, SceneDescription& description)
+		{
+			MappedFile file{};
+			if (!file.Open(filePath))
+			{
+				std::cout << "Could not open " << filePath << std::endl;
+				return false;
+			}
+
+			BinaryReader reader{ file.GetData(), file.GetSize() };
+			char magic[sizeof(SceneBinaryMagic)]{};
+			uint32_t version{};
+			bool isValid{ reader.Read(magic) && std::memcmp(magic, SceneBinaryMagic, sizeof(magic)) == 0 && reader.Read(version) && version == SceneBinaryVersion };
+
+			uint32_t numMaterials{};
+			isValid = isValid && reader.Read(description.camera) && reader.Read(numMaterials) && numMaterials <= file.GetSize();
+			if (isValid)
+			{
+				description.materials.resize(numMaterials);
+				for (MaterialDescription& material : description.materials)
+					isValid = isValid && ReadBinaryMaterial(reader, material);
+			}
+
+			uint32_t numMeshes{};
+			isValid = isValid && reader.ReadArray(description.planes) && reader.ReadArray(description.spheres) && reader.Read(numMeshes) && numMeshes <= file.GetSize();
+			if (isValid)
+			{
+				description.meshes.resize(numMeshes);
+				for (MeshDescription& mesh : description.meshes)
+					isValid = isValid && ReadBinaryMesh(reader, mesh);
+			}
+
+			isValid = isValid && reader.ReadArray(description.lights) && reader.IsAtEnd();
+			if (!isValid)
+				std::cout << filePath << " is not a valid binary scene (version " << SceneBinaryVersion << ")" << std::endl;
+
+			return isValid;
+		}
+#pragma endregion
+
+		//References between the parts, so building the scene never indexes out of bounds
+		bool Validate(const std::string& filePath, const SceneDescription& description)
+		{
+			const uint32_t numMaterials{ static_cast<uint32_t>(description.materials.size()) + 1 };
+			const auto isValidMaterial = [numMaterials](const auto& part) { return part.materialIndex < numMaterials; };
+
+			bool isValid{ numMaterials <= 256 };
+			isValid = isValid && std::all_of(description.planes.begin(), description.planes.end(), isValidMaterial);
+			isValid = isValid && std::all_of(description.spheres.begin(), description.spheres.end(), isValidMaterial);
+			isValid = isValid && std::all_of(description.meshes.begin(), description.meshes.end(), isValidMaterial);
+
+			for (const MeshDescription& mesh : description.meshes)
+			{
+				const int numPositions{ static_cast<int>(mesh.positions.size()) };
+				isValid = isValid && mesh.indices.size() % 3 == 0
+					&& std::all_of(mesh.indices.begin(), mesh.indices.end(), [numPositions](int index) { return index >= 0 && index < numPositions; });
+			}
+
+			if (!isValid)
+				std::cout << filePath << " references a material or vertex that does not exist" << std::endl;
+			return isValid;
+		}
+	}
+
+	bool LoadSceneDescription(const std::string& filePath, SceneDescription& description)
+	{
+		description = {};
+
+		const bool isBinary{ filePath.size() >= 7 && filePath.compare(filePath.size() - 7, 7, ".sceneb") == 0 };
+		if (!(isBinary ? LoadBinary(filePath, description) : LoadText(filePath, description)) || !Validate(filePath, description))
+		{
+			description = {};
+			return false;
+		}
+
+		return true;
+	}
+
+	bool SaveSceneDescriptionBinary(const std::string& filePath, const SceneDescription& description)
+	{
+		BinaryWriter writer{ filePath };
+		if (!writer.IsValid())
+			return false;
+
+		writer.Write(SceneBinaryMagic);
+		writer.Write(SceneBinaryVersion);
+		writer.Write(description.camera);
+
+		writer.Write(static_cast<uint32_t>(description.materials.size()));
+		for (const MaterialDescription& material : description.materials)
+		{
+			writer.WriteString(material.name);
+			writer.Write(material.type);
+			writer.Write(material.color);
+			writer.Write(material.parameters);
+		}
+
+		writer.WriteArray(description.planes);
+		writer.WriteArray(description.spheres);
+
+		writer.Write(static_cast<uint32_t>(description.meshes.size()));
+		for (const MeshDescription& mesh : description.meshes)
+		{
+			writer.WriteString(mesh.name);
+			writer.WriteString(mesh.filePath);
+			writer.WriteArray(mesh.positions);
+			writer.WriteArray(mesh.indices);
+			writer.Write(mesh.cullMode);
+			writer.Write(mesh.materialIndex);
+			writer.Write(mesh.translation);
+			writer.Write(mesh.yaw);
+			writer.Write(mesh.scale);
+			writer.Write(mesh.animation);
+			writer.Write(mesh.animationParameters);
+		}
+
+		writer.WriteArray(description.lights);
+		return writer.IsValid();
+	}
+}
@@ -0,0 +1,112 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	enum class MaterialType : uint8_t
+	{
+		SolidColor,
+		Lambert,
+		LambertPhong,
+		CookTorrence
+	};
+
+	struct MaterialDescription
+	{
+		std::string name{};
+		MaterialType type{};
+		ColorRGB color{};
+		//Lambert: reflectance, LambertPhong: kd, ks, exponent, CookTorrence: metalness, roughness
+		float parameters[3]{};
+	};
+
+	//Material indices below: 0 is the default material every Scene starts with (solid red), the described ones follow from 1
+	struct PlaneDescription
+	{
+		Vector3 origin{};
+		Vector3 normal{};
+		uint32_t materialIndex{};
+	};
+
+	struct SphereDescription
+	{
+		Vector3 origin{};
+		float radius{};
+		uint32_t materialIndex{};
+	};
+
+	enum class MeshAnimationType : uint8_t
+	{
+		None,
+		Spin, //yaw = parameters[0] * time
+		Swing //yaw from parameters[0] to parameters[1] and back, (1 - cos(parameters[2] * time)) / 2 of the way
+	};
+
+	struct MeshDescription
+	{
+		std::string name{};
+		std::string filePath{}; //OBJ relative to the scene file (instanced, through the mesh cache), empty for inline triangles
+		std::vector<Vector3> positions{};
+		std::vector<int> indices{};
+
+		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+		uint32_t materialIndex{};
+
+		Vector3 translation{};
+		float yaw{}; //radians
+		Vector3 scale{ 1.f, 1.f, 1.f };
+
+		MeshAnimationType animation{ MeshAnimationType::None };
+		float animationParameters[3]{};
+	};
+
+	struct LightDescription
+	{
+		LightType type{};
+		Vector3 originOrDirection{};
+		float intensity{};
+		ColorRGB color{};
+	};
+
+	struct CameraDescription
+	{
+		Vector3 origin{};
+		float fovAngle{ 90.f }; //degrees
+		float pitch{};
+		float yaw{};
+	};
+
+	/**
+	 * \brief Everything a scene is made of, loaded from a text file (.scene) or its compact binary form (.sceneb).
+	 * Text format, one statement per line, # starts a comment, angles in radians unless noted:
+	 *   camera <x y z> <fov degrees> [<pitch> <yaw>]
+	 *   material <name> solid <r g b> | lambert <r g b> <reflectance> | phong <r g b> <kd> <ks> <exponent> | cooktorrence <r g b> <metalness> <roughness>
+	 *   plane <x y z> <nx ny nz> <material>
+	 *   sphere <x y z> <radius> <material>
+	 *   mesh <name> <file.obj> <cull> <material>  (cull: backface, frontface or none)
+	 *   mesh <name> inline <cull> <material>, then "vertex <x y z>" and "triangle <i0 i1 i2>" lines up to "end"
+	 *   translate <mesh> <x y z>, rotate <mesh> <yaw>, scale <mesh> <x y z>
+	 *   animate <mesh> spin <radians per second> | swing <from> <to> <angular frequency>
+	 *   light point <x y z> <intensity> <r g b> | light directional <dx dy dz> <intensity> <r g b>
+	 * Materials are referenced by name, "default" is the default material.
+	 */
+	struct SceneDescription
+	{
+		CameraDescription camera{};
+		std::vector<MaterialDescription> materials{};
+		std::vector<PlaneDescription> planes{};
+		std::vector<SphereDescription> spheres{};
+		std::vector<MeshDescription> meshes{};
+		std::vector<LightDescription> lights{};
+	};
+
+	//Text or binary by extension (.sceneb is binary), prints the line of the first error and returns false on any error
+	bool LoadSceneDescription(const std::string& filePath, SceneDescription& description);
+	bool SaveSceneDescriptionBinary(const std::string& filePath, const SceneDescription& description);
+}
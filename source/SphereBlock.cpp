@@ -0,0 +1,294 @@
+#include "SphereBlock.h"
+
+#include <cfloat>
+#include <cmath>
+
+#include "InstructionSet.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Ray directions are normalized, so the quadratic reduces to t^2 + 2bt + c = 0 with b = dot(direction, origin - center)
+		template<bool anyHit>
+		bool IntersectBlocks_Scalar(const SphereBlock* pBlocks, uint32_t blockCount, const Vector3& origin, const Vector3& direction, float tMin, float& tMax, uint32_t& sphereIndex)
+		{
+			bool didHit{ false };
+
+			for (uint32_t b{ 0 }; b < blockCount; ++b)
+			{
+				const SphereBlock& block = pBlocks[b];
+
+				for (uint32_t lane{ 0 }; lane < SphereBlock::Width; ++lane)
+				{
+					const Vector3 centerToOrigin{ origin - Vector3{ block.originX[lane], block.originY[lane], block.originZ[lane] } };
+
+					const float halfB{ Vector3::Dot(direction, centerToOrigin) };
+					const float c{ Vector3::Dot(centerToOrigin, centerToOrigin) - block.radiusSquared[lane] };
+					const float discriminant{ halfB * halfB - c };
+					if (!(discriminant >= 0.f))
+						continue;
+
+					const float root{ std::sqrt(discriminant) };
+					const float tNear{ -halfB - root };
+					const float t{ tNear > tMin ? tNear : -halfB + root };
+					if (!(t > tMin && t < tMax))
+						continue;
+
+					tMax = t;
+					sphereIndex = block.sphereIndex[lane];
+					didHit = true;
+
+					if constexpr (anyHit)
+						return true;
+				}
+			}
+
+			return didHit;
+		}
+
+#if defined(SIMD_X86)
+		//Every block is tested as two 4-wide halves
+		template<bool anyHit>
+		SIMD_TARGET("sse2")
+		bool IntersectBlocks_SSE2(const SphereBlock* pBlocks, uint32_t blockCount, const Vector3& origin, const Vector3& direction, float tMin, float& tMax, uint32_t& sphereIndex)
+		{
+			constexpr uint32_t laneCount{ 4 };
+
+			const __m128 ox{ _mm_set1_ps(origin.x) };
+			const __m128 oy{ _mm_set1_ps(origin.y) };
+			const __m128 oz{ _mm_set1_ps(origin.z) };
+			const __m128 dx{ _mm_set1_ps(direction.x) };
+			const __m128 dy{ _mm_set1_ps(direction.y) };
+			const __m128 dz{ _mm_set1_ps(direction.z) };
+
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 tMinLanes{ _mm_set1_ps(tMin) };
+
+			bool didHit{ false };
+
+			for (uint32_t b{ 0 }; b < blockCount; ++b)
+			{
+				const SphereBlock& block = pBlocks[b];
+
+				for (uint32_t first{ 0 }; first < SphereBlock::Width; first += laneCount)
+				{
+					const __m128 cx{ _mm_sub_ps(ox, _mm_load_ps(block.originX + first)) };
+					const __m128 cy{ _mm_sub_ps(oy, _mm_load_ps(block.originY + first)) };
+					const __m128 cz{ _mm_sub_ps(oz, _mm_load_ps(block.originZ + first)) };
+
+					const __m128 halfB{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, cx), _mm_mul_ps(dy, cy)), _mm_mul_ps(dz, cz)) };
+					const __m128 c{ _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)), _mm_load_ps(block.radiusSquared + first)) };
+					const __m128 discriminant{ _mm_sub_ps(_mm_mul_ps(halfB, halfB), c) };
+
+					__m128 mask{ _mm_cmpge_ps(discriminant, zero) };
+					if (_mm_movemask_ps(mask) == 0)
+						continue;
+
+					const __m128 root{ _mm_sqrt_ps(discriminant) };
+					const __m128 minusHalfB{ _mm_sub_ps(zero, halfB) };
+					const __m128 tNear{ _mm_sub_ps(minusHalfB, root) };
+					const __m128 tFar{ _mm_add_ps(minusHalfB, root) };
+
+					//Ray starts inside the sphere (or the near hit is behind it): use the far root
+					const __m128 useNear{ _mm_cmpgt_ps(tNear, tMinLanes) };
+					const __m128 t{ _mm_or_ps(_mm_and_ps(useNear, tNear), _mm_andnot_ps(useNear, tFar)) };
+					mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(t, tMinLanes), _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+
+					const int hitLanes{ _mm_movemask_ps(mask) };
+					if (hitLanes == 0)
+						continue;
+
+					//Hits are rare, pick the closest lane in scalar (lowest lane wins ties, like the scalar kernel)
+					alignas(16) float tLanes[laneCount];
+					_mm_store_ps(tLanes, t);
+
+					for (uint32_t lane{ 0 }; lane < laneCount; ++lane)
+					{
+						if ((hitLanes & (1 << lane)) != 0 && tLanes[lane] < tMax)
+						{
+							tMax = tLanes[lane];
+							sphereIndex = block.sphereIndex[first + lane];
+							didHit = true;
+
+							if constexpr (anyHit)
+								return true;
+						}
+					}
+				}
+			}
+
+			return didHit;
+		}
+
+		template<bool anyHit>
+		SIMD_TARGET("avx2")
+		bool IntersectBlocks_AVX2(const SphereBlock* pBlocks, uint32_t blockCount, const Vector3& origin, const Vector3& direction, float tMin, float& tMax, uint32_t& sphereIndex)
+		{
+			const __m256 ox{ _mm256_set1_ps(origin.x) };
+			const __m256 oy{ _mm256_set1_ps(origin.y) };
+			const __m256 oz{ _mm256_set1_ps(origin.z) };
+			const __m256 dx{ _mm256_set1_ps(direction.x) };
+			const __m256 dy{ _mm256_set1_ps(direction.y) };
+			const __m256 dz{ _mm256_set1_ps(direction.z) };
+
+			const __m256 zero{ _mm256_setzero_ps() };
+			const __m256 tMinLanes{ _mm256_set1_ps(tMin) };
+
+			bool didHit{ false };
+
+			for (uint32_t b{ 0 }; b < blockCount; ++b)
+			{
+				const SphereBlock& block = pBlocks[b];
+
+				const __m256 cx{ _mm256_sub_ps(ox, _mm256_load_ps(block.originX)) };
+				const __m256 cy{ _mm256_sub_ps(oy, _mm256_load_ps(block.originY)) };
+				const __m256 cz{ _mm256_sub_ps(oz, _mm256_load_ps(block.originZ)) };
+
+				const __m256 halfB{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, cx), _mm256_mul_ps(dy, cy)), _mm256_mul_ps(dz, cz)) };
+				const __m256 c{ _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)), _mm256_mul_ps(cz, cz)), _mm256_load_ps(block.radiusSquared)) };
+				const __m256 discriminant{ _mm256_sub_ps(_mm256_mul_ps(halfB, halfB), c) };
+
+				__m256 mask{ _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ) };
+				if (_mm256_movemask_ps(mask) == 0)
+					continue;
+
+				const __m256 root{ _mm256_sqrt_ps(discriminant) };
+				const __m256 minusHalfB{ _mm256_sub_ps(zero, halfB) };
+				const __m256 tNear{ _mm256_sub_ps(minusHalfB, root) };
+				const __m256 tFar{ _mm256_add_ps(minusHalfB, root) };
+
+				const __m256 t{ _mm256_blendv_ps(tFar, tNear, _mm256_cmp_ps(tNear, tMinLanes, _CMP_GT_OQ)) };
+				mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(t, tMinLanes, _CMP_GT_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ)));
+
+				const int hitLanes{ _mm256_movemask_ps(mask) };
+				if (hitLanes == 0)
+					continue;
+
+				alignas(32) float tLanes[SphereBlock::Width];
+				_mm256_store_ps(tLanes, t);
+
+				for (uint32_t lane{ 0 }; lane < SphereBlock::Width; ++lane)
+				{
+					if ((hitLanes & (1 << lane)) != 0 && tLanes[lane] < tMax)
+					{
+						tMax = tLanes[lane];
+						sphereIndex = block.sphereIndex[lane];
+						didHit = true;
+
+						if constexpr (anyHit)
+							return true;
+					}
+				}
+			}
+
+			return didHit;
+		}
+#endif
+
+		struct KernelTable
+		{
+			SphereBlockKernel closestHit;
+			SphereBlockKernel anyHit;
+		};
+
+		KernelTable CreateKernelTable(InstructionSet instructionSet)
+		{
+			switch (instructionSet)
+			{
+#if defined(SIMD_X86)
+			case InstructionSet::AVX2:
+				return { IntersectBlocks_AVX2<false>, IntersectBlocks_AVX2<true> };
+
+			case InstructionSet::SSE2:
+				return { IntersectBlocks_SSE2<false>, IntersectBlocks_SSE2<true> };
+#endif
+			default:
+				break;
+			}
+
+			return { IntersectBlocks_Scalar<false>, IntersectBlocks_Scalar<true> };
+		}
+
+		const KernelTable& GetKernelTable(InstructionSet instructionSet)
+		{
+			//Indexed by InstructionSet
+			static const KernelTable kernelTables[]{ CreateKernelTable(InstructionSet::Scalar), CreateKernelTable(InstructionSet::SSE2), CreateKernelTable(InstructionSet::AVX2) };
+			return kernelTables[static_cast<int>(instructionSet)];
+		}
+	}
+
+	SphereBlockKernel GetSphereBlockKernel(bool anyHit)
+	{
+		return GetSphereBlockKernel(anyHit, GetInstructionSet());
+	}
+
+	SphereBlockKernel GetSphereBlockKernel(bool anyHit, InstructionSet instructionSet)
+	{
+		const KernelTable& kernelTable = GetKernelTable(instructionSet);
+		return anyHit ? kernelTable.anyHit : kernelTable.closestHit;
+	}
+
+	void SphereBlockBuffer::Build(const BVH& bvh, const std::vector<float>& originX, const std::vector<float>& originY, const std::vector<float>& originZ, const std::vector<float>& radiusSquared)
+	{
+		Clear();
+
+		const auto& nodes = bvh.GetNodes();
+		const auto& primitiveIndices = bvh.GetPrimitiveIndices();
+
+		m_NodeFirstBlock.resize(nodes.size());
+
+		uint32_t numBlocks{ 0 };
+		for (size_t i{ 0 }; i < nodes.size(); ++i)
+		{
+			if (!nodes[i].IsLeaf())
+				continue;
+
+			m_NodeFirstBlock[i] = numBlocks;
+			numBlocks += SphereBlock::GetBlockCount(nodes[i].primitiveCount);
+		}
+
+		m_Blocks.resize(numBlocks);
+
+		for (size_t i{ 0 }; i < nodes.size(); ++i)
+		{
+			const BVHNode& node = nodes[i];
+			if (!node.IsLeaf())
+				continue;
+
+			const uint32_t firstBlock{ m_NodeFirstBlock[i] };
+			const uint32_t blockCount{ SphereBlock::GetBlockCount(node.primitiveCount) };
+
+			for (uint32_t j{ 0 }; j < blockCount * SphereBlock::Width; ++j)
+			{
+				SphereBlock& block = m_Blocks[firstBlock + j / SphereBlock::Width];
+				const uint32_t lane{ j % SphereBlock::Width };
+
+				//Padding lane, can never be hit
+				if (j >= node.primitiveCount)
+				{
+					block.originX[lane] = 0.f;
+					block.originY[lane] = 0.f;
+					block.originZ[lane] = 0.f;
+					block.radiusSquared[lane] = -FLT_MAX;
+					block.sphereIndex[lane] = 0;
+					continue;
+				}
+
+				const uint32_t sphere{ primitiveIndices[node.leftFirst + j] };
+
+				block.originX[lane] = originX[sphere];
+				block.originY[lane] = originY[sphere];
+				block.originZ[lane] = originZ[sphere];
+				block.radiusSquared[lane] = radiusSquared[sphere];
+				block.sphereIndex[lane] = sphere;
+			}
+		}
+	}
+
+	void SphereBlockBuffer::Clear()
+	{
+		m_Blocks.clear();
+		m_NodeFirstBlock.clear();
+	}
+}
@@ -0,0 +1,58 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "BVH.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	enum class InstructionSet;
+
+	/**
+	 * \brief Structure-of-arrays pack of spheres so one ray can be tested against a whole block at once.
+	 * Unused lanes have a radiusSquared of -FLT_MAX, their discriminant is always negative.
+	 */
+	struct alignas(32) SphereBlock
+	{
+		static constexpr uint32_t Width{ 8 };
+
+		static constexpr uint32_t GetBlockCount(uint32_t sphereCount) { return (sphereCount + Width - 1) / Width; }
+
+		float originX[Width];
+		float originY[Width];
+		float originZ[Width];
+		float radiusSquared[Width];
+
+		uint32_t sphereIndex[Width];
+	};
+
+	/**
+	 * \brief Nearest hit over consecutive blocks, tMax is shrunk on every hit. Expects a normalized direction (a == 1 in the quadratic)
+	 * \param sphereIndex index of the closest sphere (any-hit: the first one found), only written on a hit
+	 */
+	using SphereBlockKernel = bool(*)(const SphereBlock* pBlocks, uint32_t blockCount, const Vector3& origin, const Vector3& direction, float tMin, float& tMax, uint32_t& sphereIndex);
+
+	//Kernel for the widest instruction set the CPU supports (see GetInstructionSet), the any-hit kernel returns at the first hit
+	SphereBlockKernel GetSphereBlockKernel(bool anyHit);
+	//Kernel for the given instruction set (microbenchmarks), the caller makes sure the CPU supports it. Without x86 SIMD every instruction set gets the scalar kernel
+	SphereBlockKernel GetSphereBlockKernel(bool anyHit, InstructionSet instructionSet);
+
+	/**
+	 * \brief Sphere blocks laid out in BVH leaf order, every leaf starts a new block.
+	 * Needs to be rebuilt after the BVH (or the spheres) change, a refit keeps the leaf layout so only the values move.
+	 */
+	class SphereBlockBuffer final
+	{
+	public:
+		void Build(const BVH& bvh, const std::vector<float>& originX, const std::vector<float>& originY, const std::vector<float>& originZ, const std::vector<float>& radiusSquared);
+		void Clear();
+
+		const SphereBlock* GetLeafBlocks(uint32_t nodeIndex) const { return m_Blocks.data() + m_NodeFirstBlock[nodeIndex]; }
+
+	private:
+		std::vector<SphereBlock> m_Blocks{};
+		std::vector<uint32_t> m_NodeFirstBlock{}; //per BVH node, only meaningful for leaves
+	};
+}
@@ -0,0 +1,140 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "FrameTrace.h"
+#include "InstructionSet.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace dae
+{
+	namespace
+	{
+		//Roughly a few microseconds of spinning before a thread goes to sleep
+		constexpr uint32_t SpinCount{ 4096 };
+
+		void Pause()
+		{
+#if defined(SIMD_X86)
+			_mm_pause();
+#else
+			std::this_thread::yield();
+#endif
+		}
+
+		//Spin-then-wait: returns once value no longer equals oldValue
+		void WaitWhileEqual(const std::atomic<uint32_t>& value, uint32_t oldValue)
+		{
+			for (uint32_t i{ 0 }; i < SpinCount; ++i)
+			{
+				if (value.load(std::memory_order_acquire) != oldValue)
+					return;
+
+				Pause();
+			}
+
+			while (value.load(std::memory_order_acquire) == oldValue)
+				value.wait(oldValue, std::memory_order_acquire);
+		}
+
+		void PinToProcessor(std::thread& thread, uint32_t processorIndex)
+		{
+#if defined(_WIN32)
+			if (processorIndex < 64)
+				SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{ 1 } << processorIndex);
+#elif defined(__linux__)
+			cpu_set_t cpuSet{};
+			CPU_ZERO(&cpuSet);
+			CPU_SET(processorIndex, &cpuSet);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet);
+#else
+			(void)thread;
+			(void)processorIndex;
+#endif
+		}
+	}
+
+	ThreadPool::ThreadPool(uint32_t numThreads)
+	{
+		const uint32_t numProcessors{ std::max(std::thread::hardware_concurrency(), 1u) };
+		if (numThreads == 0)
+			numThreads = numProcessors;
+
+		//The calling thread (the main thread) stays unpinned, worker i gets logical processor i
+		m_Threads.reserve(numThreads - 1);
+		for (uint32_t threadIndex{ 1 }; threadIndex < numThreads; ++threadIndex)
+		{
+			m_Threads.emplace_back([this, threadIndex] { RunWorker(threadIndex); });
+			PinToProcessor(m_Threads.back(), threadIndex % numProcessors);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		m_IsStopping = true;
+		m_Generation.fetch_add(1, std::memory_order_release);
+		m_Generation.notify_all();
+
+		for (std::thread& thread : m_Threads)
+			thread.join();
+	}
+
+	void ThreadPool::Execute(const std::function<void(uint32_t threadIndex)>& job)
+	{
+		if (m_Threads.empty())
+		{
+			job(0);
+			return;
+		}
+
+		m_pJob = &job;
+		m_NumBusyThreads.store(static_cast<uint32_t>(m_Threads.size()), std::memory_order_relaxed);
+
+		//Frame barrier: the release makes the job visible to every worker that sees the new generation
+		m_Generation.fetch_add(1, std::memory_order_release);
+		m_Generation.notify_all();
+
+		job(0);
+
+		uint32_t numBusyThreads{ m_NumBusyThreads.load(std::memory_order_acquire) };
+		while (numBusyThreads != 0)
+		{
+			WaitWhileEqual(m_NumBusyThreads, numBusyThreads);
+			numBusyThreads = m_NumBusyThreads.load(std::memory_order_acquire);
+		}
+
+		m_pJob = nullptr;
+	}
+
+	void ThreadPool::RunWorker(uint32_t threadIndex)
+	{
+		FrameTrace::SetThreadName(("worker " + std::to_string(threadIndex)).c_str());
+
+		//Not loaded: an Execute may already have bumped it before this thread got to run
+		uint32_t generation{ 0 };
+
+		while (true)
+		{
+			WaitWhileEqual(m_Generation, generation);
+			generation = m_Generation.load(std::memory_order_acquire);
+
+			if (m_IsStopping)
+				return;
+
+			(*m_pJob)(threadIndex);
+
+			//Last one out wakes up Execute
+			if (m_NumBusyThreads.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				m_NumBusyThreads.notify_one();
+		}
+	}
+}
@@ -0,0 +1,45 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	/**
+	 * \brief Worker threads that are created once and live as long as the pool, every worker is pinned to its own logical processor.
+	 * Between two Execute calls the workers park: they spin for a short while (a frame is usually right behind the last one) and then sleep on the generation counter (futex / WaitOnAddress).
+	 */
+	class ThreadPool final
+	{
+	public:
+		//Thread count includes the calling thread, 0: one per hardware thread
+		explicit ThreadPool(uint32_t numThreads = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		uint32_t GetNumThreads() const { return static_cast<uint32_t>(m_Threads.size()) + 1; }
+
+		//Runs job(threadIndex) once on every thread, the calling thread is thread 0. Returns once all of them finished
+		void Execute(const std::function<void(uint32_t threadIndex)>& job);
+
+	private:
+		std::vector<std::thread> m_Threads{};
+
+		const std::function<void(uint32_t threadIndex)>* m_pJob{};
+		bool m_IsStopping{ false };
+
+		//Bumped once per Execute, the workers wake up on the change
+		std::atomic<uint32_t> m_Generation{ 0 };
+		//Workers still running the current job
+		std::atomic<uint32_t> m_NumBusyThreads{ 0 };
+
+		void RunWorker(uint32_t threadIndex);
+	};
+}
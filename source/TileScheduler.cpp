@@ -0,0 +1,59 @@
+#include "TileScheduler.h"
+
+#include <algorithm>
+
+#include "FrameTrace.h"
+
+namespace dae
+{
+	TileScheduler::TileScheduler(uint32_t numWorkers) :
+		m_ThreadPool{ numWorkers },
+		m_pBackend{ CreateExecutionBackend(m_BackendType, m_ThreadPool) }
+	{
+	}
+
+	void TileScheduler::SetTileSize(uint32_t width, uint32_t height)
+	{
+		width = std::max(width, 1u);
+		m_TileWidth = (width + TileWidthAlignment - 1) / TileWidthAlignment * TileWidthAlignment;
+		m_TileHeight = std::max(height, 1u);
+	}
+
+	bool TileScheduler::SetBackend(ExecutionBackendType type)
+	{
+		if (type == m_BackendType)
+			return true;
+
+		std::unique_ptr<ExecutionBackend> pBackend{ CreateExecutionBackend(type, m_ThreadPool) };
+		if (!pBackend)
+			return false;
+
+		m_pBackend = std::move(pBackend);
+		m_BackendType = type;
+		return true;
+	}
+
+	void TileScheduler::Run(uint32_t numTasks, const std::function<void(uint32_t taskIndex)>& task)
+	{
+		m_pBackend->Run(numTasks, task);
+	}
+
+	void TileScheduler::RunTiles(uint32_t imageWidth, uint32_t imageHeight, const std::function<void(const Tile& tile)>& tileTask)
+	{
+		const uint32_t numTilesX{ (imageWidth + m_TileWidth - 1) / m_TileWidth };
+		const uint32_t numTilesY{ (imageHeight + m_TileHeight - 1) / m_TileHeight };
+
+		Run(numTilesX * numTilesY, [&](uint32_t tileIndex)
+			{
+				TRACE_ZONE("Tile");
+
+				Tile tile{};
+				tile.x = tileIndex % numTilesX * m_TileWidth;
+				tile.y = tileIndex / numTilesX * m_TileHeight;
+				tile.width = std::min(m_TileWidth, imageWidth - tile.x);
+				tile.height = std::min(m_TileHeight, imageHeight - tile.y);
+
+				tileTask(tile);
+			});
+	}
+}
@@ -0,0 +1,65 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "ExecutionBackend.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	//Screen rectangle [x, x + width) x [y, y + height), clipped to the image
+	struct Tile
+	{
+		uint32_t x{};
+		uint32_t y{};
+		uint32_t width{};
+		uint32_t height{};
+	};
+
+	/**
+	 * \brief Splits passes into tiles and runs them on the selected ExecutionBackend.
+	 * Owns the ThreadPool of the pool based backends (created once, lives as long as the scheduler), switching backends keeps the threads.
+	 */
+	class TileScheduler final
+	{
+	public:
+		//16 uint32_t pixels fill a 64 byte cache line: with tile widths a multiple of this and a framebuffer that is cache line aligned with a pitch
+		//that is a multiple of it as well (see Renderer), two tiles never write to the same line
+		static constexpr uint32_t TileWidthAlignment{ 16 };
+
+		//0 workers: one per hardware thread
+		explicit TileScheduler(uint32_t numWorkers = 0);
+		~TileScheduler() = default;
+
+		TileScheduler(const TileScheduler&) = delete;
+		TileScheduler(TileScheduler&&) noexcept = delete;
+		TileScheduler& operator=(const TileScheduler&) = delete;
+		TileScheduler& operator=(TileScheduler&&) noexcept = delete;
+
+		//Width gets rounded up to a multiple of TileWidthAlignment
+		void SetTileSize(uint32_t width, uint32_t height);
+		uint32_t GetTileWidth() const { return m_TileWidth; }
+		uint32_t GetTileHeight() const { return m_TileHeight; }
+		uint32_t GetNumWorkers() const { return m_ThreadPool.GetNumThreads(); }
+
+		//Returns false (and keeps the current backend) when the backend is not available in this build
+		bool SetBackend(ExecutionBackendType type);
+		ExecutionBackendType GetBackend() const { return m_BackendType; }
+
+		//Runs task(0) ... task(numTasks - 1) and returns once all of them finished
+		void Run(uint32_t numTasks, const std::function<void(uint32_t taskIndex)>& task);
+		//Splits the image into tiles (row by row, so neighbouring tiles start on the same worker) and runs tileTask for each of them
+		void RunTiles(uint32_t imageWidth, uint32_t imageHeight, const std::function<void(const Tile& tile)>& tileTask);
+
+	private:
+		ThreadPool m_ThreadPool;
+
+		ExecutionBackendType m_BackendType{ ExecutionBackendType::WorkStealing };
+		std::unique_ptr<ExecutionBackend> m_pBackend{};
+
+		uint32_t m_TileWidth{ 32 };
+		uint32_t m_TileHeight{ 32 };
+	};
+}
@@ -1,23 +1,25 @@
 #include "Timer.h"
 
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
 #include <numeric>
 
 #include <iostream>
 #include <fstream>
 
-#include "SDL.h"
+#include "Platform.h"
 using namespace dae;
 
 Timer::Timer()
 {
-	const uint64_t countsPerSecond = SDL_GetPerformanceFrequency();
+	const uint64_t countsPerSecond = Platform::GetPerformanceFrequency();
 	m_SecondsPerCount = 1.0f / static_cast<float>(countsPerSecond);
 }
 
 void Timer::Reset()
 {
-	const uint64_t currentTime = SDL_GetPerformanceCounter();
+	const uint64_t currentTime = Platform::GetPerformanceCounter();
 
 	m_BaseTime = currentTime;
 	m_PreviousTime = currentTime;
@@ -29,7 +31,7 @@ void Timer::Reset()
 
 void Timer::Start()
 {
-	const uint64_t startTime = SDL_GetPerformanceCounter();
+	const uint64_t startTime = Platform::GetPerformanceCounter();
 
 	if (m_IsStopped)
 	{
@@ -61,6 +63,8 @@ void Timer::StartBenchmark(int numFrames)
 	m_Benchmarks.clear();
 	m_Benchmarks.resize(m_BenchmarkFrames);
 
+	ResetFrameTimes();
+
 	std::cout << "**BENCHMARK STARTED**\n";
 }
 
@@ -74,12 +78,21 @@ void Timer::Update()
 		return;
 	}
 
-	const uint64_t currentTime = SDL_GetPerformanceCounter();
+	const uint64_t currentTime = Platform::GetPerformanceCounter();
 	m_CurrentTime = currentTime;
 
 	m_ElapsedTime = (float)((m_CurrentTime - m_PreviousTime) * m_SecondsPerCount);
 	m_PreviousTime = m_CurrentTime;
 
+	RecordFrameTime(m_ElapsedTime);
+
+	if (m_FixedTimeStep > 0.0f)
+	{
+		m_ElapsedTime = m_FixedTimeStep;
+		m_TotalTime += m_FixedTimeStep;
+		return;
+	}
+
 	if (m_ElapsedTime < 0.0f)
 		m_ElapsedTime = 0.0f;
 
@@ -119,12 +132,22 @@ void Timer::Update()
 				std::cout << ">> LOW = " << m_BenchmarkLow << std::endl;
 				std::cout << ">> AVG = " << m_BenchmarkAvg << std::endl;
 
+				const FrameTimeStats frameTimes = GetFrameTimeStats();
+				std::cout << ">> FRAME TIME (ms) P50 = " << frameTimes.p50 * 1000.f << ", P90 = " << frameTimes.p90 * 1000.f
+					<< ", P99 = " << frameTimes.p99 * 1000.f << ", MAX = " << frameTimes.max * 1000.f << std::endl;
+				std::cout << ">> OVER BUDGET = " << frameTimes.numOverBudget << "/" << frameTimes.numFrames << std::endl;
+
 				//file save
 				std::ofstream fileStream("benchmark.txt");
 				fileStream << "FRAMES = " << m_BenchmarkCurrFrame << std::endl;
 				fileStream << "HIGH = " << m_BenchmarkHigh << std::endl;
 				fileStream << "LOW = " << m_BenchmarkLow << std::endl;
 				fileStream << "AVG = " << m_BenchmarkAvg << std::endl;
+				fileStream << "FRAME TIME P50 = " << frameTimes.p50 * 1000.f << " ms" << std::endl;
+				fileStream << "FRAME TIME P90 = " << frameTimes.p90 * 1000.f << " ms" << std::endl;
+				fileStream << "FRAME TIME P99 = " << frameTimes.p99 * 1000.f << " ms" << std::endl;
+				fileStream << "FRAME TIME MAX = " << frameTimes.max * 1000.f << " ms" << std::endl;
+				fileStream << "OVER BUDGET = " << frameTimes.numOverBudget << " (" << m_FrameBudget * 1000.f << " ms)" << std::endl;
 				fileStream.close();
 			}
 		}
@@ -135,9 +158,53 @@ void Timer::Stop()
 {
 	if (!m_IsStopped)
 	{
-		const uint64_t currentTime = SDL_GetPerformanceCounter();
+		const uint64_t currentTime = Platform::GetPerformanceCounter();
 
 		m_StopTime = currentTime;
 		m_IsStopped = true;
 	}
 }
+
+void Timer::ResetFrameTimes()
+{
+	m_FrameTimeIndex = 0;
+	m_NumFrameTimes = 0;
+	m_FrameTimeHistogram.fill(0);
+}
+
+FrameTimeStats Timer::GetFrameTimeStats() const
+{
+	FrameTimeStats stats{};
+	stats.numFrames = m_NumFrameTimes;
+	if (m_NumFrameTimes == 0)
+		return stats;
+
+	//Order does not matter for percentiles, the ring buffer is full or filled from the front
+	std::vector<float> frameTimes(m_FrameTimes.begin(), m_FrameTimes.begin() + m_NumFrameTimes);
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	//Nearest rank
+	const auto getPercentile = [&frameTimes](float percentile)
+		{
+			const size_t rank{ static_cast<size_t>(percentile / 100.f * static_cast<float>(frameTimes.size() - 1) + 0.5f) };
+			return frameTimes[std::min(rank, frameTimes.size() - 1)];
+		};
+
+	stats.p50 = getPercentile(50.f);
+	stats.p90 = getPercentile(90.f);
+	stats.p99 = getPercentile(99.f);
+	stats.max = frameTimes.back();
+	stats.numOverBudget = static_cast<uint32_t>(frameTimes.end() - std::upper_bound(frameTimes.begin(), frameTimes.end(), m_FrameBudget));
+
+	return stats;
+}
+
+void Timer::RecordFrameTime(float frameTime)
+{
+	m_FrameTimes[m_FrameTimeIndex] = frameTime;
+	m_FrameTimeIndex = (m_FrameTimeIndex + 1) % FrameTimeHistorySize;
+	m_NumFrameTimes = std::min(m_NumFrameTimes + 1, FrameTimeHistorySize);
+
+	const uint32_t bucket{ static_cast<uint32_t>(std::max(frameTime, 0.f) / FrameTimeBucketWidth) };
+	++m_FrameTimeHistogram[std::min(bucket, NumFrameTimeBuckets - 1)];
+}
@@ -1,14 +1,31 @@
 #pragma once
 
 //Standard includes
+#include <array>
 #include <cstdint>
 #include <vector>
 
 namespace dae
 {
+	//Wall clock frame times in seconds over the last (at most Timer::FrameTimeHistorySize) frames
+	struct FrameTimeStats
+	{
+		uint32_t numFrames{};
+		float p50{};
+		float p90{};
+		float p99{};
+		float max{};
+		uint32_t numOverBudget{};
+	};
+
 	class Timer
 	{
 	public:
+		static constexpr uint32_t FrameTimeHistorySize{ 4096 };
+		//1 ms per bucket, the last bucket also counts every slower frame
+		static constexpr uint32_t NumFrameTimeBuckets{ 256 };
+		static constexpr float FrameTimeBucketWidth{ 0.001f };
+
 		Timer();
 		virtual ~Timer() = default;
 
@@ -18,6 +35,11 @@ namespace dae
 		Timer& operator=(Timer&&) noexcept = delete;
 
 		void StartBenchmark(int numFrames = 10);
+		//Every Update advances the time by exactly timeStep seconds (deterministic animation for offline rendering), 0 goes back to real time
+		void SetFixedTimeStep(float timeStep) { m_FixedTimeStep = timeStep; }
+		//Frames that take longer than budget seconds count as over budget
+		void SetFrameBudget(float budget) { m_FrameBudget = budget; }
+		float GetFrameBudget() const { return m_FrameBudget; }
 
 		void Reset();
 		void Start();
@@ -30,6 +52,12 @@ namespace dae
 		float GetTotal() const { return m_TotalTime; };
 		bool IsRunning() const { return !m_IsStopped; };
 
+		//Every Update records the wall clock time since the previous one (also with a fixed time step) in a ring buffer and a histogram
+		void ResetFrameTimes();
+		FrameTimeStats GetFrameTimeStats() const;
+		//Counts since the last ResetFrameTimes, not limited to the ring buffer
+		const std::array<uint32_t, NumFrameTimeBuckets>& GetFrameTimeHistogram() const { return m_FrameTimeHistogram; }
+
 	private:
 		uint64_t m_BaseTime = 0;
 		uint64_t m_PausedTime = 0;
@@ -46,10 +74,19 @@ namespace dae
 		float m_SecondsPerCount = 0.0f;
 		float m_ElapsedUpperBound = 0.03f;
 		float m_FPSTimer = 0.0f;
+		float m_FixedTimeStep = 0.0f;
 
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
 
+		std::array<float, FrameTimeHistorySize> m_FrameTimes{};
+		uint32_t m_FrameTimeIndex = 0;
+		uint32_t m_NumFrameTimes = 0;
+		std::array<uint32_t, NumFrameTimeBuckets> m_FrameTimeHistogram{};
+		float m_FrameBudget = 1.0f / 60.0f;
+
+		void RecordFrameTime(float frameTime);
+
 		bool m_BenchmarkActive = false;
 		float m_BenchmarkHigh{ 0.f };
 		float m_BenchmarkLow{ 0.f };
@@ -0,0 +1,406 @@
+#include "TriangleBlock.h"
+
+#include <utility>
+
+#include "DataTypes.h"
+#include "InstructionSet.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Same operation order as Vector3::Cross/Dot in every kernel, so all instruction sets return identical hits
+		template<TriangleCullMode cullMode, bool anyHit>
+		bool IntersectBlocks_Scalar(const TriangleBlock* pBlocks, uint32_t blockCount, const Vector3& origin, const Vector3& direction, float tMin, float& tMax, uint32_t& triangleIndex)
+		{
+			bool didHit{ false };
+
+			for (uint32_t b{ 0 }; b < blockCount; ++b)
+			{
+				const TriangleBlock& block = pBlocks[b];
+
+				for (uint32_t lane{ 0 }; lane < TriangleBlock::Width; ++lane)
+				{
+					const Vector3 edge1{ block.edge1x[lane], block.edge1y[lane], block.edge1z[lane] };
+					const Vector3 edge2{ block.edge2x[lane], block.edge2y[lane], block.edge2z[lane] };
+
+					const Vector3 pvec{ Vector3::Cross(direction, edge2) };
+					const float determinant{ Vector3::Dot(edge1, pvec) };
+
+					if constexpr (cullMode == TriangleCullMode::BackFaceCulling)
+					{
+						if (!(determinant > 0.f))
+							continue;
+					}
+					else if constexpr (cullMode == TriangleCullMode::FrontFaceCulling)
+					{
+						if (!(determinant < 0.f))
+							continue;
+					}
+					else
+					{
+						if (!(determinant != 0.f))
+							continue;
+					}
+
+					const float inverseDeterminant{ 1.f / determinant };
+
+					const Vector3 tvec{ origin - Vector3{ block.v0x[lane], block.v0y[lane], block.v0z[lane] } };
+					const float u{ Vector3::Dot(tvec, pvec) * inverseDeterminant };
+					if (!(u >= 0.f && u <= 1.f))
+						continue;
+
+					const Vector3 qvec{ Vector3::Cross(tvec, edge1) };
+					const float v{ Vector3::Dot(direction, qvec) * inverseDeterminant };
+					if (!(v >= 0.f && u + v <= 1.f))
+						continue;
+
+					const float t{ Vector3::Dot(edge2, qvec) * inverseDeterminant };
+					if (!(t > tMin && t < tMax))
+						continue;
+
+					tMax = t;
+					triangleIndex = block.triangleIndex[lane];
+					didHit = true;
+
+					if constexpr (anyHit)
+						return true;
+				}
+			}
+
+			return didHit;
+		}
+
+#if defined(SIMD_X86)
+		//Every block is tested as two 4-wide halves
+		template<TriangleCullMode cullMode, bool anyHit>
+		SIMD_TARGET("sse2")
+		bool IntersectBlocks_SSE2(const TriangleBlock* pBlocks, uint32_t blockCount, const Vector3& origin, const Vector3& direction, float tMin, float& tMax, uint32_t& triangleIndex)
+		{
+			constexpr uint32_t laneCount{ 4 };
+
+			const __m128 ox{ _mm_set1_ps(origin.x) };
+			const __m128 oy{ _mm_set1_ps(origin.y) };
+			const __m128 oz{ _mm_set1_ps(origin.z) };
+			const __m128 dx{ _mm_set1_ps(direction.x) };
+			const __m128 dy{ _mm_set1_ps(direction.y) };
+			const __m128 dz{ _mm_set1_ps(direction.z) };
+
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
+			const __m128 tMinLanes{ _mm_set1_ps(tMin) };
+
+			bool didHit{ false };
+
+			for (uint32_t b{ 0 }; b < blockCount; ++b)
+			{
+				const TriangleBlock& block = pBlocks[b];
+
+				for (uint32_t first{ 0 }; first < TriangleBlock::Width; first += laneCount)
+				{
+					const __m128 e1x{ _mm_load_ps(block.edge1x + first) };
+					const __m128 e1y{ _mm_load_ps(block.edge1y + first) };
+					const __m128 e1z{ _mm_load_ps(block.edge1z + first) };
+					const __m128 e2x{ _mm_load_ps(block.edge2x + first) };
+					const __m128 e2y{ _mm_load_ps(block.edge2y + first) };
+					const __m128 e2z{ _mm_load_ps(block.edge2z + first) };
+
+					const __m128 px{ _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y)) };
+					const __m128 py{ _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z)) };
+					const __m128 pz{ _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x)) };
+
+					const __m128 determinant{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz)) };
+
+					__m128 mask;
+					if constexpr (cullMode == TriangleCullMode::BackFaceCulling)
+						mask = _mm_cmpgt_ps(determinant, zero);
+					else if constexpr (cullMode == TriangleCullMode::FrontFaceCulling)
+						mask = _mm_cmplt_ps(determinant, zero);
+					else
+						mask = _mm_andnot_ps(_mm_cmpeq_ps(determinant, zero), _mm_cmpord_ps(determinant, determinant));
+
+					if (_mm_movemask_ps(mask) == 0)
+						continue;
+
+					const __m128 inverseDeterminant{ _mm_div_ps(one, determinant) };
+
+					const __m128 tx{ _mm_sub_ps(ox, _mm_load_ps(block.v0x + first)) };
+					const __m128 ty{ _mm_sub_ps(oy, _mm_load_ps(block.v0y + first)) };
+					const __m128 tz{ _mm_sub_ps(oz, _mm_load_ps(block.v0z + first)) };
+
+					const __m128 u{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverseDeterminant) };
+					mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+					const __m128 qx{ _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y)) };
+					const __m128 qy{ _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z)) };
+					const __m128 qz{ _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x)) };
+
+					const __m128 v{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDeterminant) };
+					mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+					const __m128 t{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDeterminant) };
+					mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(t, tMinLanes), _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+
+					const int hitLanes{ _mm_movemask_ps(mask) };
+					if (hitLanes == 0)
+						continue;
+
+					//Hits are rare, pick the closest lane in scalar (lowest lane wins ties, like the scalar kernel)
+					alignas(16) float tLanes[laneCount];
+					_mm_store_ps(tLanes, t);
+
+					for (uint32_t lane{ 0 }; lane < laneCount; ++lane)
+					{
+						if ((hitLanes & (1 << lane)) != 0 && tLanes[lane] < tMax)
+						{
+							tMax = tLanes[lane];
+							triangleIndex = block.triangleIndex[first + lane];
+							didHit = true;
+
+							if constexpr (anyHit)
+								return true;
+						}
+					}
+				}
+			}
+
+			return didHit;
+		}
+
+		template<TriangleCullMode cullMode, bool anyHit>
+		SIMD_TARGET("avx2")
+		bool IntersectBlocks_AVX2(const TriangleBlock* pBlocks, uint32_t blockCount, const Vector3& origin, const Vector3& direction, float tMin, float& tMax, uint32_t& triangleIndex)
+		{
+			const __m256 ox{ _mm256_set1_ps(origin.x) };
+			const __m256 oy{ _mm256_set1_ps(origin.y) };
+			const __m256 oz{ _mm256_set1_ps(origin.z) };
+			const __m256 dx{ _mm256_set1_ps(direction.x) };
+			const __m256 dy{ _mm256_set1_ps(direction.y) };
+			const __m256 dz{ _mm256_set1_ps(direction.z) };
+
+			const __m256 zero{ _mm256_setzero_ps() };
+			const __m256 one{ _mm256_set1_ps(1.f) };
+			const __m256 tMinLanes{ _mm256_set1_ps(tMin) };
+
+			bool didHit{ false };
+
+			for (uint32_t b{ 0 }; b < blockCount; ++b)
+			{
+				const TriangleBlock& block = pBlocks[b];
+
+				const __m256 e1x{ _mm256_load_ps(block.edge1x) };
+				const __m256 e1y{ _mm256_load_ps(block.edge1y) };
+				const __m256 e1z{ _mm256_load_ps(block.edge1z) };
+				const __m256 e2x{ _mm256_load_ps(block.edge2x) };
+				const __m256 e2y{ _mm256_load_ps(block.edge2y) };
+				const __m256 e2z{ _mm256_load_ps(block.edge2z) };
+
+				const __m256 px{ _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y)) };
+				const __m256 py{ _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z)) };
+				const __m256 pz{ _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x)) };
+
+				const __m256 determinant{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz)) };
+
+				__m256 mask;
+				if constexpr (cullMode == TriangleCullMode::BackFaceCulling)
+					mask = _mm256_cmp_ps(determinant, zero, _CMP_GT_OQ);
+				else if constexpr (cullMode == TriangleCullMode::FrontFaceCulling)
+					mask = _mm256_cmp_ps(determinant, zero, _CMP_LT_OQ);
+				else
+					mask = _mm256_cmp_ps(determinant, zero, _CMP_NEQ_OQ);
+
+				if (_mm256_movemask_ps(mask) == 0)
+					continue;
+
+				const __m256 inverseDeterminant{ _mm256_div_ps(one, determinant) };
+
+				const __m256 tx{ _mm256_sub_ps(ox, _mm256_load_ps(block.v0x)) };
+				const __m256 ty{ _mm256_sub_ps(oy, _mm256_load_ps(block.v0y)) };
+				const __m256 tz{ _mm256_sub_ps(oz, _mm256_load_ps(block.v0z)) };
+
+				const __m256 u{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)), _mm256_mul_ps(tz, pz)), inverseDeterminant) };
+				mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+
+				const __m256 qx{ _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y)) };
+				const __m256 qy{ _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z)) };
+				const __m256 qz{ _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x)) };
+
+				const __m256 v{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inverseDeterminant) };
+				mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+
+				const __m256 t{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inverseDeterminant) };
+				mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(t, tMinLanes, _CMP_GT_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ)));
+
+				const int hitLanes{ _mm256_movemask_ps(mask) };
+				if (hitLanes == 0)
+					continue;
+
+				alignas(32) float tLanes[TriangleBlock::Width];
+				_mm256_store_ps(tLanes, t);
+
+				for (uint32_t lane{ 0 }; lane < TriangleBlock::Width; ++lane)
+				{
+					if ((hitLanes & (1 << lane)) != 0 && tLanes[lane] < tMax)
+					{
+						tMax = tLanes[lane];
+						triangleIndex = block.triangleIndex[lane];
+						didHit = true;
+
+						if constexpr (anyHit)
+							return true;
+					}
+				}
+			}
+
+			return didHit;
+		}
+#endif
+
+		struct KernelSet
+		{
+			TriangleBlockKernel frontFaceCulling;
+			TriangleBlockKernel backFaceCulling;
+			TriangleBlockKernel noCulling;
+		};
+
+		struct KernelTable
+		{
+			KernelSet closestHit;
+			KernelSet anyHit;
+		};
+
+		KernelTable CreateKernelTable(InstructionSet instructionSet)
+		{
+			switch (instructionSet)
+			{
+#if defined(SIMD_X86)
+			case InstructionSet::AVX2:
+				return {
+					{
+						IntersectBlocks_AVX2<TriangleCullMode::FrontFaceCulling, false>,
+						IntersectBlocks_AVX2<TriangleCullMode::BackFaceCulling, false>,
+						IntersectBlocks_AVX2<TriangleCullMode::NoCulling, false> },
+					{
+						IntersectBlocks_AVX2<TriangleCullMode::FrontFaceCulling, true>,
+						IntersectBlocks_AVX2<TriangleCullMode::BackFaceCulling, true>,
+						IntersectBlocks_AVX2<TriangleCullMode::NoCulling, true> } };
+
+			case InstructionSet::SSE2:
+				return {
+					{
+						IntersectBlocks_SSE2<TriangleCullMode::FrontFaceCulling, false>,
+						IntersectBlocks_SSE2<TriangleCullMode::BackFaceCulling, false>,
+						IntersectBlocks_SSE2<TriangleCullMode::NoCulling, false> },
+					{
+						IntersectBlocks_SSE2<TriangleCullMode::FrontFaceCulling, true>,
+						IntersectBlocks_SSE2<TriangleCullMode::BackFaceCulling, true>,
+						IntersectBlocks_SSE2<TriangleCullMode::NoCulling, true> } };
+#endif
+			default:
+				break;
+			}
+
+			return {
+				{
+					IntersectBlocks_Scalar<TriangleCullMode::FrontFaceCulling, false>,
+					IntersectBlocks_Scalar<TriangleCullMode::BackFaceCulling, false>,
+					IntersectBlocks_Scalar<TriangleCullMode::NoCulling, false> },
+				{
+					IntersectBlocks_Scalar<TriangleCullMode::FrontFaceCulling, true>,
+					IntersectBlocks_Scalar<TriangleCullMode::BackFaceCulling, true>,
+					IntersectBlocks_Scalar<TriangleCullMode::NoCulling, true> } };
+		}
+
+		const KernelTable& GetKernelTable(InstructionSet instructionSet)
+		{
+			//Indexed by InstructionSet
+			static const KernelTable kernelTables[]{ CreateKernelTable(InstructionSet::Scalar), CreateKernelTable(InstructionSet::SSE2), CreateKernelTable(InstructionSet::AVX2) };
+			return kernelTables[static_cast<int>(instructionSet)];
+		}
+	}
+
+	TriangleBlockKernel GetTriangleBlockKernel(TriangleCullMode cullMode, bool anyHit)
+	{
+		return GetTriangleBlockKernel(cullMode, anyHit, GetInstructionSet());
+	}
+
+	TriangleBlockKernel GetTriangleBlockKernel(TriangleCullMode cullMode, bool anyHit, InstructionSet instructionSet)
+	{
+		const KernelTable& kernelTable = GetKernelTable(instructionSet);
+		const KernelSet& kernelSet = anyHit ? kernelTable.anyHit : kernelTable.closestHit;
+
+		switch (cullMode)
+		{
+		case TriangleCullMode::FrontFaceCulling:
+			return kernelSet.frontFaceCulling;
+
+		case TriangleCullMode::BackFaceCulling:
+			return kernelSet.backFaceCulling;
+
+		case TriangleCullMode::NoCulling:
+			break;
+		}
+
+		return kernelSet.noCulling;
+	}
+
+	void TriangleBlockBuffer::Build(const BVH& bvh, const std::vector<Vector3>& positions, const std::vector<int>& indices)
+	{
+		Clear();
+
+		const auto& nodes = bvh.GetNodes();
+		const auto& primitiveIndices = bvh.GetPrimitiveIndices();
+
+		m_NodeFirstBlock.resize(nodes.size());
+
+		uint32_t numBlocks{ 0 };
+		for (size_t i{ 0 }; i < nodes.size(); ++i)
+		{
+			if (!nodes[i].IsLeaf())
+				continue;
+
+			m_NodeFirstBlock[i] = numBlocks;
+			numBlocks += TriangleBlock::GetBlockCount(nodes[i].primitiveCount);
+		}
+
+		//Value initialized, so the padding lanes are degenerate triangles
+		m_Blocks.resize(numBlocks);
+
+		for (size_t i{ 0 }; i < nodes.size(); ++i)
+		{
+			const BVHNode& node = nodes[i];
+			if (!node.IsLeaf())
+				continue;
+
+			for (uint32_t j{ 0 }; j < node.primitiveCount; ++j)
+			{
+				TriangleBlock& block = m_Blocks[m_NodeFirstBlock[i] + j / TriangleBlock::Width];
+				const uint32_t lane{ j % TriangleBlock::Width };
+
+				const uint32_t triangle{ primitiveIndices[node.leftFirst + j] };
+				const size_t index{ static_cast<size_t>(triangle) * 3 };
+
+				const Vector3& v0{ positions[indices[index]] };
+				const Vector3 edge1{ positions[indices[index + 1]] - v0 };
+				const Vector3 edge2{ positions[indices[index + 2]] - v0 };
+
+				block.v0x[lane] = v0.x;
+				block.v0y[lane] = v0.y;
+				block.v0z[lane] = v0.z;
+				block.edge1x[lane] = edge1.x;
+				block.edge1y[lane] = edge1.y;
+				block.edge1z[lane] = edge1.z;
+				block.edge2x[lane] = edge2.x;
+				block.edge2y[lane] = edge2.y;
+				block.edge2z[lane] = edge2.z;
+				block.triangleIndex[lane] = triangle;
+			}
+		}
+	}
+
+	void TriangleBlockBuffer::Clear()
+	{
+		m_Blocks.clear();
+		m_NodeFirstBlock.clear();
+	}
+}
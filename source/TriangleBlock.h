@@ -0,0 +1,67 @@
+// ReSharper disable CppInconsistentNaming
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "BVH.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	enum class InstructionSet;
+	enum class TriangleCullMode;
+
+	/**
+	 * \brief Structure-of-arrays pack of triangles (v0 + two edges per lane) so one ray can be tested against a whole block at once.
+	 * Unused lanes are degenerate (zero edges), every cull mode rejects them.
+	 */
+	struct alignas(32) TriangleBlock
+	{
+		static constexpr uint32_t Width{ 8 };
+
+		static constexpr uint32_t GetBlockCount(uint32_t triangleCount) { return (triangleCount + Width - 1) / Width; }
+
+		float v0x[Width];
+		float v0y[Width];
+		float v0z[Width];
+		float edge1x[Width];
+		float edge1y[Width];
+		float edge1z[Width];
+		float edge2x[Width];
+		float edge2y[Width];
+		float edge2z[Width];
+
+		uint32_t triangleIndex[Width];
+	};
+
+	/**
+	 * \brief Closest hit over consecutive blocks, tMax is shrunk on every hit
+	 * \param triangleIndex index of the closest triangle (any-hit: the first one found), only written on a hit
+	 */
+	using TriangleBlockKernel = bool(*)(const TriangleBlock* pBlocks, uint32_t blockCount, const Vector3& origin, const Vector3& direction, float tMin, float& tMax, uint32_t& triangleIndex);
+
+	//Kernel for the widest instruction set the CPU supports (see GetInstructionSet), the any-hit kernel returns at the first hit
+	TriangleBlockKernel GetTriangleBlockKernel(TriangleCullMode cullMode, bool anyHit = false);
+	//Kernel for the given instruction set (microbenchmarks), the caller makes sure the CPU supports it. Without x86 SIMD every instruction set gets the scalar kernel
+	TriangleBlockKernel GetTriangleBlockKernel(TriangleCullMode cullMode, bool anyHit, InstructionSet instructionSet);
+
+	/**
+	 * \brief Triangle blocks laid out in BVH leaf order, every leaf starts a new block.
+	 * Needs to be rebuilt after the BVH (or the vertices) change, a refit keeps the leaf layout so only the values move.
+	 */
+	class TriangleBlockBuffer final
+	{
+	public:
+		void Build(const BVH& bvh, const std::vector<Vector3>& positions, const std::vector<int>& indices);
+		void Clear();
+
+		const std::vector<TriangleBlock>& GetBlocks() const { return m_Blocks; }
+		const std::vector<uint32_t>& GetNodeFirstBlocks() const { return m_NodeFirstBlock; }
+
+		const TriangleBlock* GetLeafBlocks(uint32_t nodeIndex) const { return m_Blocks.data() + m_NodeFirstBlock[nodeIndex]; }
+
+	private:
+		std::vector<TriangleBlock> m_Blocks{};
+		std::vector<uint32_t> m_NodeFirstBlock{}; //per BVH node, only meaningful for leaves
+	};
+}
@@ -1,19 +1,365 @@
 #pragma once
+#include <bit>
 #include <cassert>
-#include <fstream>
 
 #include "Math.h"
 #include "DataTypes.h"
+#include "InstructionSet.h"
+#include "RayStats.h"
 
 namespace dae
 {
 	namespace GeometryUtils
 	{
+#pragma region BVH Traversal
+		/**
+		 * \brief Slab test against an axis aligned box, clipped to the [min, max] range of the ray
+		 * \param inverseDirection 1 / ray.direction, computed once per ray by the caller
+		 * \return entry distance along the ray, FLT_MAX when the box is missed
+		 */
+		inline float SlabTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray, const Vector3& inverseDirection)
+		{
+			const float tx1 = (minAABB.x - ray.origin.x) * inverseDirection.x;
+			const float tx2 = (maxAABB.x - ray.origin.x) * inverseDirection.x;
+
+			float tmin = std::min(tx1, tx2);
+			float tmax = std::max(tx1, tx2);
+
+			const float ty1 = (minAABB.y - ray.origin.y) * inverseDirection.y;
+			const float ty2 = (maxAABB.y - ray.origin.y) * inverseDirection.y;
+
+			tmin = std::max(tmin, std::min(ty1, ty2));
+			tmax = std::min(tmax, std::max(ty1, ty2));
+
+			const float tz1 = (minAABB.z - ray.origin.z) * inverseDirection.z;
+			const float tz2 = (maxAABB.z - ray.origin.z) * inverseDirection.z;
+
+			tmin = std::max(tmin, std::min(tz1, tz2));
+			tmax = std::min(tmax, std::max(tz1, tz2));
+
+			tmin = std::max(tmin, ray.min);
+			tmax = std::min(tmax, ray.max);
+
+			RAY_STATS_INC(SlabTests);
+			if (tmax < tmin)
+				return FLT_MAX;
+
+			RAY_STATS_INC(SlabTestsPassed);
+			return tmin;
+		}
+
+		/**
+		 * \brief Walks a BVH front to back, nearest child first, handing whole leaves to leafFunc
+		 * \param ray ray to traverse with, leafFunc may shrink ray.max to cull farther nodes (closest hit)
+		 * \param anyHit stop at the first leaf that reports a hit (occlusion)
+		 * \param leafFunc bool(uint32_t nodeIndex, const BVHNode& leaf), returns true when a primitive in the leaf was hit
+		 * \param rootIndex node to start from, to continue a subtree on its own
+		 * \return true if any leaf reported a hit
+		 */
+		template<typename LeafFunc>
+		bool TraverseBVHLeaves(const BVH& bvh, Ray& ray, bool anyHit, LeafFunc&& leafFunc, uint32_t rootIndex = 0)
+		{
+			const auto& nodes = bvh.GetNodes();
+
+			if (nodes.empty())
+				return false;
+
+			const Vector3 inverseDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+			struct StackEntry
+			{
+				uint32_t nodeIndex;
+				float tEntry;
+			};
+
+			StackEntry stack[BVH::MaxDepth + 1];
+			uint32_t stackSize{ 0 };
+
+			const float tRoot = SlabTest_AABB(nodes[rootIndex].minAABB, nodes[rootIndex].maxAABB, ray, inverseDirection);
+			if (tRoot == FLT_MAX)
+				return false;
+
+			stack[stackSize++] = { rootIndex, tRoot };
+			bool didHit{ false };
+
+			while (stackSize > 0)
+			{
+				const StackEntry entry = stack[--stackSize];
+
+				//Node was pushed before a closer hit was found
+				if (entry.tEntry > ray.max)
+					continue;
+
+				const BVHNode& node = nodes[entry.nodeIndex];
+				RAY_STATS_INC(NodesVisited);
+
+				if (node.IsLeaf())
+				{
+					if (leafFunc(entry.nodeIndex, node))
+					{
+						if (anyHit)
+							return true;
+
+						didHit = true;
+					}
+					continue;
+				}
+
+				//Visit the nearest child first, the farther one waits on the stack with its entry distance
+				uint32_t nearIndex = node.leftFirst;
+				uint32_t farIndex = node.leftFirst + 1;
+				float tNear = SlabTest_AABB(nodes[nearIndex].minAABB, nodes[nearIndex].maxAABB, ray, inverseDirection);
+				float tFar = SlabTest_AABB(nodes[farIndex].minAABB, nodes[farIndex].maxAABB, ray, inverseDirection);
+
+				if (tFar < tNear)
+				{
+					std::swap(nearIndex, farIndex);
+					std::swap(tNear, tFar);
+				}
+
+				if (tFar != FLT_MAX)
+					stack[stackSize++] = { farIndex, tFar };
+				if (tNear != FLT_MAX)
+					stack[stackSize++] = { nearIndex, tNear };
+			}
+
+			return didHit;
+		}
+
+		/**
+		 * \brief Walks a BVH front to back, nearest child first
+		 * \param ray ray to traverse with, primitiveFunc may shrink ray.max to cull farther nodes (closest hit)
+		 * \param anyHit stop at the first primitive that reports a hit (occlusion)
+		 * \param primitiveFunc bool(uint32_t primitiveIndex), returns true when the primitive was hit
+		 * \return true if any primitive reported a hit
+		 */
+		template<typename PrimitiveFunc>
+		bool TraverseBVH(const BVH& bvh, Ray& ray, bool anyHit, PrimitiveFunc&& primitiveFunc)
+		{
+			const auto& primitiveIndices = bvh.GetPrimitiveIndices();
+
+			return TraverseBVHLeaves(bvh, ray, anyHit, [&](uint32_t, const BVHNode& leaf)
+				{
+					bool didHit{ false };
+					for (uint32_t i{ leaf.leftFirst }; i < leaf.leftFirst + leaf.primitiveCount; ++i)
+					{
+						if (primitiveFunc(primitiveIndices[i]))
+						{
+							if (anyHit)
+								return true;
+
+							didHit = true;
+						}
+					}
+					return didHit;
+				});
+		}
+
+		/**
+		 * \brief Slab test of every lane in laneMask against an axis aligned box, same math as the single ray version
+		 * \param tEntries entry distance per lane, only meaningful for the lanes in the returned mask
+		 * \return mask of the lanes that hit the box
+		 */
+		inline uint32_t SlabTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const RayPacket& packet, uint32_t laneMask, float* tEntries)
+		{
+			uint32_t hitMask{ 0 };
+
+#if defined(SIMD_SSE2)
+			const __m128 minX{ _mm_set1_ps(minAABB.x) };
+			const __m128 minY{ _mm_set1_ps(minAABB.y) };
+			const __m128 minZ{ _mm_set1_ps(minAABB.z) };
+			const __m128 maxX{ _mm_set1_ps(maxAABB.x) };
+			const __m128 maxY{ _mm_set1_ps(maxAABB.y) };
+			const __m128 maxZ{ _mm_set1_ps(maxAABB.z) };
+
+			//std::min(a, b) == _mm_min_ps(b, a) (and the same for max), also when a NaN shows up
+			for (uint32_t first{ 0 }; first < RayPacket::Size; first += 4)
+			{
+				if (((laneMask >> first) & 0xF) == 0)
+					continue;
+
+				const __m128 ox{ _mm_load_ps(packet.originX + first) };
+				const __m128 oy{ _mm_load_ps(packet.originY + first) };
+				const __m128 oz{ _mm_load_ps(packet.originZ + first) };
+				const __m128 idx{ _mm_load_ps(packet.inverseDirectionX + first) };
+				const __m128 idy{ _mm_load_ps(packet.inverseDirectionY + first) };
+				const __m128 idz{ _mm_load_ps(packet.inverseDirectionZ + first) };
+
+				const __m128 tx1{ _mm_mul_ps(_mm_sub_ps(minX, ox), idx) };
+				const __m128 tx2{ _mm_mul_ps(_mm_sub_ps(maxX, ox), idx) };
+
+				__m128 tmin{ _mm_min_ps(tx2, tx1) };
+				__m128 tmax{ _mm_max_ps(tx2, tx1) };
+
+				const __m128 ty1{ _mm_mul_ps(_mm_sub_ps(minY, oy), idy) };
+				const __m128 ty2{ _mm_mul_ps(_mm_sub_ps(maxY, oy), idy) };
+
+				tmin = _mm_max_ps(_mm_min_ps(ty2, ty1), tmin);
+				tmax = _mm_min_ps(_mm_max_ps(ty2, ty1), tmax);
+
+				const __m128 tz1{ _mm_mul_ps(_mm_sub_ps(minZ, oz), idz) };
+				const __m128 tz2{ _mm_mul_ps(_mm_sub_ps(maxZ, oz), idz) };
+
+				tmin = _mm_max_ps(_mm_min_ps(tz2, tz1), tmin);
+				tmax = _mm_min_ps(_mm_max_ps(tz2, tz1), tmax);
+
+				tmin = _mm_max_ps(_mm_load_ps(packet.min + first), tmin);
+				tmax = _mm_min_ps(_mm_load_ps(packet.max + first), tmax);
+
+				_mm_storeu_ps(tEntries + first, tmin);
+				hitMask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpnlt_ps(tmax, tmin))) << first;
+			}
+#else
+			for (uint32_t lane{ 0 }; lane < RayPacket::Size; ++lane)
+			{
+				if ((laneMask & (1u << lane)) == 0)
+					continue;
+
+				const Vector3 inverseDirection{ packet.inverseDirectionX[lane], packet.inverseDirectionY[lane], packet.inverseDirectionZ[lane] };
+				tEntries[lane] = SlabTest_AABB(minAABB, maxAABB, packet.GetRay(lane), inverseDirection);
+				if (tEntries[lane] != FLT_MAX)
+					hitMask |= 1u << lane;
+			}
+#endif
+
+			RAY_STATS_ADD(SlabTests, std::popcount(laneMask));
+			RAY_STATS_ADD(SlabTestsPassed, std::popcount(hitMask & laneMask));
+			return hitMask & laneMask;
+		}
+
+		//False when the box lies completely outside one of the packet frustum planes, no ray of the packet can hit it then
+		inline bool FrustumTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const RayPacket& packet)
+		{
+			if (!packet.hasFrustum)
+				return true;
+
+			const Vector3 origin{ packet.GetOrigin(0) };
+
+			for (const Vector3& normal : packet.frustumNormals)
+			{
+				//Corner farthest along the inward normal, with some slack for the rays that lie (almost) on the plane
+				const Vector3 corner{ normal.x >= 0.f ? maxAABB.x : minAABB.x, normal.y >= 0.f ? maxAABB.y : minAABB.y, normal.z >= 0.f ? maxAABB.z : minAABB.z };
+				const Vector3 toCorner{ corner - origin };
+
+				if (Vector3::Dot(normal, toCorner) < -1e-4f * (std::abs(toCorner.x) + std::abs(toCorner.y) + std::abs(toCorner.z)))
+					return false;
+			}
+
+			return true;
+		}
+
+		/**
+		 * \brief Walks a BVH with a whole packet (closest hit), lanes that miss a node get masked off.
+		 * A subtree that only one lane reaches continues as a single ray traversal
+		 * \param laneMask lanes to trace
+		 * \param leafFunc void(uint32_t nodeIndex, const BVHNode& leaf, uint32_t laneMask), has to shrink packet.max of every lane it hits
+		 */
+		template<typename LeafFunc>
+		void TraverseBVHPacket(const BVH& bvh, RayPacket& packet, uint32_t laneMask, LeafFunc&& leafFunc)
+		{
+			const auto& nodes = bvh.GetNodes();
+
+			if (nodes.empty() || laneMask == 0)
+				return;
+
+			struct StackEntry
+			{
+				uint32_t nodeIndex;
+				uint32_t laneMask;
+				float tEntry; //closest entry over all lanes
+			};
+
+			const auto closestEntry = [](const float* tEntries, uint32_t mask)
+			{
+				float tEntry{ FLT_MAX };
+				for (; mask != 0; mask &= mask - 1)
+					tEntry = std::min(tEntry, tEntries[std::countr_zero(mask)]);
+
+				return tEntry;
+			};
+
+			StackEntry stack[BVH::MaxDepth + 1];
+			uint32_t stackSize{ 0 };
+
+			alignas(16) float tEntries[RayPacket::Size];
+			alignas(16) float tEntriesFar[RayPacket::Size];
+
+			if (!FrustumTest_AABB(nodes[0].minAABB, nodes[0].maxAABB, packet))
+				return;
+
+			const uint32_t rootMask = SlabTest_AABB(nodes[0].minAABB, nodes[0].maxAABB, packet, laneMask, tEntries);
+			if (rootMask == 0)
+				return;
+
+			stack[stackSize++] = { 0, rootMask, closestEntry(tEntries, rootMask) };
+
+			while (stackSize > 0)
+			{
+				const StackEntry entry = stack[--stackSize];
+
+				//Node was pushed before closer hits were found for all of its lanes
+				if (entry.tEntry > packet.GetMaxT(entry.laneMask))
+					continue;
+
+				const BVHNode& node = nodes[entry.nodeIndex];
+
+				//The rays diverged, a packet of one only adds overhead
+				if (std::has_single_bit(entry.laneMask))
+				{
+					const uint32_t lane = std::countr_zero(entry.laneMask);
+					Ray ray{ packet.GetRay(lane) };
+
+					TraverseBVHLeaves(bvh, ray, false, [&](uint32_t nodeIndex, const BVHNode& leaf)
+						{
+							leafFunc(nodeIndex, leaf, entry.laneMask);
+							ray.max = packet.max[lane];
+							return false;
+						}, entry.nodeIndex);
+					continue;
+				}
+
+				RAY_STATS_INC(NodesVisited);
+				if (node.IsLeaf())
+				{
+					leafFunc(entry.nodeIndex, node, entry.laneMask);
+					continue;
+				}
+
+				uint32_t nearIndex = node.leftFirst;
+				uint32_t farIndex = node.leftFirst + 1;
+
+				uint32_t nearMask{ 0 };
+				uint32_t farMask{ 0 };
+				if (FrustumTest_AABB(nodes[nearIndex].minAABB, nodes[nearIndex].maxAABB, packet))
+					nearMask = SlabTest_AABB(nodes[nearIndex].minAABB, nodes[nearIndex].maxAABB, packet, entry.laneMask, tEntries);
+				if (FrustumTest_AABB(nodes[farIndex].minAABB, nodes[farIndex].maxAABB, packet))
+					farMask = SlabTest_AABB(nodes[farIndex].minAABB, nodes[farIndex].maxAABB, packet, entry.laneMask, tEntriesFar);
+
+				float tNear{ nearMask != 0 ? closestEntry(tEntries, nearMask) : FLT_MAX };
+				float tFar{ farMask != 0 ? closestEntry(tEntriesFar, farMask) : FLT_MAX };
+
+				//Visit the child the packet enters first
+				if (tFar < tNear)
+				{
+					std::swap(nearIndex, farIndex);
+					std::swap(nearMask, farMask);
+					std::swap(tNear, tFar);
+				}
+
+				if (farMask != 0)
+					stack[stackSize++] = { farIndex, farMask, tFar };
+				if (nearMask != 0)
+					stack[stackSize++] = { nearIndex, nearMask, tNear };
+			}
+		}
+#pragma endregion
 #pragma region Sphere HitTest
 		//SPHERE HIT-TESTS
 
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
+			RAY_STATS_INC(SphereTests);
+
 			const Vector3 sphereToRay = ray.origin - sphere.origin;
 
 			const float a = Vector3::Dot(ray.direction, ray.direction);
@@ -78,11 +424,122 @@ namespace dae
 			HitRecord temp{};
 			return HitTest_Sphere(sphere, ray, temp, true);
 		}
+
+		//Closest (or any) hit over a whole SphereSet through its BVH and the SIMD sphere blocks, the ray direction has to be normalized
+		inline bool HitTest_SphereSet(const SphereSet& spheres, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			Ray localRay{ ray };
+			if (!ignoreHitRecord)
+				localRay.max = std::min(localRay.max, hitRecord.t);
+
+			const SphereBlockKernel kernel{ GetSphereBlockKernel(ignoreHitRecord) };
+			uint32_t sphereIndex{};
+
+			const bool didHit = TraverseBVHLeaves(spheres.bvh, localRay, ignoreHitRecord, [&](uint32_t nodeIndex, const BVHNode& node)
+				{
+					RAY_STATS_ADD(SphereTests, node.primitiveCount);
+					return kernel(spheres.sphereBlocks.GetLeafBlocks(nodeIndex), SphereBlock::GetBlockCount(node.primitiveCount), localRay.origin, localRay.direction, localRay.min, localRay.max, sphereIndex);
+				});
+
+			if (!didHit)
+				return ignoreHitRecord ? false : hitRecord.didHit;
+
+			if (ignoreHitRecord)
+				return true;
+
+			hitRecord.origin = ray.origin + ray.direction * localRay.max;
+			hitRecord.didHit = true;
+			hitRecord.t = localRay.max;
+			hitRecord.materialIndex = spheres.materialIndices[sphereIndex];
+			hitRecord.normal = Vector3{ (hitRecord.origin - spheres.GetOrigin(sphereIndex)).Normalized() };
+			return true;
+		}
+
+		/**
+		 * \brief Occlusion only: any-hit traversal with the any-hit kernels, no hit record gets built
+		 * \param sphereIndex the first sphere found between ray.min and ray.max, only written on a hit
+		 */
+		inline bool HitTest_SphereSet(const SphereSet& spheres, const Ray& ray, uint32_t& sphereIndex)
+		{
+			const SphereBlockKernel kernel{ GetSphereBlockKernel(true) };
+			Ray localRay{ ray };
+
+			return TraverseBVHLeaves(spheres.bvh, localRay, true, [&](uint32_t nodeIndex, const BVHNode& node)
+				{
+					RAY_STATS_ADD(SphereTests, node.primitiveCount);
+					return kernel(spheres.sphereBlocks.GetLeafBlocks(nodeIndex), SphereBlock::GetBlockCount(node.primitiveCount), localRay.origin, localRay.direction, localRay.min, localRay.max, sphereIndex);
+				});
+		}
+
+		inline bool HitTest_SphereSet(const SphereSet& spheres, const Ray& ray)
+		{
+			uint32_t sphereIndex{};
+			return HitTest_SphereSet(spheres, ray, sphereIndex);
+		}
+
+		//Occlusion test against a single sphere of the set, same math (and result) as the sphere block kernels
+		inline bool HitTest_SphereSet(const SphereSet& spheres, uint32_t sphereIndex, const Ray& ray)
+		{
+			RAY_STATS_INC(SphereTests);
+
+			const Vector3 centerToOrigin{ ray.origin - spheres.GetOrigin(sphereIndex) };
+
+			const float halfB{ Vector3::Dot(ray.direction, centerToOrigin) };
+			const float c{ Vector3::Dot(centerToOrigin, centerToOrigin) - spheres.radiusSquared[sphereIndex] };
+			const float discriminant{ halfB * halfB - c };
+			if (!(discriminant >= 0.f))
+				return false;
+
+			const float root{ std::sqrt(discriminant) };
+			const float tNear{ -halfB - root };
+			const float t{ tNear > ray.min ? tNear : -halfB + root };
+			return t > ray.min && t < ray.max;
+		}
+
+		/**
+		 * \brief Packet version, packet.max of every lane has to be the closest hit so far (it shrinks with every sphere hit)
+		 * \param hitRecords one per lane, only the lanes with a closer hit get written
+		 */
+		inline void HitTest_SphereSet(const SphereSet& spheres, RayPacket& packet, uint32_t laneMask, HitRecord* hitRecords)
+		{
+			const SphereBlockKernel kernel{ GetSphereBlockKernel(false) };
+			uint32_t sphereIndices[RayPacket::Size];
+			uint32_t hitMask{ 0 };
+
+			TraverseBVHPacket(spheres.bvh, packet, laneMask, [&](uint32_t nodeIndex, const BVHNode& node, uint32_t leafMask)
+				{
+					const SphereBlock* pBlocks{ spheres.sphereBlocks.GetLeafBlocks(nodeIndex) };
+					const uint32_t blockCount{ SphereBlock::GetBlockCount(node.primitiveCount) };
+					RAY_STATS_ADD(SphereTests, node.primitiveCount * std::popcount(leafMask));
+
+					for (; leafMask != 0; leafMask &= leafMask - 1)
+					{
+						const uint32_t lane = std::countr_zero(leafMask);
+						if (kernel(pBlocks, blockCount, packet.GetOrigin(lane), packet.GetDirection(lane), packet.min[lane], packet.max[lane], sphereIndices[lane]))
+							hitMask |= 1u << lane;
+					}
+				});
+
+			for (; hitMask != 0; hitMask &= hitMask - 1)
+			{
+				const uint32_t lane = std::countr_zero(hitMask);
+				const uint32_t sphereIndex{ sphereIndices[lane] };
+				HitRecord& hitRecord = hitRecords[lane];
+
+				hitRecord.origin = packet.GetOrigin(lane) + packet.GetDirection(lane) * packet.max[lane];
+				hitRecord.didHit = true;
+				hitRecord.t = packet.max[lane];
+				hitRecord.materialIndex = spheres.materialIndices[sphereIndex];
+				hitRecord.normal = Vector3{ (hitRecord.origin - spheres.GetOrigin(sphereIndex)).Normalized() };
+			}
+		}
 #pragma endregion
 #pragma region Plane HitTest
 		//PLANE HIT-TESTS
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, const bool ignoreHitRecord = false)
 		{
+			RAY_STATS_INC(PlaneTests);
+
 			const float nominator{ Vector3::Dot(plane.origin - ray.origin, plane.normal) };
 			const float denominator{ Vector3::Dot(ray.direction, plane.normal) };
 			const float t{ nominator / denominator };
@@ -99,16 +556,18 @@ namespace dae
 					hitRecord.t = t;
 					hitRecord.didHit = true;
 					hitRecord.materialIndex = plane.materialIndex;
-					return true;
 				}
+				return true;
 			}
 			return false;
 		}
 
+		//Occlusion only, same hit condition as above
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Plane(plane, ray, temp, true);
+			RAY_STATS_INC(PlaneTests);
+			const float t{ Vector3::Dot(plane.origin - ray.origin, plane.normal) / Vector3::Dot(ray.direction, plane.normal) };
+			return t >= ray.min && t <= ray.max && t > FLT_EPSILON;
 		}
 #pragma endregion
 #pragma region Triangle HitTest
@@ -135,12 +594,17 @@ namespace dae
 			tmin = std::max(tmin, std::min(tz1, tz2));
 			tmax = std::min(tmax, std::max(tz1, tz2));
 
-			return tmax > 0 && tmax >= tmin;
+			const bool didHit{ tmax > 0 && tmax >= tmin };
+			RAY_STATS_INC(SlabTests);
+			RAY_STATS_ADD(SlabTestsPassed, didHit ? 1 : 0);
+			return didHit;
 		}
 
 		//TRIANGLE HIT-TESTS
 		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
+			RAY_STATS_INC(TriangleTests);
+
 			const Vector3 center{ (triangle.v0 + triangle.v1 + triangle.v2) / 3 };
 			const Vector3 l{ center - ray.origin };
 
@@ -210,44 +674,279 @@ namespace dae
 			return HitTest_Triangle(triangle, ray, temp, true);
 		}
 
-
-		inline bool HitTest_TriangleMesh(const TriangleMesh& triangleMesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		/**
+		 * \brief Moller-Trumbore test against a precomputed triangle record, the cull mode is resolved at compile time.
+		 * Same comparisons as the triangle block kernels, so NaNs (degenerate triangles) are rejected the same way
+		 * \param t distance along the ray, only written on a hit
+		 */
+		template<TriangleCullMode cullMode>
+		bool HitTest_TriangleRecord(const TriangleRecord& triangle, const Ray& ray, float& t)
 		{
-			//slabtest
-			if (!SlabTest_TriangleMesh(triangleMesh, ray))
+			RAY_STATS_INC(TriangleTests);
+
+			const Vector3 pvec{ Vector3::Cross(ray.direction, triangle.edge2) };
+
+			//determinant = -dot(direction, normal): positive for front faces
+			const float determinant{ Vector3::Dot(triangle.edge1, pvec) };
+
+			if constexpr (cullMode == TriangleCullMode::BackFaceCulling)
+			{
+				if (!(determinant > 0.f))
+					return false;
+			}
+			else if constexpr (cullMode == TriangleCullMode::FrontFaceCulling)
+			{
+				if (!(determinant < 0.f))
+					return false;
+			}
+			else
+			{
+				if (!(determinant != 0.f))
+					return false;
+			}
+
+			const float inverseDeterminant{ 1.f / determinant };
+
+			const Vector3 tvec{ ray.origin - triangle.v0 };
+			const float u{ Vector3::Dot(tvec, pvec) * inverseDeterminant };
+			if (!(u >= 0.f && u <= 1.f))
+				return false;
+
+			const Vector3 qvec{ Vector3::Cross(tvec, triangle.edge1) };
+			const float v{ Vector3::Dot(ray.direction, qvec) * inverseDeterminant };
+			if (!(v >= 0.f && u + v <= 1.f))
 				return false;
 
-			HitRecord tempHitRecord;
+			const float hitT{ Vector3::Dot(triangle.edge2, qvec) * inverseDeterminant };
+			if (!(hitT > ray.min && hitT < ray.max))
+				return false;
 
-			for (size_t i = 0; i < triangleMesh.indices.size(); i += 3)
+			t = hitT;
+			return true;
+		}
+
+		inline bool HitTest_TriangleRecord(TriangleCullMode cullMode, const TriangleRecord& triangle, const Ray& ray, float& t)
+		{
+			switch (cullMode)
 			{
-				Triangle triangle{
-					triangleMesh.transformedPositions[triangleMesh.indices[i]],
-					triangleMesh.transformedPositions[triangleMesh.indices[i + 1]],
-					triangleMesh.transformedPositions[triangleMesh.indices[i + 2]],
-					triangleMesh.transformedNormals[i / 3]
-				};
+			case TriangleCullMode::FrontFaceCulling:
+				return HitTest_TriangleRecord<TriangleCullMode::FrontFaceCulling>(triangle, ray, t);
+
+			case TriangleCullMode::BackFaceCulling:
+				return HitTest_TriangleRecord<TriangleCullMode::BackFaceCulling>(triangle, ray, t);
+
+			case TriangleCullMode::NoCulling:
+				break;
+			}
 
-				triangle.cullMode = triangleMesh.cullMode;
-				triangle.materialIndex = triangleMesh.materialIndex;
+			return HitTest_TriangleRecord<TriangleCullMode::NoCulling>(triangle, ray, t);
+		}
 
-				if (HitTest_Triangle(triangle, ray, tempHitRecord))
+		//Closest (or any) hit against the SIMD triangle blocks of every leaf the ray reaches, ray.max shrinks on every hit
+		inline bool HitTest_TriangleBlocks(TriangleCullMode cullMode, const BVH& bvh, const TriangleBlockBuffer& triangleBlocks, Ray& ray, bool anyHit, uint32_t& hitTriangleIndex)
+		{
+			const TriangleBlockKernel kernel{ GetTriangleBlockKernel(cullMode, anyHit) };
+
+			return TraverseBVHLeaves(bvh, ray, anyHit, [&](uint32_t nodeIndex, const BVHNode& node)
 				{
-					if (ignoreHitRecord)
-						return true;
+					RAY_STATS_ADD(TriangleTests, node.primitiveCount);
+					return kernel(triangleBlocks.GetLeafBlocks(nodeIndex), TriangleBlock::GetBlockCount(node.primitiveCount), ray.origin, ray.direction, ray.min, ray.max, hitTriangleIndex);
+				});
+		}
 
-					if (tempHitRecord.t < hitRecord.t)
-						hitRecord = tempHitRecord;
-				}
-			}
+		//Packet version: every lane shrinks its own packet.max, triangleIndices is only written for the lanes in the returned mask
+		inline uint32_t HitTest_TriangleBlocks(TriangleCullMode cullMode, const BVH& bvh, const TriangleBlockBuffer& triangleBlocks, RayPacket& packet, uint32_t laneMask, uint32_t* triangleIndices)
+		{
+			const TriangleBlockKernel kernel{ GetTriangleBlockKernel(cullMode) };
+			uint32_t hitMask{ 0 };
+
+			TraverseBVHPacket(bvh, packet, laneMask, [&](uint32_t nodeIndex, const BVHNode& node, uint32_t leafMask)
+				{
+					const TriangleBlock* pBlocks{ triangleBlocks.GetLeafBlocks(nodeIndex) };
+					const uint32_t blockCount{ TriangleBlock::GetBlockCount(node.primitiveCount) };
+					RAY_STATS_ADD(TriangleTests, node.primitiveCount * std::popcount(leafMask));
+
+					for (; leafMask != 0; leafMask &= leafMask - 1)
+					{
+						const uint32_t lane = std::countr_zero(leafMask);
+						if (kernel(pBlocks, blockCount, packet.GetOrigin(lane), packet.GetDirection(lane), packet.min[lane], packet.max[lane], triangleIndices[lane]))
+							hitMask |= 1u << lane;
+					}
+				});
+
+			return hitMask;
+		}
+
+		inline bool HitTest_TriangleMesh(const TriangleMesh& triangleMesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			//Ray max shrinks every time a closer triangle is found, so farther nodes get culled
+			Ray localRay{ ray };
+			if (!ignoreHitRecord)
+				localRay.max = std::min(localRay.max, hitRecord.t);
+
+			uint32_t triangleIndex{};
+			if (!HitTest_TriangleBlocks(triangleMesh.cullMode, triangleMesh.bvh, triangleMesh.triangleBlocks, localRay, ignoreHitRecord, triangleIndex))
+				return ignoreHitRecord ? false : hitRecord.didHit;
 
-			return hitRecord.didHit;
+			if (ignoreHitRecord)
+				return true;
+
+			hitRecord.origin = ray.origin + ray.direction * localRay.max;
+			hitRecord.normal = triangleMesh.transformedNormals[triangleIndex].Normalized();
+			hitRecord.t = localRay.max;
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = triangleMesh.materialIndex;
+
+			return true;
+		}
+
+		/**
+		 * \brief Occlusion only: any-hit traversal with the any-hit kernels, no hit record gets built
+		 * \param triangleIndex the first triangle found between ray.min and ray.max, only written on a hit
+		 */
+		inline bool HitTest_TriangleMesh(const TriangleMesh& triangleMesh, const Ray& ray, uint32_t& triangleIndex)
+		{
+			Ray localRay{ ray };
+			return HitTest_TriangleBlocks(triangleMesh.cullMode, triangleMesh.bvh, triangleMesh.triangleBlocks, localRay, true, triangleIndex);
 		}
 
 		inline bool HitTest_TriangleMesh(const TriangleMesh& triangleMesh, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_TriangleMesh(triangleMesh, ray, temp, true);
+			uint32_t triangleIndex{};
+			return HitTest_TriangleMesh(triangleMesh, ray, triangleIndex);
+		}
+
+		//Occlusion test against a single triangle of the mesh, same result as the block kernels
+		inline bool HitTest_TriangleMesh(const TriangleMesh& triangleMesh, uint32_t triangleIndex, const Ray& ray)
+		{
+			const size_t index{ static_cast<size_t>(triangleIndex) * 3 };
+			const TriangleRecord triangle{
+				triangleMesh.transformedPositions[triangleMesh.indices[index]],
+				triangleMesh.transformedPositions[triangleMesh.indices[index + 1]],
+				triangleMesh.transformedPositions[triangleMesh.indices[index + 2]] };
+
+			float t{};
+			return HitTest_TriangleRecord(triangleMesh.cullMode, triangle, ray, t);
+		}
+
+		//Packet version, packet.max of every lane has to be the closest hit so far
+		inline void HitTest_TriangleMesh(const TriangleMesh& triangleMesh, RayPacket& packet, uint32_t laneMask, HitRecord* hitRecords)
+		{
+			uint32_t triangleIndices[RayPacket::Size];
+			uint32_t hitMask{ HitTest_TriangleBlocks(triangleMesh.cullMode, triangleMesh.bvh, triangleMesh.triangleBlocks, packet, laneMask, triangleIndices) };
+
+			for (; hitMask != 0; hitMask &= hitMask - 1)
+			{
+				const uint32_t lane = std::countr_zero(hitMask);
+				HitRecord& hitRecord = hitRecords[lane];
+
+				hitRecord.origin = packet.GetOrigin(lane) + packet.GetDirection(lane) * packet.max[lane];
+				hitRecord.normal = triangleMesh.transformedNormals[triangleIndices[lane]].Normalized();
+				hitRecord.t = packet.max[lane];
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = triangleMesh.materialIndex;
+			}
+		}
+
+		//World to object space ray of an instance, shared by the closest hit and occlusion tests so they agree
+		inline Ray GetObjectSpaceRay(const TriangleMeshInstance& instance, const Ray& ray)
+		{
+			Ray objectRay{ ray };
+			objectRay.origin = instance.inverseTransform.TransformPoint(ray.origin);
+			objectRay.direction = instance.inverseTransform.TransformVector(ray.direction);
+			return objectRay;
+		}
+
+		inline bool HitTest_TriangleMeshInstance(const TriangleMeshInstance& instance, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			const TriangleMeshGeometry& geometry = *instance.pGeometry;
+
+			//Direction is not renormalized, so t is the same in object and world space
+			Ray objectRay{ GetObjectSpaceRay(instance, ray) };
+
+			if (!ignoreHitRecord)
+				objectRay.max = std::min(objectRay.max, hitRecord.t);
+
+			uint32_t triangleIndex{};
+			if (!HitTest_TriangleBlocks(instance.cullMode, geometry.bvh, geometry.triangleBlocks, objectRay, ignoreHitRecord, triangleIndex))
+				return ignoreHitRecord ? false : hitRecord.didHit;
+
+			if (ignoreHitRecord)
+				return true;
+
+			//Only the closest hit gets converted back to world space
+			hitRecord.origin = ray.origin + ray.direction * objectRay.max;
+			hitRecord.normal = instance.TransformNormal(geometry.normals[triangleIndex]);
+			hitRecord.t = objectRay.max;
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = instance.materialIndex;
+
+			return true;
+		}
+
+		/**
+		 * \brief Occlusion only: any-hit traversal with the any-hit kernels, no hit record gets built
+		 * \param triangleIndex the first geometry triangle found between ray.min and ray.max, only written on a hit
+		 */
+		inline bool HitTest_TriangleMeshInstance(const TriangleMeshInstance& instance, const Ray& ray, uint32_t& triangleIndex)
+		{
+			const TriangleMeshGeometry& geometry = *instance.pGeometry;
+
+			Ray objectRay{ GetObjectSpaceRay(instance, ray) };
+			return HitTest_TriangleBlocks(instance.cullMode, geometry.bvh, geometry.triangleBlocks, objectRay, true, triangleIndex);
+		}
+
+		inline bool HitTest_TriangleMeshInstance(const TriangleMeshInstance& instance, const Ray& ray)
+		{
+			uint32_t triangleIndex{};
+			return HitTest_TriangleMeshInstance(instance, ray, triangleIndex);
+		}
+
+		//Occlusion test against a single triangle of the instanced geometry, same result as the block kernels
+		inline bool HitTest_TriangleMeshInstance(const TriangleMeshInstance& instance, uint32_t triangleIndex, const Ray& ray)
+		{
+			const TriangleMeshGeometry& geometry = *instance.pGeometry;
+
+			const size_t index{ static_cast<size_t>(triangleIndex) * 3 };
+			const TriangleRecord triangle{
+				geometry.positions[geometry.indices[index]],
+				geometry.positions[geometry.indices[index + 1]],
+				geometry.positions[geometry.indices[index + 2]] };
+
+			float t{};
+			return HitTest_TriangleRecord(instance.cullMode, triangle, GetObjectSpaceRay(instance, ray), t);
+		}
+
+		//Packet version, packet.max of every lane has to be the closest hit so far
+		inline void HitTest_TriangleMeshInstance(const TriangleMeshInstance& instance, RayPacket& packet, uint32_t laneMask, HitRecord* hitRecords)
+		{
+			const TriangleMeshGeometry& geometry = *instance.pGeometry;
+
+			//An affine transform keeps the common origin, so the object space packet gets a frustum as well
+			RayPacket objectPacket{};
+			for (uint32_t lane{ 0 }; lane < RayPacket::Size; ++lane)
+			{
+				const Ray ray{ packet.GetRay(lane) };
+				objectPacket.SetRay(lane, { instance.inverseTransform.TransformPoint(ray.origin), instance.inverseTransform.TransformVector(ray.direction), ray.min, ray.max });
+			}
+			objectPacket.UpdateFrustum();
+
+			uint32_t triangleIndices[RayPacket::Size];
+			uint32_t hitMask{ HitTest_TriangleBlocks(instance.cullMode, geometry.bvh, geometry.triangleBlocks, objectPacket, laneMask, triangleIndices) };
+
+			for (; hitMask != 0; hitMask &= hitMask - 1)
+			{
+				const uint32_t lane = std::countr_zero(hitMask);
+				HitRecord& hitRecord = hitRecords[lane];
+
+				packet.max[lane] = objectPacket.max[lane];
+
+				hitRecord.origin = packet.GetOrigin(lane) + packet.GetDirection(lane) * packet.max[lane];
+				hitRecord.normal = instance.TransformNormal(geometry.normals[triangleIndices[lane]]);
+				hitRecord.t = packet.max[lane];
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = instance.materialIndex;
+			}
 		}
 
 		
@@ -276,79 +975,4 @@ namespace dae
 			return{ light.color * light.intensity };
 		}
 	}
-
-	namespace Utils
-	{
-		//Just parses vertices and indices
-#pragma warning(push)
-#pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
-		{
-			std::ifstream file(filename);
-			if (!file)
-				return false;
-
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof()) 
-					break;
-			}
-
-			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
-			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if(isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normals.push_back(normal);
-			}
-
-			return true;
-		}
-#pragma warning(pop)
-	}
 }
\ No newline at end of file
@@ -1,19 +1,59 @@
 //External includes
+#ifdef _MSC_VER
 #include "vld.h"
+#endif
 #include "SDL.h"
 #include "SDL_surface.h"
 #undef main
 
 //Standard includes
 #include <iostream>
+#include <string>
 
 //Project includes
+#include "CommandLine.h"
+#include "FrameTrace.h"
+#include "MeshCache.h"
+#include "Platform.h"
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
 
 using namespace dae;
 
+//Camera controls for this frame, the relative mouse motion is consumed
+InputState ReadInputState()
+{
+	InputState input{};
+
+	const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
+	input.isForwardDown = pKeyboardState[SDL_SCANCODE_W];
+	input.isBackwardDown = pKeyboardState[SDL_SCANCODE_S];
+	input.isLeftDown = pKeyboardState[SDL_SCANCODE_A];
+	input.isRightDown = pKeyboardState[SDL_SCANCODE_D];
+
+	const uint32_t mouseButtons = SDL_GetRelativeMouseState(&input.mouseDeltaX, &input.mouseDeltaY);
+	input.isLeftMouseDown = mouseButtons & SDL_BUTTON(SDL_BUTTON_LEFT);
+	input.isRightMouseDown = mouseButtons & SDL_BUTTON(SDL_BUTTON_RIGHT);
+
+	return input;
+}
+
+//Copies the ARGB8888 frame of the renderer into the window surface (whatever its format) and shows it
+void PresentToWindow(SDL_Window* pWindow, const uint32_t* pPixels, int width, int height, uint32_t pitch)
+{
+	SDL_Surface* pSurface = SDL_GetWindowSurface(pWindow);
+	if (!pSurface)
+		return;
+
+	SDL_LockSurface(pSurface);
+	SDL_ConvertPixels(width, height, SDL_PIXELFORMAT_ARGB8888, pPixels, static_cast<int>(pitch * sizeof(uint32_t)),
+		pSurface->format->format, pSurface->pixels, pSurface->pitch);
+	SDL_UnlockSurface(pSurface);
+
+	SDL_UpdateWindowSurface(pWindow);
+}
+
 void ShutDown(SDL_Window* pWindow)
 {
 	SDL_DestroyWindow(pWindow);
@@ -22,10 +62,55 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Command line: --scene <name|file.scene|file.sceneb> (default W4_Bunny, see GetSceneNames)
+	//              --backend serial|threadpool|openmp|workstealing|stdpar
+	//              --trace <file.json> [--trace-frames 60] [--trace-skip 0]: Chrome trace of frames skip + 1 ... skip + frames
+	//              --mesh-cache <directory>|none (default: the user cache directory, see SetMeshCacheDirectory)
+	ExecutionBackendType backend{ ExecutionBackendType::WorkStealing };
+	std::string sceneName{ "W4_Bunny" };
+	std::string tracePath{};
+	uint32_t numTraceFrames{ 60 };
+	uint32_t numTraceSkipFrames{ 0 };
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+
+		if (argument == "--scene" && i + 1 < argc)
+			sceneName = args[++i];
+		else if (argument == "--mesh-cache" && i + 1 < argc)
+		{
+			const std::string directory{ args[++i] };
+			SetMeshCacheDirectory(directory == "none" ? std::string{} : directory);
+		}
+		else if (argument == "--trace" && i + 1 < argc)
+			tracePath = args[++i];
+		else if (argument == "--trace-frames" && i + 1 < argc)
+		{
+			if (!ParseArgumentValue(argument, args[++i], numTraceFrames))
+				return 1;
+		}
+		else if (argument == "--trace-skip" && i + 1 < argc)
+		{
+			if (!ParseArgumentValue(argument, args[++i], numTraceSkipFrames))
+				return 1;
+		}
+		else if (argument == "--backend" && i + 1 < argc)
+		{
+			if (!ParseExecutionBackend(args[++i], backend) || !IsExecutionBackendAvailable(backend))
+			{
+				std::cout << "Execution backend " << args[i] << " is not available" << std::endl;
+				backend = ExecutionBackendType::WorkStealing;
+			}
+		}
+	}
+
+	//Scene files are loaded before the window opens, a missing or broken one is reported on the console
+	const auto pScene = CreateScene(sceneName).release();
+	if (!pScene)
+	{
+		std::cout << "Could not load scene " << sceneName << std::endl;
+		return 1;
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -40,80 +125,149 @@ int main(int argc, char* args[])
 		width, height, 0);
 
 	if (!pWindow)
+	{
+		delete pScene;
 		return 1;
+	}
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
-
-	//const auto pScene = new Scene_W1();
-	//const auto pScene = new Scene_W2();
-	//const auto pScene = new Scene_W3();
-	//const auto pScene = new Scene_W4();
-
-	//const auto pScene = new Scene_W4_ReferenceScene();
-	const auto pScene = new Scene_W4_BunnyScene();
+	const auto pRenderer = new Renderer(static_cast<int>(width), static_cast<int>(height), [pWindow](const uint32_t* pPixels, int frameWidth, int frameHeight, uint32_t pitch)
+		{
+			PresentToWindow(pWindow, pPixels, frameWidth, frameHeight, pitch);
+		});
+	pRenderer->SetExecutionBackend(backend);
+	std::cout << "Execution backend: " << GetExecutionBackendName(pRenderer->GetExecutionBackend()) << std::endl;
 
 	pScene->Initialize();
 
+	FrameTrace::SetThreadName("main");
+	if (!tracePath.empty())
+		FrameTrace::Capture(tracePath, numTraceFrames, numTraceSkipFrames);
+
 	//Start loop
 	pTimer->Start();
 	float printTimer = 0.f;
+	RayStatCounters printRayStats{};
+	uint32_t printFrames = 0;
 	bool isLooping = true;
 	bool takeScreenshot = false;
 	while (isLooping)
 	{
 		//--------- Get input events ---------
-		SDL_Event e;
-		while (SDL_PollEvent(&e))
 		{
-			switch (e.type)
+			TRACE_ZONE("PollEvents");
+			SDL_Event e;
+			while (SDL_PollEvent(&e))
 			{
-			case SDL_QUIT:
-				isLooping = false;
-				break;
-			case SDL_KEYUP:
-				if(e.key.keysym.scancode == SDL_SCANCODE_X)
-					takeScreenshot = true;
+				switch (e.type)
+				{
+				case SDL_QUIT:
+					isLooping = false;
+					break;
+				case SDL_KEYUP:
+					if(e.key.keysym.scancode == SDL_SCANCODE_X)
+						takeScreenshot = true;
 
-				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
-					pRenderer->ToggleShadows();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F2)
+						pRenderer->ToggleShadows();
 
-				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
-					pRenderer->CycleLightingMode();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F3)
+						pRenderer->CycleLightingMode();
 
-				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
-					pTimer->StartBenchmark();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+						pRenderer->TogglePacketTracing();
+
+					if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					{
+						pRenderer->CycleExecutionBackend();
+						std::cout << "Execution backend: " << GetExecutionBackendName(pRenderer->GetExecutionBackend()) << std::endl;
+					}
+
+					if (e.key.keysym.scancode == SDL_SCANCODE_F6)
+						pTimer->StartBenchmark();
+
+					if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+						pRenderer->ToggleShadowRayStream();
+
+					if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					{
+						pRenderer->CycleCostView();
+						std::cout << "Cost view: " << Renderer::GetCostViewName(pRenderer->GetCostView()) << std::endl;
+					}
+
+					if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					{
+						if (!pRenderer->SaveCostsToFile())
+							std::cout << "Pixel costs saved!" << std::endl;
+						else
+							std::cout << "No pixel costs saved, turn on a cost view first (F8)" << std::endl;
+					}
+
+					if (e.key.keysym.scancode == SDL_SCANCODE_F10 && !FrameTrace::IsCapturePending())
+					{
+						FrameTrace::Capture("RayTracing_Trace.json", numTraceFrames);
+						std::cout << "Tracing the next " << numTraceFrames << " frames..." << std::endl;
+					}
 				
-				break;
-			default: ;
+					break;
+				default: ;
+				}
 			}
 		}
 
+		Platform::SetInputState(ReadInputState());
+
 		//--------- Update ---------
-		pScene->Update(pTimer);
+		{
+			TRACE_ZONE("Scene::Update");
+			pScene->Update(pTimer);
+		}
 
 		//--------- Render ---------
-		pRenderer->Render(pScene);
+		{
+			TRACE_ZONE("Renderer::Render");
+			pRenderer->Render(pScene);
+		}
 
 		//--------- Timer ---------
-		pTimer->Update();
+		{
+			TRACE_ZONE("Timer::Update");
+			pTimer->Update();
+		}
 		printTimer += pTimer->GetElapsed();
+		if constexpr (RayStats::IsEnabled)
+		{
+			printRayStats += pRenderer->GetLastFrameStats().rayStats;
+			++printFrames;
+		}
+
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+
+			if constexpr (RayStats::IsEnabled)
+			{
+				RayStats::Print(std::cout, printRayStats, printFrames);
+				printRayStats = {};
+				printFrames = 0;
+			}
 		}
 
 		//Save screenshot after full render
 		if (takeScreenshot)
 		{
+			TRACE_ZONE("SaveScreenshot");
 			if (!pRenderer->SaveBufferToImage())
 				std::cout << "Screenshot saved!" << std::endl;
 			else
 				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
 			takeScreenshot = false;
 		}
+
+		if (FrameTrace::EndFrame())
+			std::cout << "Trace saved!" << std::endl;
 	}
 	pTimer->Stop();
 